@@ -28,99 +28,358 @@
  */
 #include "network.hpp"
 #include "db/db.hpp"
+#include "util/murmur3.h"
+#include "util/atomic.hpp"
 
 OP_NAMESPACE_BEGIN
 
+    enum BackGroundTaskType
+    {
+        BG_ASYNC_DELETE = 1, BG_RANGE_COMPACT = 2, BG_KEYS_COUNT = 3, BG_PURGE_ELEMENTS = 4
+    };
+
+    struct BackGroundTask
+    {
+            uint8 type;
+            KeyPrefix key;
+            KeysCountJob* keys_count;
+            std::string range_start;
+            std::string range_end;
+            BackGroundTask()
+                    : type(0), keys_count(NULL)
+            {
+            }
+    };
+
     class BackGroundThread: public Thread
     {
         private:
-	        typedef std::deque<KeyPrefix> KeyQueue;
-	        KeyQueue async_delete_keys;
-	        ThreadMutexLock async_delete_lock;
-	        bool running;
-	        void Run()
-	        {
-	        	Context dctx;
-	        	while(running)
-	        	{
-	        		KeyQueue delete_ks;
-	        		{
-		        		LockGuard<ThreadMutexLock> guard(async_delete_lock);
-		        		if(!async_delete_keys.empty())
-		        		{
-		        			delete_ks = async_delete_keys;
-		        			async_delete_keys.clear();
-		        		}
-	        		}
-	        		while(!delete_ks.empty())
-	        		{
-	        			KeyPrefix& k = delete_ks.front();
-	        			KeyObject dk(k.ns, KEY_META, k.key);
-	        			g_db->DelKey(dctx, dk);
-	        			g_db->UnlockKey(k);
-	        			if(!g_db->GetConf().master_host.empty())
-	        			{
-		        			std::string kstr;
-		        			k.key.ToString(kstr);
-	        				g_db->FeedReplicationDelOperation(dctx, k.ns, kstr);
-	        			}
-	        			delete_ks.pop_front();
-	        		}
-	        		LockGuard<ThreadMutexLock> guard(async_delete_lock);
-	        		async_delete_lock.Wait(500);
-	        	}
-	        }
+            typedef std::deque<BackGroundTask> TaskQueue;
+            TaskQueue tasks;
+            ThreadMutexLock tasks_lock;
+            bool running;
+            void AsyncDelete(Context& dctx, KeyPrefix& k)
+            {
+                KeyObject dk(k.ns, KEY_META, k.key);
+                dctx.ns = k.ns;
+                g_db->DelKey(dctx, dk);
+                g_db->UnlockKey(k);
+                if (!g_db->GetConf().master_host.empty())
+                {
+                    std::string kstr;
+                    k.key.ToString(kstr);
+                    g_db->FeedReplicationDelOperation(dctx, k.ns, kstr);
+                }
+                atomic_add_uint64(&g_db->m_async_delete_done, 1);
+            }
+            void RangeCompact(Context& dctx, KeyPrefix& k)
+            {
+                /*
+                 * range deletion only leaves a tombstone covering the whole key range, compact the range
+                 * to drop the tombstone & the deleted data instead of waiting for the engine to reach it.
+                 */
+                KeyObject start(k.ns, KEY_META, k.key);
+                KeyObject end(k.ns, KEY_END, k.key);
+                dctx.ns = k.ns;
+                uint64 start_ms = get_current_epoch_millis();
+                int err = g_db->m_engine->Compact(dctx, start, end);
+                if (0 != err && ERR_NOTSUPPORTED != err)
+                {
+                    WARN_LOG("Failed to compact deleted range of key:%s with err:%d", k.key.AsString().c_str(), err);
+                }
+                else
+                {
+                    DEBUG_LOG("Compact deleted range of key:%s cost %llums", k.key.AsString().c_str(), get_current_epoch_millis() - start_ms);
+                }
+                atomic_add_uint64(&g_db->m_range_compact_done, 1);
+            }
+            void PurgeElements(Context& dctx, KeyPrefix& k)
+            {
+                KeyObject meta_key(k.ns, KEY_META, k.key);
+                dctx.ns = k.ns;
+                Iterator* iter = NULL;
+                g_db->RemoveElements(dctx, meta_key, iter);
+                DELETE(iter);
+                g_db->UnlockKey(k);
+                atomic_add_uint64(&g_db->m_lazy_delete_done, 1);
+                g_db->ScheduleRangeCompaction(dctx, meta_key);
+            }
+            void KeysCount(Context& dctx, BackGroundTask& task)
+            {
+                KeysCountJob* job = task.keys_count;
+                dctx.ns = job->ns;
+                int64 count = g_db->MatchKeys(dctx, job->pattern, task.range_start, task.range_end, NULL);
+                dctx.ClearFlags();
+                LockGuard<ThreadMutexLock> guard(job->lock);
+                job->count += count;
+                job->pending--;
+                job->lock.NotifyAll();
+            }
+            void Run()
+            {
+                Context dctx;
+                while (running)
+                {
+                    TaskQueue current;
+                    {
+                        LockGuard<ThreadMutexLock> guard(tasks_lock);
+                        if (!tasks.empty())
+                        {
+                            current.swap(tasks);
+                        }
+                    }
+                    while (!current.empty())
+                    {
+                        BackGroundTask& task = current.front();
+                        switch (task.type)
+                        {
+                            case BG_ASYNC_DELETE:
+                            {
+                                AsyncDelete(dctx, task.key);
+                                break;
+                            }
+                            case BG_RANGE_COMPACT:
+                            {
+                                RangeCompact(dctx, task.key);
+                                break;
+                            }
+                            case BG_KEYS_COUNT:
+                            {
+                                KeysCount(dctx, task);
+                                break;
+                            }
+                            case BG_PURGE_ELEMENTS:
+                            {
+                                PurgeElements(dctx, task.key);
+                                break;
+                            }
+                            default:
+                            {
+                                break;
+                            }
+                        }
+                        current.pop_front();
+                    }
+                    /*
+                     * engines keeping per thread state(forestdb pending commits, lmdb read snapshots) only release it
+                     * from their routine, which io/cron threads run from their timers but workers never would.
+                     */
+                    g_engine->Routine();
+                    LockGuard<ThreadMutexLock> guard(tasks_lock);
+                    if (tasks.empty() && running)
+                    {
+                        tasks_lock.Wait(500);
+                    }
+                }
+            }
         public:
-	        BackGroundThread():running(true)
+            BackGroundThread()
+                    : running(true)
             {
 
             }
-	        void Shutdown()
-	        {
-	        	running = false;
-	        	LockGuard<ThreadMutexLock> guard(async_delete_lock);
-	            async_delete_lock.Notify();
-	        }
-	        void AsyncDelete(const KeyPrefix& k)
-	        {
-	        	LockGuard<ThreadMutexLock> guard(async_delete_lock);
-	        	g_db->LockKey(k);
-	        	async_delete_keys.push_back(k);
-	        	async_delete_lock.Notify();
-	        }
+            void Shutdown()
+            {
+                running = false;
+                LockGuard<ThreadMutexLock> guard(tasks_lock);
+                tasks_lock.Notify();
+            }
+            void Submit(const BackGroundTask& task)
+            {
+                LockGuard<ThreadMutexLock> guard(tasks_lock);
+                tasks.push_back(task);
+                tasks_lock.Notify();
+            }
 
             virtual ~BackGroundThread()
             {
             }
     };
 
-    int Ardb::AsyncDeleteKey(Context& ctx, const Data& ns, const std::string& key)
+    BackGroundThread* Ardb::SelectBackGroundThread(const KeyPrefix& k)
     {
-    	KeyPrefix k;
-    	k.ns = ns;
-    	k.key.SetString(key, false);
-    	g_background->AsyncDelete(k);
-    	return 0;
+        if (m_background_workers.empty())
+        {
+            return NULL;
+        }
+        /*
+         * tasks of the same key always go to the same worker, so they are executed in submit order.
+         */
+        std::string kstr;
+        k.key.ToString(kstr);
+        uint32 hash = 0;
+        MurmurHash3_x86_32(kstr.data(), kstr.size(), 0, &hash);
+        return m_background_workers[hash % m_background_workers.size()];
     }
 
-    int Ardb::CreateBackGroundThread()
+    int Ardb::AsyncDeleteKey(Context& ctx, const Data& ns, const std::string& key)
     {
-    	NEW(g_background, BackGroundThread);
-    	g_background->Start();
-    	return 0;
+        BackGroundTask task;
+        task.type = BG_ASYNC_DELETE;
+        task.key.ns = ns;
+        task.key.key.SetString(key, false);
+        BackGroundThread* worker = SelectBackGroundThread(task.key);
+        if (NULL == worker)
+        {
+            return ERR_NOTSUPPORTED;
+        }
+        if (ctx.IsKeyLocked(task.key))
+        {
+            /*
+             * the key is held by the caller's transaction, the worker could not take it over.
+             */
+            DelKey(ctx, key);
+            return 0;
+        }
+        LockKey(task.key);
+        atomic_add_uint64(&m_async_delete_queued, 1);
+        worker->Submit(task);
+        return 0;
     }
-    int Ardb::StopBackGroundThread()
+
+    /*
+     * Split the key range of the pattern prefix by the first byte after it, and count each part on a background worker.
+     * The split points are spread over the printable chars, where most keys start.
+     * It counts serially if the caller holds an engine write batch/transaction(workers' iterators would wait for it
+     * while it waits for them), or the engine's iterators serialize anyway(lmdb).
+     */
+    int64 Ardb::ParallelKeysCount(Context& ctx, const std::string& pattern)
     {
-    	if(NULL != g_background)
-    	{
-    		g_background->Shutdown();
-    		g_background->Join();
-    		DELETE(g_background);
-    	}
-    	return 0;
+        KeysCountJob job(pattern);
+        if (job.pattern.literal || m_background_workers.size() < 2 || ctx.write_batch_depth > 0 || ctx.InTransaction()
+                || !m_engine->GetFeatureSet().support_concurrent_iterator)
+        {
+            return MatchKeys(ctx, job.pattern, job.pattern.prefix, "", NULL);
+        }
+        job.ns = ctx.ns;
+        if (job.ns.IsString())
+        {
+            job.ns.ToMutableStr();
+        }
+        size_t parts = m_background_workers.size();
+        job.pending = parts;
+        std::string start = job.pattern.prefix;
+        for (size_t i = 0; i < parts; i++)
+        {
+            BackGroundTask task;
+            task.type = BG_KEYS_COUNT;
+            task.keys_count = &job;
+            task.range_start = start;
+            if (i + 1 < parts)
+            {
+                char split = (char) ('0' + ('z' - '0' + 1) * (i + 1) / parts);
+                task.range_end = job.pattern.prefix;
+                task.range_end.append(1, split);
+                start = task.range_end;
+            }
+            m_background_workers[i]->Submit(task);
+        }
+        LockGuard<ThreadMutexLock> guard(job.lock);
+        while (job.pending > 0)
+        {
+            job.lock.Wait(100);
+        }
+        return job.count;
     }
-OP_NAMESPACE_END
 
+    void Ardb::ScheduleRangeCompaction(Context& ctx, const KeyObject& meta_key)
+    {
+        /*
+         * engines compacting a whole table/file for any range(wiredtiger/lmdb/perconaft) would rewrite everything
+         * on each big deletion, leave them to their own compaction.
+         */
+        if (!GetConf().range_delete_compact || !m_engine->GetFeatureSet().support_range_compact)
+        {
+            return;
+        }
+        BackGroundTask task;
+        task.type = BG_RANGE_COMPACT;
+        /*
+         * the meta key may refer to the caller's buffers, keep own copies in the queued task.
+         */
+        task.key.ns = meta_key.GetNameSpace();
+        task.key.key = meta_key.GetKey();
+        if (task.key.ns.IsString())
+        {
+            task.key.ns.SetString(task.key.ns.AsString(), false);
+        }
+        if (task.key.key.IsString())
+        {
+            task.key.key.SetString(task.key.key.AsString(), false);
+        }
+        BackGroundThread* worker = SelectBackGroundThread(task.key);
+        if (NULL != worker)
+        {
+            atomic_add_uint64(&m_range_compact_queued, 1);
+            worker->Submit(task);
+        }
+    }
 
+    void Ardb::ScheduleElementsPurge(Context& ctx, const KeyObject& meta_key)
+    {
+        BackGroundTask task;
+        task.type = BG_PURGE_ELEMENTS;
+        task.key.ns = meta_key.GetNameSpace();
+        task.key.key = meta_key.GetKey();
+        if (task.key.ns.IsString())
+        {
+            task.key.ns.SetString(task.key.ns.AsString(), false);
+        }
+        if (task.key.key.IsString())
+        {
+            task.key.key.SetString(task.key.key.AsString(), false);
+        }
+        BackGroundThread* worker = SelectBackGroundThread(task.key);
+        {
+            /*
+             * both the current lock holder & the purge task would release the key lock, the later one unlocks it.
+             */
+            LockGuard<SpinMutexLock> guard(m_locking_keys_lock);
+            m_purging_keys[task.key] = false;
+        }
+        atomic_add_uint64(&m_lazy_delete_queued, 1);
+        worker->Submit(task);
+    }
 
+    void Ardb::FillBackGroundInfo(std::string& info)
+    {
+        uint64 delete_queued = m_async_delete_queued;
+        uint64 delete_done = m_async_delete_done;
+        uint64 compact_queued = m_range_compact_queued;
+        uint64 compact_done = m_range_compact_done;
+        info.append("async_delete_threads:").append(stringfromll(m_background_workers.size())).append("\r\n");
+        info.append("async_delete_pending_keys:").append(stringfromll(delete_queued - delete_done)).append("\r\n");
+        info.append("async_deleted_keys:").append(stringfromll(delete_done)).append("\r\n");
+        info.append("range_deleted_keys:").append(stringfromll(m_range_delete_count)).append("\r\n");
+        info.append("range_compact_pending:").append(stringfromll(compact_queued - compact_done)).append("\r\n");
+        info.append("range_compact_finished:").append(stringfromll(compact_done)).append("\r\n");
+        uint64 lazy_queued = m_lazy_delete_queued;
+        uint64 lazy_done = m_lazy_delete_done;
+        info.append("lazy_delete_pending_keys:").append(stringfromll(lazy_queued - lazy_done)).append("\r\n");
+        info.append("lazy_deleted_keys:").append(stringfromll(lazy_done)).append("\r\n");
+    }
 
+    int Ardb::CreateBackGroundThread()
+    {
+        for (int64 i = 0; i < GetConf().async_delete_threads; i++)
+        {
+            BackGroundThread* worker = NULL;
+            NEW(worker, BackGroundThread);
+            worker->Start();
+            m_background_workers.push_back(worker);
+        }
+        return 0;
+    }
+    int Ardb::StopBackGroundThread()
+    {
+        for (size_t i = 0; i < m_background_workers.size(); i++)
+        {
+            BackGroundThread* worker = m_background_workers[i];
+            worker->Shutdown();
+            worker->Join();
+            DELETE(worker);
+        }
+        m_background_workers.clear();
+        return 0;
+    }
+OP_NAMESPACE_END
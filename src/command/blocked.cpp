@@ -27,6 +27,8 @@
  *THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include "db/db.hpp"
+#include "util/murmur3.h"
+#include <algorithm>
 
 OP_NAMESPACE_BEGIN
 
@@ -56,6 +58,22 @@ OP_NAMESPACE_BEGIN
         DELETE(c);
     }
 
+    Ardb::BlockingShard& Ardb::GetBlockingShard(const KeyPrefix& key)
+    {
+        uint32 hash = 0;
+        if (key.key.IsString())
+        {
+            MurmurHash3_x86_32(key.key.CStr(), key.key.StringLength(), 0, &hash);
+        }
+        else
+        {
+            std::string kstr;
+            key.key.ToString(kstr);
+            MurmurHash3_x86_32(kstr.data(), kstr.size(), 0, &hash);
+        }
+        return m_blocking_shards[hash % ARDB_BLOCKING_SHARDS];
+    }
+
     int Ardb::UnblockKeys(Context& ctx, bool sync, RedisReply* reply)
     {
         if (ctx.keyslocked)
@@ -73,25 +91,35 @@ OP_NAMESPACE_BEGIN
             Channel* ch = ctx.client->client;
             ch->Write(*reply);
         }
-        LockGuard<SpinMutexLock> guard(m_block_keys_lock, true);
-        if (ctx.bpop != NULL && !m_blocked_ctxs.empty())
+        if (ctx.bpop != NULL)
         {
             BlockingState::BlockKeyTable::iterator it = ctx.GetBPop().keys.begin();
             while (it != ctx.GetBPop().keys.end())
             {
                 const KeyPrefix& prefix = it->first;
-                BlockedContextTable::iterator blocked_found = m_blocked_ctxs.find(prefix);
-                if (blocked_found != m_blocked_ctxs.end())
+                BlockingShard& shard = GetBlockingShard(prefix);
+                LockGuard<SpinMutexLock> guard(shard.lock);
+                BlockedContextTable::iterator blocked_found = shard.keys.find(prefix);
+                if (blocked_found != shard.keys.end())
                 {
-                    ContextSet& blocked_set = blocked_found->second;
-                    blocked_set.erase(&ctx);
-                    if (blocked_set.empty())
+                    BlockedContextQueue& queue = blocked_found->second;
+                    BlockedContextQueue::iterator qit = std::find(queue.begin(), queue.end(), &ctx);
+                    if (qit != queue.end())
                     {
-                        m_blocked_ctxs.erase(blocked_found);
+                        queue.erase(qit);
+                        atomic_sub_uint32(&shard.blocked_num, 1);
+                    }
+                    if (queue.empty())
+                    {
+                        shard.keys.erase(blocked_found);
                     }
                 }
                 it++;
             }
+            if (!ctx.GetBPop().keys.empty())
+            {
+                atomic_sub_uint32(&m_blocked_clients, 1);
+            }
             ctx.ClearBPop();
         }
         ctx.client->client->UnblockRead();
@@ -110,20 +138,24 @@ OP_NAMESPACE_BEGIN
         }
         ctx.GetBPop().block_keytype = ktype;
         ctx.client->client->BlockRead();
-        LockGuard<SpinMutexLock> guard(m_block_keys_lock);
         for (size_t i = 0; i < keys.size(); i++)
         {
             KeyPrefix prefix;
             prefix.ns = ctx.ns;
             prefix.key.SetString(keys[i], false);
-            if(vals.size() != keys.size())
-            {
-                ctx.GetBPop().keys.insert(BlockingState::BlockKeyTable::value_type(prefix, NULL));
-            }else
+            const void* val = vals.size() != keys.size() ? NULL : vals[i];
+            if (!ctx.GetBPop().keys.insert(BlockingState::BlockKeyTable::value_type(prefix, val)).second)
             {
-                ctx.GetBPop().keys.insert(BlockingState::BlockKeyTable::value_type(prefix, vals[i]));
+                continue;
             }
-            m_blocked_ctxs[prefix].insert(&ctx);
+            BlockingShard& shard = GetBlockingShard(prefix);
+            LockGuard<SpinMutexLock> guard(shard.lock);
+            shard.keys[prefix].push_back(&ctx);
+            atomic_add_uint32(&shard.blocked_num, 1);
+        }
+        if (!ctx.GetBPop().keys.empty())
+        {
+            atomic_add_uint32(&m_blocked_clients, 1);
         }
         return 0;
     }
@@ -134,95 +166,109 @@ OP_NAMESPACE_BEGIN
         {
             FATAL_LOG("Can not modify block dataset when key locked.");
         }
-        LockGuard<SpinMutexLock> guard(m_block_keys_lock, !ctx.flags.block_keys_locked);
         KeyPrefix prefix;
         prefix.ns = ctx.ns;
         prefix.key.SetString(key, false);
-        if (m_blocked_ctxs.find(prefix) == m_blocked_ctxs.end())
+        BlockingShard& shard = GetBlockingShard(prefix);
+        if (0 == shard.blocked_num)
         {
             return -1;
         }
-        if (NULL == m_ready_keys)
+        LockGuard<SpinMutexLock> guard(shard.ready_lock);
+        if (shard.ready_keys.insert(prefix).second)
         {
-            NEW(m_ready_keys, ReadyKeySet);
+            atomic_add_uint32(&shard.ready_num, 1);
+            atomic_add_uint32(&m_ready_keys_num, 1);
         }
-        m_ready_keys->insert(prefix);
         return 0;
     }
+
     int Ardb::WakeClientsBlockingOnKeys(Context& ctx)
     {
-        if (NULL == m_ready_keys)
+        if (0 == m_ready_keys_num)
         {
             return 0;
         }
-        ReadyKeySet ready_keys;
+        for (uint32 i = 0; i < ARDB_BLOCKING_SHARDS; i++)
         {
-            LockGuard<SpinMutexLock> guard(m_block_keys_lock);
-            if (NULL == m_ready_keys)
+            BlockingShard& shard = m_blocking_shards[i];
+            if (0 == shard.ready_num)
             {
-                return 0;
+                continue;
             }
-            if (m_ready_keys->empty())
+            ReadyKeySet ready_keys;
             {
-                return 0;
+                LockGuard<SpinMutexLock> guard(shard.ready_lock);
+                ready_keys.swap(shard.ready_keys);
+                atomic_sub_uint32(&shard.ready_num, ready_keys.size());
+                atomic_sub_uint32(&m_ready_keys_num, ready_keys.size());
             }
-            ready_keys = *m_ready_keys;
-            DELETE(m_ready_keys);
-        }
-        ReadyKeySet::iterator sit = ready_keys.begin();
-        while (sit != ready_keys.end())
-        {
-            const KeyPrefix& ready_key = *sit;
+            ReadyKeySet::iterator sit = ready_keys.begin();
+            while (sit != ready_keys.end())
             {
-                LockGuard<SpinMutexLock> block_guard(m_block_keys_lock);
-                BlockedContextTable::iterator fit = m_blocked_ctxs.find(ready_key);
-                if (fit != m_blocked_ctxs.end())
+                const KeyPrefix& ready_key = *sit;
+                LockGuard<SpinMutexLock> block_guard(shard.lock);
+                BlockedContextTable::iterator fit = shard.keys.find(ready_key);
+                if (fit != shard.keys.end())
                 {
-                    ContextSet& wait_set = fit->second;
-                    ContextSet::iterator cit = wait_set.begin();
-                    while (cit != wait_set.end())
+                    /*
+                     * serve the waiters in arrival order, a waiter the key can not serve(e.g. an XREAD after the
+                     * last id) keeps its place and the ones behind it are still tried, up to the batch limit.
+                     */
+                    BlockedContextQueue& queue = fit->second;
+                    size_t idx = 0;
+                    uint32 tried = 0;
+                    while (idx < queue.size() && tried < ARDB_BLOCKING_WAKE_BATCH)
                     {
-                        Context* unblock_client = *cit;
-                        if (NULL != unblock_client->bpop)
+                        Context* unblock_client = queue[idx];
+                        if (NULL == unblock_client->bpop || unblock_client->bpop->woken)
+                        {
+                            queue.erase(queue.begin() + idx);
+                            atomic_sub_uint32(&shard.blocked_num, 1);
+                            continue;
+                        }
+                        tried++;
+                        unblock_client->bpop->woken = true;
+                        int err = 0;
+                        switch (unblock_client->bpop->block_keytype)
                         {
-                            int err = 0;
-                            switch(unblock_client->bpop->block_keytype)
+                            case KEY_LIST:
                             {
-                                case KEY_LIST:
-                                {
-                                    err = WakeClientsBlockingOnList(ctx, ready_key, *unblock_client);
-                                    break;
-                                }
-                                case KEY_ZSET:
-                                {
-                                    err = WakeClientsBlockingOnZSet(ctx, ready_key, *unblock_client);
-                                    break;
-                                }
-                                case KEY_STREAM:
-                                {
-                                    err = WakeClientsBlockingOnStream(ctx, ready_key, *unblock_client);
-                                    break;
-                                }
-                                default:
-                                {
-                                    ERROR_LOG("Not support block on keytype:%u", unblock_client->bpop->block_keytype);
-                                    break;
-                                }
+                                err = WakeClientsBlockingOnList(ctx, ready_key, *unblock_client);
+                                break;
                             }
-                            if (0 == err)
+                            case KEY_ZSET:
                             {
-                                cit = wait_set.erase(cit);
-                                //ServeClientBlockedOnList(*unblock_client, ready_key, pop_value);
+                                err = WakeClientsBlockingOnZSet(ctx, ready_key, *unblock_client);
+                                break;
                             }
-                            else
+                            case KEY_STREAM:
                             {
-                                cit++;
+                                err = WakeClientsBlockingOnStream(ctx, ready_key, *unblock_client);
+                                break;
                             }
+                            default:
+                            {
+                                ERROR_LOG("Not support block on keytype:%u", unblock_client->bpop->block_keytype);
+                                break;
+                            }
+                        }
+                        if (0 != err)
+                        {
+                            unblock_client->bpop->woken = false;
+                            idx++;
+                            continue;
                         }
+                        queue.erase(queue.begin() + idx);
+                        atomic_sub_uint32(&shard.blocked_num, 1);
+                    }
+                    if (queue.empty())
+                    {
+                        shard.keys.erase(fit);
                     }
                 }
+                sit++;
             }
-            sit++;
         }
         return 0;
     }
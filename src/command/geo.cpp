@@ -32,6 +32,7 @@
 #include <algorithm>
 #include <math.h>
 #define GEO_STEP_MAX 26
+#define GEO_DISTANCE_BATCH 64
 namespace ardb
 {
 
@@ -380,6 +381,60 @@ namespace ardb
         return v1.distance > v2.distance;
     }
 
+    struct GeoSearchRange
+    {
+            ZRangeSpec spec;
+            double min_distance;
+    };
+
+    static bool less_by_min_distance(const GeoSearchRange& v1, const GeoSearchRange& v2)
+    {
+        return v1.min_distance < v2.min_distance;
+    }
+
+    /*
+     * Compute distances of a batch of decoded points, and move the ones inside the radius into results.
+     * If topk > 0, results is kept as a max-heap by distance holding at most topk points.
+     */
+    static void filter_points_by_distance(double x, double y, double radius, size_t topk, GeoPointArray& batch, GeoPointArray& results)
+    {
+        if (batch.empty())
+        {
+            return;
+        }
+        double xs[GEO_DISTANCE_BATCH], ys[GEO_DISTANCE_BATCH], distances[GEO_DISTANCE_BATCH];
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            xs[i] = batch[i].x;
+            ys[i] = batch[i].y;
+        }
+        GeoHashHelper::GetWGS84Distances(x, y, xs, ys, distances, batch.size());
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            if (distances[i] >= radius)
+            {
+                continue;
+            }
+            batch[i].distance = distances[i];
+            if (0 == topk)
+            {
+                results.push_back(batch[i]);
+            }
+            else if (results.size() < topk)
+            {
+                results.push_back(batch[i]);
+                std::push_heap(results.begin(), results.end(), less_by_distance);
+            }
+            else if (distances[i] < results.front().distance)
+            {
+                std::pop_heap(results.begin(), results.end(), less_by_distance);
+                results.back() = batch[i];
+                std::push_heap(results.begin(), results.end(), less_by_distance);
+            }
+        }
+        batch.clear();
+    }
+
     /*
      *  GEORADIUS key x y              <GeoOptions>
      *  GEORADIUSBYMEMBER key member   <GeoOptions>
@@ -480,18 +535,26 @@ namespace ardb
         GeoHashHelper::GetAreasByRadius(GEO_WGS84_TYPE, y, x, radius, ress);
 
         /*
-         * 2. Merge neighbors areas if possible to avoid more tree search
+         * 2. Merge neighbors areas if possible to avoid more tree search, every merged range keeps the
+         *    minimum possible distance of its areas from the center.
          */
-        std::vector<ZRangeSpec> range_array;
+        std::vector<GeoSearchRange> range_array;
         GeoHashBitsSet::iterator rit = ress.begin();
-        typedef TreeMap<uint64, uint64>::Type HashRangeMap;
+        typedef TreeMap<uint64, std::pair<uint64, double> >::Type HashRangeMap;
         HashRangeMap tmp;
         while (rit != ress.end())
         {
-            GeoHashBits& hash = *rit;
+            const GeoHashBits& hash = *rit;
             GeoHashBits next = hash;
             next.bits++;
-            tmp[GeoHashHelper::AllignHashBits(GEO_STEP_MAX, hash)] = GeoHashHelper::AllignHashBits(GEO_STEP_MAX, next);
+            GeoHashArea area;
+            double min_distance = 0;
+            if (0 == geohash_fast_decode(lat_range, lon_range, hash, &area))
+            {
+                min_distance = GeoHashHelper::GetWGS84MinDistance(x, y, area);
+            }
+            tmp[GeoHashHelper::AllignHashBits(GEO_STEP_MAX, hash)] = std::make_pair(GeoHashHelper::AllignHashBits(GEO_STEP_MAX, next),
+                    min_distance);
             rit++;
         }
         HashRangeMap::iterator tit = tmp.begin();
@@ -499,14 +562,19 @@ namespace ardb
         nit++;
         while (tit != tmp.end())
         {
-            ZRangeSpec range;
-            range.contain_min = true;
-            range.contain_max = true;
-            range.min.SetInt64(tit->first);
-            range.max.SetInt64(tit->second);
-            while (nit != tmp.end() && (int64_t)nit->first == range.max.GetInt64())
+            GeoSearchRange range;
+            range.spec.contain_min = true;
+            range.spec.contain_max = true;
+            range.spec.min.SetInt64(tit->first);
+            range.spec.max.SetInt64(tit->second.first);
+            range.min_distance = tit->second.second;
+            while (nit != tmp.end() && (int64_t)nit->first == range.spec.max.GetInt64())
             {
-                range.max.SetInt64(nit->second);
+                range.spec.max.SetInt64(nit->second.first);
+                if (nit->second.second < range.min_distance)
+                {
+                    range.min_distance = nit->second.second;
+                }
                 nit++;
                 tit++;
             }
@@ -516,17 +584,34 @@ namespace ardb
         }
 
         /*
-         * 3. Get all data by iterate areas
+         * With an ascending COUNT/LIMIT only the nearest offset+limit points are needed, keep them in a bounded
+         * max-heap, visit the ranges from the nearest to the farthest and stop once no unvisited range could
+         * beat the current K-th distance.
+         */
+        size_t topk = 0;
+        if (!options.nosort && options.asc && options.limit > 0 && options.offset >= 0)
+        {
+            topk = (size_t) options.offset + (size_t) options.limit;
+            std::sort(range_array.begin(), range_array.end(), less_by_min_distance);
+        }
+
+        /*
+         * 3. Get all data by iterate areas, points are decoded & filtered in batches
          */
         GeoPointArray points;
-        std::vector<ZRangeSpec>::iterator hit = range_array.begin();
+        GeoPointArray batch;
+        batch.reserve(GEO_DISTANCE_BATCH);
+        size_t hit = 0;
         Iterator* iter = NULL;
-        //printf("###%d \n", range_array.size());
-        while (hit != range_array.end())
+        while (hit < range_array.size())
         {
-            ZRangeSpec& range = *hit;
+            GeoSearchRange& range = range_array[hit];
+            if (topk > 0 && points.size() >= topk && range.min_distance >= points.front().distance)
+            {
+                break;
+            }
             KeyObject zmember(ctx.ns, KEY_ZSET_SORT, cmd.GetArguments()[0]);
-            zmember.SetZSetScore(range.min.GetFloat64());
+            zmember.SetZSetScore(range.spec.min.GetFloat64());
             if (NULL == iter)
             {
                 iter = m_engine->Find(ctx, zmember);
@@ -535,7 +620,6 @@ namespace ardb
             {
                 iter->Jump(zmember);
             }
-            //printf("###%.2f\n", range.min.GetFloat64());
             while (iter->Valid())
             {
                 KeyObject& zkey = iter->Key(true);
@@ -543,19 +627,18 @@ namespace ardb
                 {
                     break;
                 }
-                int inrange = range.InRange(zkey.GetZSetScore());
+                int inrange = range.spec.InRange(zkey.GetZSetScore());
                 if (0 == inrange)
                 {
                     GeoPoint point;
                     point.score = (int64_t) zkey.GetZSetScore();
                     point.value = zkey.GetZSetMember();
-                    //printf("###Find %lld %s\n", point.score, point.value.AsString().c_str());
                     if (GeoHashHelper::GetXYByHash(GEO_WGS84_TYPE, GEO_STEP_MAX, (uint64) point.score, point.x, point.y))
                     {
-                        point.distance = GeoHashHelper::GetWGS84Distance(x, y, point.x, point.y);
-                        if (point.distance < radius)
+                        batch.push_back(point);
+                        if (batch.size() == GEO_DISTANCE_BATCH)
                         {
-                            points.push_back(point);
+                            filter_points_by_distance(x, y, radius, topk, batch, points);
                         }
                     }
                 }
@@ -565,9 +648,13 @@ namespace ardb
                 }
                 iter->Next();
             }
+            filter_points_by_distance(x, y, radius, topk, batch, points);
             if (!iter->Valid())
             {
-                break;
+                /*
+                 * ranges may be visited out of hash order, restart the iterator for the next one
+                 */
+                DELETE(iter);
             }
             hit++;
         }
@@ -576,7 +663,11 @@ namespace ardb
         /*
          * 4. sort & erase results
          */
-        if (!options.nosort)
+        if (topk > 0)
+        {
+            std::sort_heap(points.begin(), points.end(), less_by_distance);
+        }
+        else if (!options.nosort)
         {
             std::sort(points.begin(), points.end(), options.asc ? less_by_distance : great_by_distance);
         }
@@ -31,9 +31,12 @@
 
 #include "db/db.hpp"
 #include "util/sds.h"
+#include "util/murmur3.h"
 
 #include <stdint.h>
 #include <math.h>
+#include <algorithm>
+#include <vector>
 
 /* The Redis HyperLogLog implementation is based on the following ideas:
  *
@@ -496,13 +499,10 @@ int hllPatLen(unsigned char *ele, size_t elesize, long *regp)
  * The function always succeed, however if as a result of the operation
  * the approximated cardinality changed, 1 is returned. Otherwise 0
  * is returned. */
-int hllDenseAdd(uint8_t *registers, unsigned char *ele, size_t elesize)
+int hllDenseSet(uint8_t *registers, long index, uint8_t count)
 {
-    uint8_t oldcount, count;
-    long index;
+    uint8_t oldcount;
 
-    /* Update the register if this element produced a longer run of zeroes. */
-    count = hllPatLen(ele, elesize, &index);
     HLL_DENSE_GET_REGISTER(oldcount, registers, index);
     if (count > oldcount)
     {
@@ -515,6 +515,16 @@ int hllDenseAdd(uint8_t *registers, unsigned char *ele, size_t elesize)
     }
 }
 
+/* Hash the element and update the register it maps to, see hllDenseSet(). */
+int hllDenseAdd(uint8_t *registers, unsigned char *ele, size_t elesize)
+{
+    long index;
+
+    /* Update the register if this element produced a longer run of zeroes. */
+    uint8_t count = hllPatLen(ele, elesize, &index);
+    return hllDenseSet(registers, index, count);
+}
+
 /* Compute SUM(2^-reg) in the dense representation.
  * PE is an array with a pre-computer table of values 2^-reg indexed by reg.
  * As a side effect the integer pointed by 'ezp' is set to the number
@@ -702,11 +712,11 @@ int hllSparseToDense(sds* value)
  * sparse to dense: this happens when a register requires to be set to a value
  * not representable with the sparse representation, or when the resulting
  * size would be greater than server.hll_sparse_max_bytes. */
-int hllSparseAdd(sds* value, unsigned char *ele, size_t elesize, uint32_t hll_sparse_max_bytes)
+int hllSparseSet(sds* value, long index, uint8_t count, uint32_t hll_sparse_max_bytes)
 {
     struct hllhdr *hdr;
-    uint8_t oldcount, count, *sparse, *end, *p, *prev, *next;
-    long index, first, span;
+    uint8_t oldcount, *sparse, *end, *p, *prev, *next;
+    long first, span;
     long is_zero = 0, is_xzero = 0, is_val = 0, runlen = 0;
     int scanlen;
     int seqlen;
@@ -716,9 +726,6 @@ int hllSparseAdd(sds* value, unsigned char *ele, size_t elesize, uint32_t hll_sp
     int len;
     uint8_t seq[5], *n;
 
-    /* Update the register if this element produced a longer run of zeroes. */
-    count = hllPatLen(ele, elesize, &index);
-
     /* If the count is too big to be representable by the sparse representation
      * switch to dense representation. */
     if (count > HLL_SPARSE_VAL_MAX_VALUE)
@@ -985,18 +992,28 @@ int hllSparseAdd(sds* value, unsigned char *ele, size_t elesize, uint32_t hll_sp
         return -1; /* Corrupted HLL. */
     hdr = (struct hllhdr *) (*value);
 
-    /* We need to call hllDenseAdd() to perform the operation after the
+    /* We need to call hllDenseSet() to perform the operation after the
      * conversion. However the result must be 1, since if we need to
      * convert from sparse to dense a register requires to be updated.
      *
      * Note that this in turn means that PFADD will make sure the command
      * is propagated to slaves / AOF, so if there is a sparse -> dense
      * convertion, it will be performed in all the slaves as well. */
-    int dense_retval = hllDenseAdd(hdr->registers, ele, elesize);
+    int dense_retval = hllDenseSet(hdr->registers, index, count);
     //ASSERT(dense_retval == 1);
     return dense_retval;
 }
 
+/* Hash the element and update the register it maps to, see hllSparseSet(). */
+int hllSparseAdd(sds* value, unsigned char *ele, size_t elesize, uint32_t hll_sparse_max_bytes)
+{
+    long index;
+
+    /* Update the register if this element produced a longer run of zeroes. */
+    uint8_t count = hllPatLen(ele, elesize, &index);
+    return hllSparseSet(value, index, count, hll_sparse_max_bytes);
+}
+
 /* Compute SUM(2^-reg) in the sparse representation.
  * PE is an array with a pre-computer table of values 2^-reg indexed by reg.
  * As a side effect the integer pointed by 'ezp' is set to the number
@@ -1213,6 +1230,150 @@ int hllAdd(std::string& value, unsigned char *ele, size_t elesize, uint32_t hll_
     }
 }
 
+/* ========================== Register deltas ========================== */
+
+/* PFADD hashes its elements without touching the stored HLL and only emits
+ * register updates: 3 bytes each, the 14 bits register index in little
+ * endian followed by the 000..1 pattern length. Updates are sorted by index
+ * and only the max count of each register is kept. */
+#define HLL_DELTA_SIZE 3
+
+struct hllDelta
+{
+        long index;
+        uint8_t count;
+        bool operator<(const hllDelta& other) const
+        {
+            return index < other.index;
+        }
+};
+
+static void hllEncodeDeltas(std::vector<hllDelta>& deltas, std::string& encoded)
+{
+    std::sort(deltas.begin(), deltas.end());
+    encoded.clear();
+    encoded.reserve(deltas.size() * HLL_DELTA_SIZE);
+    for (size_t i = 0; i < deltas.size(); i++)
+    {
+        if (i + 1 < deltas.size() && deltas[i + 1].index == deltas[i].index)
+        {
+            if (deltas[i + 1].count < deltas[i].count)
+            {
+                deltas[i + 1].count = deltas[i].count;
+            }
+            continue;
+        }
+        encoded.push_back((char) (deltas[i].index & 0xff));
+        encoded.push_back((char) ((deltas[i].index >> 8) & 0xff));
+        encoded.push_back((char) deltas[i].count);
+    }
+}
+
+/* Hash every element(skip the first 'offset' arguments) into its register update. */
+static void hllComputeDeltas(const ardb::codec::ArgumentArray& elements, size_t offset, std::string& encoded)
+{
+    std::vector<hllDelta> deltas(elements.size() - offset);
+    for (size_t i = offset; i < elements.size(); i++)
+    {
+        hllDelta& delta = deltas[i - offset];
+        delta.count = hllPatLen((unsigned char*) elements[i].data(), elements[i].size(), &delta.index);
+    }
+    hllEncodeDeltas(deltas, encoded);
+}
+
+/* Combine two encoded delta sets, used to merge pending operands. */
+static void hllCombineDeltas(const std::string& left, std::string& right)
+{
+    std::vector<hllDelta> deltas;
+    deltas.reserve((left.size() + right.size()) / HLL_DELTA_SIZE);
+    const std::string* parts[2] = { &left, &right };
+    for (int i = 0; i < 2; i++)
+    {
+        const uint8_t* p = (const uint8_t*) parts[i]->data();
+        for (size_t j = 0; j + HLL_DELTA_SIZE <= parts[i]->size(); j += HLL_DELTA_SIZE)
+        {
+            hllDelta delta;
+            delta.index = p[j] | ((long) p[j + 1] << 8);
+            delta.count = p[j + 2];
+            deltas.push_back(delta);
+        }
+    }
+    hllEncodeDeltas(deltas, right);
+}
+
+/* Apply encoded register updates to the HLL 'value'. The sparse representation is
+ * converted to sds once for all updates. Returns the number of registers updated, -1
+ * on an invalid representation or delta. Updates that changed a register are appended
+ * to 'applied' if it's not NULL. */
+static int hllApplyDeltas(std::string& value, const char* deltas, size_t len, uint32_t hll_sparse_max_bytes, std::string* applied)
+{
+    if (len % HLL_DELTA_SIZE != 0)
+    {
+        return -1;
+    }
+    struct hllhdr *hdr = (struct hllhdr *) (&value[0]);
+    sds sparse = NULL;
+    if (hdr->encoding == HLL_SPARSE)
+    {
+        sparse = sdsnewlen(value.data(), value.size());
+    }
+    else if (hdr->encoding != HLL_DENSE)
+    {
+        return -1;
+    }
+    int updated = 0;
+    const uint8_t* p = (const uint8_t*) deltas;
+    for (size_t i = 0; i < len; i += HLL_DELTA_SIZE)
+    {
+        long index = p[i] | ((long) p[i + 1] << 8);
+        uint8_t count = p[i + 2];
+        if (index >= HLL_REGISTERS || count > 64 - HLL_P + 1)
+        {
+            updated = -1;
+            break;
+        }
+        int retval;
+        if (NULL != sparse && ((struct hllhdr *) sparse)->encoding == HLL_SPARSE)
+        {
+            retval = hllSparseSet(&sparse, index, count, hll_sparse_max_bytes);
+        }
+        else if (NULL != sparse)
+        {
+            retval = hllDenseSet(((struct hllhdr *) sparse)->registers, index, count);
+        }
+        else
+        {
+            retval = hllDenseSet(hdr->registers, index, count);
+        }
+        if (retval < 0)
+        {
+            updated = -1;
+            break;
+        }
+        if (retval > 0)
+        {
+            updated++;
+            if (NULL != applied)
+            {
+                applied->append(deltas + i, HLL_DELTA_SIZE);
+            }
+        }
+    }
+    if (NULL != sparse)
+    {
+        if (updated > 0)
+        {
+            value.assign(sparse, sdslen(sparse));
+        }
+        sdsfree(sparse);
+    }
+    if (updated > 0)
+    {
+        HLL_INVALIDATE_CACHE((struct hllhdr *) (&value[0]));
+    }
+    return updated;
+}
+
 /* Merge by computing MAX(registers[i],hll[i]) the HyperLogLog 'hll'
  * with an array of uint8_t HLL_REGISTERS registers pointed by 'max'.
  *
@@ -1220,26 +1381,42 @@ int hllAdd(std::string& value, unsigned char *ele, size_t elesize, uint32_t hll_
  * or in some other way.
  *
  * If the HyperLogLog is sparse and is found to be invalid, REDIS_ERR
- * is returned, otherwise the function always succeeds. */
-int hllMerge(uint8_t *max, std::string& hll)
+ * is returned, otherwise the function always succeeds.
+ *
+ * Dense registers are unpacked 4 at a time from 3 bytes, sparse runs are
+ * merged as they are, zero runs are just skipped. */
+int hllMerge(uint8_t *max, const uint8_t *hll, size_t hlllen)
 {
-    struct hllhdr *hdr = (struct hllhdr *) &(hll[0]);
+    struct hllhdr *hdr = (struct hllhdr *) hll;
     int i;
 
     if (hdr->encoding == HLL_DENSE)
     {
+        const uint8_t *r = hdr->registers;
         uint8_t val;
 
-        for (i = 0; i < HLL_REGISTERS; i++)
+        for (i = 0; i < HLL_REGISTERS; i += 4, r += 3)
         {
-            HLL_DENSE_GET_REGISTER(val, hdr->registers, i);
+            uint32_t word = r[0] | ((uint32_t) r[1] << 8) | ((uint32_t) r[2] << 16);
+            if (0 == word)
+                continue;
+            val = word & HLL_REGISTER_MAX;
             if (val > max[i])
                 max[i] = val;
+            val = (word >> HLL_BITS) & HLL_REGISTER_MAX;
+            if (val > max[i + 1])
+                max[i + 1] = val;
+            val = (word >> (2 * HLL_BITS)) & HLL_REGISTER_MAX;
+            if (val > max[i + 2])
+                max[i + 2] = val;
+            val = (word >> (3 * HLL_BITS)) & HLL_REGISTER_MAX;
+            if (val > max[i + 3])
+                max[i + 3] = val;
         }
     }
     else
     {
-        uint8_t *p = (uint8_t*) &(hll[0]), *end = p + hll.size();
+        const uint8_t *p = hll, *end = p + hlllen;
         long runlen, regval;
 
         p += HLL_HDR_SIZE;
@@ -1262,6 +1439,8 @@ int hllMerge(uint8_t *max, std::string& hll)
             {
                 runlen = HLL_SPARSE_VAL_LEN(p);
                 regval = HLL_SPARSE_VAL_VALUE(p);
+                if (i + runlen > HLL_REGISTERS)
+                    return -1;
                 while (runlen--)
                 {
                     if (regval > max[i])
@@ -1277,6 +1456,11 @@ int hllMerge(uint8_t *max, std::string& hll)
     return 0;
 }
 
+int hllMerge(uint8_t *max, std::string& hll)
+{
+    return hllMerge(max, (const uint8_t*) hll.data(), hll.size());
+}
+
 /* ========================== HyperLogLog commands ========================== */
 
 /* Create an HLL object. We always create the HLL using sparse encoding.
@@ -1316,12 +1500,12 @@ void createHLLObject(std::string& value)
 /* Check if the object is a String with a valid HLL representation.
  * Return REDIS_OK if this is true, otherwise reply to the client
  * with an error and return REDIS_ERR. */
-bool isHLLObjectOrReply(std::string& value)
+bool isHLLObject(const uint8_t *value, size_t len)
 {
     struct hllhdr *hdr;
-    if (value.size() < sizeof(*hdr))
+    if (len < sizeof(*hdr))
         goto invalid;
-    hdr = (struct hllhdr *) (&value[0]);
+    hdr = (struct hllhdr *) value;
 
     /* Magic should be "HYLL". */
     if (hdr->magic[0] != 'H' || hdr->magic[1] != 'Y' || hdr->magic[2] != 'L' || hdr->magic[3] != 'L')
@@ -1331,7 +1515,7 @@ bool isHLLObjectOrReply(std::string& value)
         goto invalid;
 
     /* Dense representation string length should match exactly. */
-    if (hdr->encoding == HLL_DENSE && value.size() != HLL_DENSE_SIZE)
+    if (hdr->encoding == HLL_DENSE && len != HLL_DENSE_SIZE)
         goto invalid;
 
     /* All tests passed. */
@@ -1342,8 +1526,251 @@ bool isHLLObjectOrReply(std::string& value)
     return false;
 }
 
+bool isHLLObjectOrReply(std::string& value)
+{
+    return isHLLObject((const uint8_t*) value.data(), value.size());
+}
+
 namespace ardb
 {
+    /*
+     * A cached PFCOUNT result is keyed by its member keys, each encoded as
+     * [ns len][ns][key len][key] so the members can be recovered from the cache key.
+     */
+    static void encode_hll_card_member(const Data& ns, const Data& key, std::string& member)
+    {
+        std::string nsstr, keystr;
+        ns.ToString(nsstr);
+        key.ToString(keystr);
+        uint32 nslen = nsstr.size();
+        uint32 keylen = keystr.size();
+        member.append((const char*) &nslen, sizeof(nslen));
+        member.append(nsstr);
+        member.append((const char*) &keylen, sizeof(keylen));
+        member.append(keystr);
+    }
+
+    typedef std::vector<KeyPrefix> KeyPrefixArray;
+    static void decode_hll_card_members(const std::string& cache_key, KeyPrefixArray& members)
+    {
+        size_t cursor = 0;
+        while (cursor < cache_key.size())
+        {
+            std::string parts[2];
+            for (int i = 0; i < 2; i++)
+            {
+                uint32 len;
+                if (cursor + sizeof(len) > cache_key.size())
+                {
+                    return;
+                }
+                memcpy(&len, cache_key.data() + cursor, sizeof(len));
+                cursor += sizeof(len);
+                if (cursor + len > cache_key.size())
+                {
+                    return;
+                }
+                parts[i].assign(cache_key.data() + cursor, len);
+                cursor += len;
+            }
+            KeyPrefix member;
+            member.ns.SetString(parts[0], false);
+            member.key.SetString(parts[1], false);
+            members.push_back(member);
+        }
+    }
+
+    /*
+     * Members are always compared as strings, wrap the writer's key without copying it.
+     */
+    static void wrap_hll_card_member(const Data& ns, const Data& key, KeyPrefix& member, std::string& nsbuf,
+            std::string& keybuf)
+    {
+        if (ns.IsString())
+        {
+            member.ns.SetString(ns.CStr(), ns.StringLength(), false);
+        }
+        else
+        {
+            ns.ToString(nsbuf);
+            member.ns.SetString(nsbuf.data(), nsbuf.size(), false);
+        }
+        if (key.IsString())
+        {
+            member.key.SetString(key.CStr(), key.StringLength(), false);
+        }
+        else
+        {
+            key.ToString(keybuf);
+            member.key.SetString(keybuf.data(), keybuf.size(), false);
+        }
+    }
+
+    Ardb::HLLCardMemberShard& Ardb::GetHLLCardMemberShard(const KeyPrefix& member)
+    {
+        uint32 hash = 0;
+        MurmurHash3_x86_32(member.key.CStr(), member.key.StringLength(), 0, &hash);
+        return m_hll_card_members[hash % ARDB_WATCH_SHARDS];
+    }
+
+    /*
+     * Returns the cached cardinality of the key set, or -1 on a miss. On a miss a pending
+     * entry is registered and 'seq' identifies it, the result is only stored by
+     * SetHLLCardCache if no member was written meanwhile.
+     */
+    int64 Ardb::GetHLLCardCache(const std::string& cache_key, uint64& seq)
+    {
+        seq = 0;
+        if (GetConf().hll_card_cache_size <= 0 || IsLoadingData())
+        {
+            return -1;
+        }
+        LockGuard<SpinMutexLock> guard(m_hll_card_lock);
+        m_hll_cards.SetMaxCacheSize(GetConf().hll_card_cache_size);
+        HLLCardCacheEntry entry;
+        if (m_hll_cards.Get(cache_key, entry))
+        {
+            seq = entry.seq;
+            return entry.card;
+        }
+        entry.seq = ++m_hll_card_seq;
+        seq = entry.seq;
+        LinkHLLCardCache(cache_key);
+        HLLCardCache::CacheEntry erased;
+        if (m_hll_cards.Insert(cache_key, entry, erased) && erased.first != cache_key)
+        {
+            UnlinkHLLCardCache(erased.first);
+        }
+        m_hll_card_keys_num = m_hll_cards.Size();
+        return -1;
+    }
+
+    void Ardb::SetHLLCardCache(const std::string& cache_key, uint64 seq, uint64 card)
+    {
+        if (0 == seq)
+        {
+            return;
+        }
+        LockGuard<SpinMutexLock> guard(m_hll_card_lock);
+        HLLCardCacheEntry entry;
+        if (m_hll_cards.Peek(cache_key, entry) && entry.seq == seq)
+        {
+            entry.card = card;
+            HLLCardCache::CacheEntry erased;
+            m_hll_cards.Insert(cache_key, entry, erased);
+        }
+    }
+
+    /*
+     * Links/unlinks a cached key set to its members, caller holds m_hll_card_lock.
+     */
+    void Ardb::LinkHLLCardCache(const std::string& cache_key)
+    {
+        KeyPrefixArray members;
+        decode_hll_card_members(cache_key, members);
+        for (size_t i = 0; i < members.size(); i++)
+        {
+            HLLCardMemberShard& shard = GetHLLCardMemberShard(members[i]);
+            LockGuard<SpinMutexLock> guard(shard.lock);
+            shard.keys[members[i]].insert(cache_key);
+            shard.keys_num = shard.keys.size();
+        }
+    }
+
+    void Ardb::UnlinkHLLCardCache(const std::string& cache_key)
+    {
+        KeyPrefixArray members;
+        decode_hll_card_members(cache_key, members);
+        for (size_t i = 0; i < members.size(); i++)
+        {
+            HLLCardMemberShard& shard = GetHLLCardMemberShard(members[i]);
+            LockGuard<SpinMutexLock> guard(shard.lock);
+            HLLCardMemberTable::iterator found = shard.keys.find(members[i]);
+            if (found != shard.keys.end())
+            {
+                found->second.erase(cache_key);
+                if (found->second.empty())
+                {
+                    shard.keys.erase(found);
+                }
+            }
+            shard.keys_num = shard.keys.size();
+        }
+    }
+
+    void Ardb::InvalidateHLLCardCache(const Data& ns, const Data& key)
+    {
+        if (0 == m_hll_card_keys_num)
+        {
+            return;
+        }
+        KeyPrefix member;
+        std::string nsbuf, keybuf;
+        wrap_hll_card_member(ns, key, member, nsbuf, keybuf);
+        HLLCardMemberShard& shard = GetHLLCardMemberShard(member);
+        if (0 == shard.keys_num)
+        {
+            return;
+        }
+        StringTreeSet cache_keys;
+        {
+            LockGuard<SpinMutexLock> guard(shard.lock);
+            HLLCardMemberTable::iterator found = shard.keys.find(member);
+            if (found == shard.keys.end())
+            {
+                return;
+            }
+            cache_keys.swap(found->second);
+            shard.keys.erase(found);
+            shard.keys_num = shard.keys.size();
+        }
+        LockGuard<SpinMutexLock> guard(m_hll_card_lock);
+        StringTreeSet::iterator it = cache_keys.begin();
+        while (it != cache_keys.end())
+        {
+            HLLCardCacheEntry entry;
+            if (m_hll_cards.Erase(*it, entry))
+            {
+                UnlinkHLLCardCache(*it);
+            }
+            it++;
+        }
+        m_hll_card_keys_num = m_hll_cards.Size();
+    }
+
+    /*
+     * Writes inside an engine write batch are invisible until the batch commits, their cached
+     * counts are dropped once the outermost batch is done.
+     */
+    void Ardb::InvalidateBatchTouchedKeys(Context& ctx)
+    {
+        KeyPrefixSet::iterator it = ctx.batch_touched_keys.begin();
+        while (it != ctx.batch_touched_keys.end())
+        {
+            InvalidateHLLCardCache(it->ns, it->key);
+            it++;
+        }
+        ctx.batch_touched_keys.clear();
+    }
+
+    void Ardb::ClearHLLCardCache()
+    {
+        if (0 == m_hll_card_keys_num)
+        {
+            return;
+        }
+        LockGuard<SpinMutexLock> guard(m_hll_card_lock);
+        m_hll_cards.Clear();
+        for (uint32 i = 0; i < ARDB_WATCH_SHARDS; i++)
+        {
+            HLLCardMemberShard& shard = m_hll_card_members[i];
+            LockGuard<SpinMutexLock> shard_guard(shard.lock);
+            shard.keys.clear();
+            shard.keys_num = 0;
+        }
+        m_hll_card_keys_num = 0;
+    }
+
     int Ardb::MergePFAdd(Context& ctx, const KeyObject& key, ValueObject& meta, const DataArray& ms, int* up)
     {
         std::string hllvalue;
@@ -1392,6 +1819,52 @@ namespace ardb
         return updated ? 0 : ERR_NOTPERFORMED;
     }
 
+    /*
+     * Fold the register updates computed by PFADD into the stored HLL, 'applied' collects the updates which changed
+     * a register.
+     */
+    int Ardb::MergePFAddRegisters(Context& ctx, const KeyObject& key, ValueObject& meta, const Data& deltas,
+            std::string* applied)
+    {
+        std::string hllvalue;
+        int updated = 0;
+        if (meta.GetType() == 0)
+        {
+            createHLLObject(hllvalue);
+            meta.SetType(KEY_STRING);
+            updated++;
+        }
+        else
+        {
+            meta.GetStringValue().ToString(hllvalue);
+            if (!isHLLObjectOrReply(hllvalue))
+            {
+                return ERR_INVALID_HLL_STRING;
+            }
+        }
+        int retval = hllApplyDeltas(hllvalue, deltas.CStr(), deltas.StringLength(), (uint32_t) GetConf().hll_sparse_max_bytes,
+                applied);
+        if (retval < 0)
+        {
+            return ERR_CORRUPTED_HLL_OBJECT;
+        }
+        updated += retval;
+        if (updated)
+        {
+            meta.GetStringValue().SetString(hllvalue, false);
+        }
+        return updated ? 0 : ERR_NOTPERFORMED;
+    }
+
+    void Ardb::CombinePFAddRegisters(const Data& left, Data& right)
+    {
+        std::string left_deltas, right_deltas;
+        left.ToString(left_deltas);
+        right.ToString(right_deltas);
+        hllCombineDeltas(left_deltas, right_deltas);
+        right.SetString(right_deltas, false);
+    }
+
     /* PFADD var ele ele ele ... ele => :0 or :1 */
     int Ardb::PFAdd(Context& ctx, RedisCommandFrame& cmd)
     {
@@ -1399,15 +1872,18 @@ namespace ardb
         const std::string& keystr = cmd.GetArguments()[0];
         ctx.flags.create_if_notexist = 1;
         KeyObject key(ctx.ns, KEY_META, keystr);
-        DataArray args(cmd.GetArguments().size() - 1);
-        for (size_t i = 1; i < cmd.GetArguments().size(); i++)
-        {
-            args[i-1].SetString(cmd.GetArguments()[i], false);
-        }
+        /*
+         * hash the elements before taking the key lock, the stored HLL only receives the register updates, which is a
+         * few bytes merge operand on engines supporting merge instead of rewriting the whole(up to 12KB) value.
+         */
+        std::string deltas;
+        hllComputeDeltas(cmd.GetArguments(), 1, deltas);
+        DataArray args(1);
         int err = 0;
         if (!ctx.flags.redis_compatible)
         {
-            err = MergeKeyValue(ctx, key, cmd.GetType(), args);
+            args[0].SetString(deltas, false);
+            err = MergeKeyValue(ctx, key, REDIS_CMD_PFADD_REGISTERS, args);
             if (0 != err)
             {
                 reply.SetErrCode(err);
@@ -1418,18 +1894,29 @@ namespace ardb
             }
             return 0;
         }
-        ValueObject value;
-        int updated = 0;
         KeyLockGuard guard(ctx,key);
         ValueObject meta;
         if (!CheckMeta(ctx, key, KEY_STRING, meta))
         {
             return 0;
         }
-        err = MergePFAdd(ctx, key, meta,args, &updated);
-        if(0 == err && updated)
+        args[0].SetString(deltas, false);
+        std::string applied;
+        err = MergePFAddRegisters(ctx, key, meta, args[0], &applied);
+        if (0 == err)
         {
-            err = SetKeyValue(ctx, key, meta);
+            if (m_engine->GetFeatureSet().support_merge)
+            {
+                /*
+                 * only the updates changing a register are written, the value was validated above.
+                 */
+                args[0].SetString(applied, false);
+                err = MergeKeyValue(ctx, key, REDIS_CMD_PFADD_REGISTERS, args);
+            }
+            else
+            {
+                err = SetKeyValue(ctx, key, meta);
+            }
         }
         if (err != 0 && err != ERR_NOTPERFORMED)
         {
@@ -1437,7 +1924,7 @@ namespace ardb
         }
         else
         {
-            reply.SetInteger(updated ? 1 : 0);
+            reply.SetInteger(0 == err ? 1 : 0);
         }
         return 0;
 
@@ -1445,19 +1932,35 @@ namespace ardb
     /* PFCOUNT var -> approximated cardinality of set. */
     int Ardb::PFCount(Context& ctx, RedisCommandFrame& cmd)
     {
-        uint64 card = 0;
         RedisReply& reply = ctx.GetReply();
         reply.SetInteger(0); //default response
-        if (cmd.GetArguments().size() == 1)
+        KeyObjectArray keys;
+        std::string cache_key;
+        for (size_t i = 0; i < cmd.GetArguments().size(); i++)
+        {
+            KeyObject key(ctx.ns, KEY_META, cmd.GetArguments()[i]);
+            keys.push_back(key);
+            encode_hll_card_member(key.GetNameSpace(), key.GetKey(), cache_key);
+        }
+        uint64 cache_seq = 0;
+        int64 cached = GetHLLCardCache(cache_key, cache_seq);
+        if (cached >= 0)
+        {
+            reply.SetInteger(cached);
+            return 0;
+        }
+        bool cacheable = true;
+        uint64_t card = 0;
+        if (keys.size() == 1)
         {
-            KeyObject meta_key(ctx.ns, KEY_META, cmd.GetArguments()[0]);
             ValueObject meta;
-            if (!CheckMeta(ctx, meta_key, KEY_STRING, meta))
+            if (!CheckMeta(ctx, keys[0], KEY_STRING, meta))
             {
                 return 0;
             }
             if (meta.GetType() == 0)
             {
+                SetHLLCardCache(cache_key, cache_seq, 0);
                 return 0;
             }
             std::string hllvalue;
@@ -1468,7 +1971,6 @@ namespace ardb
                 return 0;
             }
             struct hllhdr *hdr;
-            uint64_t card = 0;
 
             /* Check if the cached cardinality is valid. */
             hdr = (struct hllhdr *) (&hllvalue[0]);
@@ -1487,73 +1989,94 @@ namespace ardb
             else
             {
                 int invalid = 0;
-                /* Recompute it and update the cached value. */
+                /*
+                 * Recompute it, the result is kept in the in-memory cache instead of
+                 * rewriting the header, so a read never turns into a storage write.
+                 */
                 card = hllCount(hdr, hllvalue.size(), &invalid);
                 if (invalid)
                 {
                     reply.SetErrCode(ERR_CORRUPTED_HLL_OBJECT);
                     return 0;
                 }
-                hdr->card[0] = card & 0xff;
-                hdr->card[1] = (card >> 8) & 0xff;
-                hdr->card[2] = (card >> 16) & 0xff;
-                hdr->card[3] = (card >> 24) & 0xff;
-                hdr->card[4] = (card >> 32) & 0xff;
-                hdr->card[5] = (card >> 40) & 0xff;
-                hdr->card[6] = (card >> 48) & 0xff;
-                hdr->card[7] = (card >> 56) & 0xff;
-                /* This is not considered a read-only command even if the
-                 * data structure is not modified, since the cached value
-                 * may be modified and given that the HLL is a Redis string
-                 * we need to propagate the change. */
-                //signalModifiedKey(c->db, c->argv[1]);
-                //server.dirty++;
-                meta.GetStringValue().SetString(hllvalue, false);
-                int err = SetKeyValue(ctx, meta_key, meta);
-                if (0 != err)
-                {
-                    reply.SetErrCode(err);
-                    return 0;
-                }
             }
-            reply.SetInteger(card);
-            return 0;
+            cacheable = meta.GetTTL() <= 0;
         }
-        uint8_t max[HLL_HDR_SIZE + HLL_REGISTERS], *registers;
-
-        /* Compute an HLL with M[i] = MAX(M[i]_j). */
-        memset(max, 0, sizeof(max));
-        struct hllhdr *hdr = (struct hllhdr*) max;
-        hdr->encoding = HLL_RAW; /* Special internal-only encoding. */
-        registers = max + HLL_HDR_SIZE;
-        for (uint32 i = 0; i < cmd.GetArguments().size(); i++)
+        else
         {
-            ValueObject hll;
-            if (!CheckMeta(ctx, cmd.GetArguments()[i], KEY_STRING, hll))
+            uint8_t max[HLL_HDR_SIZE + HLL_REGISTERS], *registers;
+
+            /* Compute an HLL with M[i] = MAX(M[i]_j). */
+            memset(max, 0, sizeof(max));
+            struct hllhdr *hdr = (struct hllhdr*) max;
+            hdr->encoding = HLL_RAW; /* Special internal-only encoding. */
+            registers = max + HLL_HDR_SIZE;
+
+            /*
+             * fetch all sources with one batched read instead of a point lookup per key
+             */
+            ValueObjectArray vals;
+            ErrCodeArray errs;
+            int err = m_engine->MultiGet(ctx, keys, vals, errs);
+            if (0 != err)
             {
+                reply.SetErrCode(err);
                 return 0;
             }
-            if (hll.GetType() == 0)
-            {
-                continue;
-            }
-            std::string hllvalue;
-            hll.GetStringValue().ToString(hllvalue);
-            if (!isHLLObjectOrReply(hllvalue))
+            for (size_t i = 0; i < keys.size(); i++)
             {
-                reply.SetErrCode(ERR_INVALID_HLL_STRING);
-                return 0;
-            }
+                if (0 != errs[i] && ERR_ENTRY_NOT_EXIST != errs[i])
+                {
+                    reply.SetErrCode(errs[i]);
+                    return 0;
+                }
+                if (!CheckMeta(ctx, keys[i], KEY_STRING, vals[i], false))
+                {
+                    return 0;
+                }
+                if (vals[i].GetType() == 0)
+                {
+                    continue;
+                }
+                if (vals[i].GetTTL() > 0)
+                {
+                    cacheable = false;
+                }
+                const Data& hll = vals[i].GetStringValue();
+                std::string hllvalue;
+                const uint8_t* hllptr = NULL;
+                size_t hlllen = 0;
+                if (hll.IsString())
+                {
+                    hllptr = (const uint8_t*) hll.CStr();
+                    hlllen = hll.StringLength();
+                }
+                else
+                {
+                    hll.ToString(hllvalue);
+                    hllptr = (const uint8_t*) hllvalue.data();
+                    hlllen = hllvalue.size();
+                }
+                if (!isHLLObject(hllptr, hlllen))
+                {
+                    reply.SetErrCode(ERR_INVALID_HLL_STRING);
+                    return 0;
+                }
 
-            /* Merge with this HLL with our 'max' HHL by setting max[i]
-             * to MAX(max[i],hll[i]). */
-            if (hllMerge(registers, hllvalue) == -1)
-            {
-                reply.SetErrCode(ERR_CORRUPTED_HLL_OBJECT);
-                return 0;
+                /* Merge with this HLL with our 'max' HHL by setting max[i]
+                 * to MAX(max[i],hll[i]). */
+                if (hllMerge(registers, hllptr, hlllen) == -1)
+                {
+                    reply.SetErrCode(ERR_CORRUPTED_HLL_OBJECT);
+                    return 0;
+                }
             }
+            card = hllCount(hdr, sizeof(max), NULL);
+        }
+        if (cacheable)
+        {
+            SetHLLCardCache(cache_key, cache_seq, card);
         }
-        card = hllCount(hdr, sizeof(max), NULL);
         reply.SetInteger(card);
         return 0;
     }
@@ -281,9 +281,19 @@ OP_NAMESPACE_BEGIN
                 }
             }
         }
+        KeyPattern kp(pattern.empty() ? "*" : pattern);
+        if (cmd.GetType() == REDIS_CMD_SCAN && cursor_element.compare(kp.prefix) < 0)
+        {
+            /*
+             * no key before the pattern prefix could match, start at the prefix directly
+             */
+            startkey.SetKey(kp.prefix);
+            skip_first = false;
+        }
         RedisReply& r1 = reply.AddMember();
         RedisReply& r2 = reply.AddMember();
         r2.ReserveMember(0);
+        bool scan_done = false;
         uint32 scan_count_limit = limit * 10;
         uint32 scan_count = 0;
         int64_t result_count = 0;
@@ -298,6 +308,12 @@ OP_NAMESPACE_BEGIN
             KeyObject& k = iter->Key();
             if (cmd.GetType() == REDIS_CMD_SCAN)
             {
+                k.GetKey().ToString(match_element);
+                if (!kp.InRange(match_element))
+                {
+                    scan_done = true;
+                    break;
+                }
                 if (k.GetType() != KEY_META)
                 {
                     //iter->Next();
@@ -305,7 +321,6 @@ OP_NAMESPACE_BEGIN
                     iter->Jump(next);
                     continue;
                 }
-                k.GetKey().ToString(match_element);
             }
             else
             {
@@ -328,14 +343,10 @@ OP_NAMESPACE_BEGIN
                 }
             }
             scan_count++;
-            if (!pattern.empty())
+            if (!kp.Match(match_element))
             {
-                if (stringmatchlen(pattern.c_str(), pattern.size(), match_element.c_str(), match_element.size(), 0)
-                        != 1)
-                {
-                    iter->Next();
-                    continue;
-                }
+                iter->Next();
+                continue;
             }
             result_count++;
             switch (k.GetType())
@@ -379,7 +390,7 @@ OP_NAMESPACE_BEGIN
             }
             iter->Next();
         }
-        if (!iter->Valid())
+        if (scan_done || !iter->Valid())
         {
             r1.SetString("0");
         }
@@ -394,32 +405,40 @@ OP_NAMESPACE_BEGIN
         return 0;
     }
 
-    int Ardb::Keys(Context& ctx, RedisCommandFrame& cmd)
+    KeyPattern::KeyPattern(const std::string& p)
+            : pattern(p), literal(false), prefix_only(false)
     {
-        const std::string& pattern = cmd.GetArguments()[0];
-        std::string start;
         for (size_t i = 0; i < pattern.size(); i++)
         {
-            if (pattern[i] != '*' && pattern[i] != '?' && pattern[i] != '[' && pattern[i] != '\\')
-            {
-                start.append(pattern[i], 1);
-            }
-            else
+            if (pattern[i] == '*' || pattern[i] == '?' || pattern[i] == '[' || pattern[i] == '\\')
             {
                 break;
             }
+            prefix.append(1, pattern[i]);
         }
-        RedisReply& reply = ctx.GetReply();
-        if (cmd.GetType() == REDIS_CMD_KEYS)
+        literal = prefix.size() == pattern.size();
+        prefix_only = pattern.size() == prefix.size() + 1 && pattern[prefix.size()] == '*';
+    }
+
+    bool KeyPattern::Match(const std::string& key) const
+    {
+        if (literal)
         {
-            reply.ReserveMember(0);
+            return key == pattern;
         }
-        else
+        if (prefix_only)
         {
-            reply.SetInteger(0);
+            return InRange(key);
         }
+        return stringmatchlen(pattern.c_str(), pattern.size(), key.c_str(), key.size(), 0) == 1;
+    }
 
-        bool noregex = start == pattern;
+    /*
+     * Iterate meta keys in [start, end) matching the pattern, 'end' empty means till the end of the pattern prefix.
+     * Matched keys are appended to 'reply' if it's not NULL.
+     */
+    int64 Ardb::MatchKeys(Context& ctx, const KeyPattern& pattern, const std::string& start, const std::string& end, RedisReply* reply)
+    {
         int64_t match_count = 0;
         KeyObject startkey(ctx.ns, KEY_META, start);
         ctx.flags.iterate_multi_keys = 1;
@@ -429,39 +448,38 @@ OP_NAMESPACE_BEGIN
          */
         ctx.flags.iterate_total_order = 1;
         Iterator* iter = m_engine->Find(ctx, startkey);
+        std::string keystr;
         while (iter->Valid())
         {
             KeyObject& k = iter->Key();
-            if (k.GetType() == KEY_META)
+            k.GetKey().ToString(keystr);
+            if (!pattern.InRange(keystr) || (!end.empty() && keystr.compare(end) >= 0))
             {
-                std::string keystr;
-                k.GetKey().ToString(keystr);
-                if (stringmatchlen(pattern.c_str(), pattern.size(), keystr.c_str(), keystr.size(), 0) == 1)
+                break;
+            }
+            if (k.GetType() == KEY_META && pattern.Match(keystr))
+            {
+                match_count++;
+                if (NULL != reply)
                 {
-                    match_count++;
-                    if (cmd.GetType() == REDIS_CMD_KEYS)
-                    {
-                        RedisReply& r = reply.AddMember();
-                        r.SetString(keystr);
-                    }
+                    RedisReply& r = reply->AddMember();
+                    r.SetString(keystr);
                     /*
                      * limit keys output
                      */
-                    if (match_count >= 10000 && cmd.GetType() == REDIS_CMD_KEYS)
-                    {
-                        reply.SetErrorReason("Too many keys for keys command, use 'scan' instead.");
-                        break;
-                    }
-                    if (noregex)
+                    if (match_count >= 10000)
                     {
+                        reply->SetErrorReason("Too many keys for keys command, use 'scan' instead.");
                         break;
                     }
                 }
+                if (pattern.literal)
+                {
+                    break;
+                }
             }
             if (iter->Value().GetType() != KEY_STRING)
             {
-                std::string keystr;
-                k.GetKey().ToString(keystr);
                 keystr.append(1, 0);
                 KeyObject next(ctx.ns, KEY_META, keystr);
                 iter->Jump(next);
@@ -470,9 +488,22 @@ OP_NAMESPACE_BEGIN
             iter->Next();
         }
         DELETE(iter);
-        if (cmd.GetType() == REDIS_CMD_KEYSCOUNT)
+        return match_count;
+    }
+
+    int Ardb::Keys(Context& ctx, RedisCommandFrame& cmd)
+    {
+        const std::string& pattern = cmd.GetArguments()[0];
+        RedisReply& reply = ctx.GetReply();
+        if (cmd.GetType() == REDIS_CMD_KEYS)
         {
-            reply.SetInteger(match_count);
+            reply.ReserveMember(0);
+            KeyPattern kp(pattern);
+            MatchKeys(ctx, kp, kp.prefix, "", &reply);
+        }
+        else
+        {
+            reply.SetInteger(ParallelKeysCount(ctx, pattern));
         }
         return 0;
     }
@@ -872,22 +903,7 @@ OP_NAMESPACE_BEGIN
         ValueObject meta_obj;
         if (0 == m_engine->Get(ctx, meta_key, meta_obj))
         {
-            /*
-             * need delete ttl sort key with ttl value
-             */
-            if (m_engine->GetFeatureSet().support_compactfilter)
-            {
-                int64 ttl = meta_obj.GetTTL();
-                if (ttl > 0)
-                {
-                    Data tll_ns(TTL_DB_NSMAESPACE, false);
-                    KeyObject new_ttl_key(tll_ns, KEY_TTL_SORT, "");
-                    new_ttl_key.SetTTL(ttl);
-                    new_ttl_key.SetTTLKeyNamespace(meta_key.GetNameSpace());
-                    new_ttl_key.SetTTLKey(meta_key.GetKey().AsString());
-                    m_engine->Del(ctx, new_ttl_key);
-                }
-            }
+            RemoveTTLIndex(ctx, meta_key, meta_obj.GetTTL());
             if (meta_obj.GetType() == KEY_STRING)
             {
                 int err = RemoveKey(ctx, meta_key);
@@ -899,39 +915,27 @@ OP_NAMESPACE_BEGIN
             return 0;
         }
         int removed = 0;
+        bool range_deleted = false;
         if (m_engine->GetFeatureSet().support_delete_range
                 && (meta_obj.GetObjectLen() < 0 || meta_obj.GetObjectLen() >= GetConf().range_delete_min_size))
         {
             KeyObject end(ctx.ns, KEY_END, meta_key.GetKey());
-            m_engine->DelRange(ctx, meta_key, end);
-            removed = 1;
-        }
-        else
-        {
-            if (NULL == iter)
-            {
-                iter = m_engine->Find(ctx, meta_key);
-            }
-            else
-            {
-                iter->Jump(meta_key);
-            }
-            while (NULL != iter && iter->Valid())
+            /*
+             * engine may refuse range deletion in current state(e.g. lmdb with living iterators in same thread),
+             * fallback to element by element deletion then.
+             */
+            range_deleted = (0 == m_engine->DelRange(ctx, meta_key, end));
+            if (range_deleted)
             {
-                KeyObject& k = iter->Key();
-                const Data& kdata = k.GetKey();
-                if (k.GetNameSpace().Compare(meta_key.GetNameSpace()) != 0
-                        || kdata.StringLength() != meta_key.GetKey().StringLength()
-                        || strncmp(meta_key.GetKey().CStr(), kdata.CStr(), kdata.StringLength()) != 0)
-                {
-                    break;
-                }
                 removed = 1;
-                iter->Del();
-                //RemoveKey(ctx, k);
-                iter->Next();
+                atomic_add_uint64(&m_range_delete_count, 1);
+                ScheduleRangeCompaction(ctx, meta_key);
             }
         }
+        if (!range_deleted)
+        {
+            removed = RemoveElements(ctx, meta_key, iter);
+        }
         if(meta_obj.GetType() == KEY_STREAM)
         {
             StreamDel(ctx, meta_key);
@@ -944,6 +948,104 @@ OP_NAMESPACE_BEGIN
         return removed;
     }
 
+    /*
+     * need delete ttl sort key with ttl value
+     */
+    void Ardb::RemoveTTLIndex(Context& ctx, const KeyObject& meta_key, int64 ttl)
+    {
+        if (ttl > 0 && m_engine->GetFeatureSet().support_compactfilter)
+        {
+            Data tll_ns(TTL_DB_NSMAESPACE, false);
+            KeyObject new_ttl_key(tll_ns, KEY_TTL_SORT, "");
+            new_ttl_key.SetTTL(ttl);
+            new_ttl_key.SetTTLKeyNamespace(meta_key.GetNameSpace());
+            new_ttl_key.SetTTLKey(meta_key.GetKey().AsString());
+            m_engine->Del(ctx, new_ttl_key);
+        }
+    }
+
+    /*
+     * Delete every key(meta & elements) prefixed by 'meta_key' one by one, return 1 if anything removed.
+     */
+    int Ardb::RemoveElements(Context& ctx, const KeyObject& meta_key, Iterator*& iter)
+    {
+        int removed = 0;
+        if (NULL == iter)
+        {
+            iter = m_engine->Find(ctx, meta_key);
+        }
+        else
+        {
+            iter->Jump(meta_key);
+        }
+        while (NULL != iter && iter->Valid())
+        {
+            KeyObject& k = iter->Key();
+            const Data& kdata = k.GetKey();
+            if (k.GetNameSpace().Compare(meta_key.GetNameSpace()) != 0
+                    || kdata.StringLength() != meta_key.GetKey().StringLength()
+                    || strncmp(meta_key.GetKey().CStr(), kdata.CStr(), kdata.StringLength()) != 0)
+            {
+                break;
+            }
+            removed = 1;
+            iter->Del();
+            //RemoveKey(ctx, k);
+            iter->Next();
+        }
+        return removed;
+    }
+
+    /*
+     * Delete a big collection in O(1) on engines without range deletion: only the meta key is removed here, the
+     * elements are purged by a background worker. The caller must hold the key lock, it's kept locked until the
+     * purge finished so that no one could recreate the key over the stale elements.
+     */
+    int Ardb::DelKeyLazily(Context& ctx, const KeyObject& meta_key, Iterator*& iter)
+    {
+        KeyPrefix lk;
+        lk.ns = meta_key.GetNameSpace();
+        lk.key = meta_key.GetKey();
+        if (!GetConf().redis_compatible || m_engine->GetFeatureSet().support_delete_range || m_background_workers.empty()
+                || ctx.InTransaction() || ctx.IsKeyLocked(lk))
+        {
+            return DelKey(ctx, meta_key, iter);
+        }
+        ValueObject meta_obj;
+        if (0 != m_engine->Get(ctx, meta_key, meta_obj))
+        {
+            return 0;
+        }
+        switch (meta_obj.GetType())
+        {
+            case KEY_HASH:
+            case KEY_LIST:
+            case KEY_SET:
+            case KEY_ZSET:
+            {
+                break;
+            }
+            default:
+            {
+                return DelKey(ctx, meta_key, iter);
+            }
+        }
+        if (meta_obj.GetObjectLen() >= 0 && meta_obj.GetObjectLen() < GetConf().range_delete_min_size)
+        {
+            return DelKey(ctx, meta_key, iter);
+        }
+        RemoveTTLIndex(ctx, meta_key, meta_obj.GetTTL());
+        int err = m_engine->Del(ctx, meta_key);
+        if (0 != err)
+        {
+            return DelKey(ctx, meta_key, iter);
+        }
+        ScheduleElementsPurge(ctx, meta_key);
+        TouchWatchKey(ctx, meta_key);
+        ctx.dirty++;
+        return 1;
+    }
+
     int Ardb::Unlink(Context& ctx, RedisCommandFrame& cmd)
     {
         RedisReply& reply = ctx.GetReply();
@@ -951,8 +1053,22 @@ OP_NAMESPACE_BEGIN
 
         for (size_t i = 0; i < cmd.GetArguments().size(); i++)
         {
-        	AsyncDeleteKey(ctx, ctx.ns, cmd.GetArguments()[i]);
-            removed++;
+            int err = AsyncDeleteKey(ctx, ctx.ns, cmd.GetArguments()[i]);
+            if (0 == err)
+            {
+                removed++;
+                continue;
+            }
+            /*
+             * no background worker took the key, delete it in place instead.
+             */
+            WARN_LOG("Failed to submit async delete for key:%s with err:%d", cmd.GetArguments()[i].c_str(), err);
+            KeyObject meta(ctx.ns, KEY_META, cmd.GetArguments()[i]);
+            KeyLockGuard guard(ctx, meta);
+            if (DelKey(ctx, meta) > 0)
+            {
+                removed++;
+            }
         }
         reply.SetInteger(removed);
         return 0;
@@ -968,7 +1084,7 @@ OP_NAMESPACE_BEGIN
         {
             KeyObject meta(ctx.ns, KEY_META, cmd.GetArguments()[i]);
             KeyLockGuard guard(ctx, meta);
-            removed += DelKey(ctx, meta, iter);
+            removed += GetConf().lazyfree_lazy_user_del ? DelKeyLazily(ctx, meta, iter) : DelKey(ctx, meta, iter);
         }
         DELETE(iter);
 
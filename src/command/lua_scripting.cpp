@@ -35,6 +35,7 @@
 #include "thread/spin_mutex_lock.hpp"
 #include "thread/thread_mutex_lock.hpp"
 #include "util/file_helper.hpp"
+#include "util/murmur3.h"
 #include <string.h>
 #include <limits>
 #include <math.h>
@@ -331,48 +332,87 @@ namespace ardb
         return 0;
     }
 
-    typedef TreeMap<std::string, std::string>::Type ScriptCache;
+    /*
+     * Process wide script registry shared by all worker threads, scripts are stored once as compiled lua
+     * bytecode keyed by their sha1, so an interpreter missing a script only needs to undump it.
+     * It's a read-mostly table, writes only happen on the first EVAL/SCRIPT LOAD of a script & SCRIPT FLUSH.
+     */
+    struct LuaScript
+    {
+            std::string body;
+            std::string bytecode;
+    };
+    class LuaScriptRegistry
+    {
+        private:
+            typedef google::dense_hash_map<std::string, LuaScript> ScriptTable;
+            ScriptTable m_scripts;
+            SpinRWLock m_lock;
+        public:
+            LuaScriptRegistry()
+            {
+                m_scripts.set_empty_key("");
+            }
+            bool Exists(const std::string& sha1)
+            {
+                RWLockGuard<SpinRWLock> guard(m_lock, true);
+                return m_scripts.find(sha1) != m_scripts.end();
+            }
+            bool GetBody(const std::string& sha1, std::string& body)
+            {
+                RWLockGuard<SpinRWLock> guard(m_lock, true);
+                ScriptTable::const_iterator found = m_scripts.find(sha1);
+                if (found == m_scripts.end())
+                {
+                    return false;
+                }
+                body = found->second.body;
+                return true;
+            }
+            bool GetBytecode(const std::string& sha1, std::string& bytecode)
+            {
+                RWLockGuard<SpinRWLock> guard(m_lock, true);
+                ScriptTable::const_iterator found = m_scripts.find(sha1);
+                if (found == m_scripts.end())
+                {
+                    return false;
+                }
+                bytecode = found->second.bytecode;
+                return true;
+            }
+            void Put(const std::string& sha1, const std::string& body, const std::string& bytecode)
+            {
+                RWLockGuard<SpinRWLock> guard(m_lock, false);
+                LuaScript& script = m_scripts[sha1];
+                script.body = body;
+                script.bytecode = bytecode;
+            }
+            void Clear()
+            {
+                RWLockGuard<SpinRWLock> guard(m_lock, false);
+                m_scripts.clear();
+            }
+    };
+
     typedef TreeSet<LuaExecContext*>::Type ExecContextSet;
     static SpinMutexLock g_lua_lock;
-    static ScriptCache g_script_cache;
+    static LuaScriptRegistry g_script_registry;
     static ExecContextSet g_script_ctxs;
 
+    /*
+     * EVAL bodies are fingerprinted with a small per interpreter direct mapped cache, comparing the body
+     * with the cached one is much cheaper than computing sha1 of it on every call.
+     */
+    static const size_t kScriptFingerprintCacheSize = 64;
+    static const size_t kScriptFingerprintMaxBody = 64 * 1024;
+
     LUAInterpreter::LUAInterpreter() :
-            m_lua(NULL)
+            m_lua(NULL), m_fingerprints(NULL)
     {
+        m_fingerprints = new ScriptFingerprint[kScriptFingerprintCacheSize];
         Init();
     }
 
-    static std::string* get_script_from_cache(const std::string& funcname)
-    {
-        LockGuard<SpinMutexLock> guard(g_lua_lock);
-        ScriptCache::iterator found = g_script_cache.find(funcname);
-        if (found == g_script_cache.end())
-        {
-            return NULL;
-        }
-        return &(found->second);
-    }
-
-    static void save_script_to_cache(const std::string& funcname, const std::string& body)
-    {
-        LockGuard<SpinMutexLock> guard(g_lua_lock);
-        if (body == "")
-        {
-            g_script_cache.erase(funcname);
-        }
-        else
-        {
-            g_script_cache[funcname] = body;
-        }
-    }
-
-    static void clear_script_cache()
-    {
-        LockGuard<SpinMutexLock> guard(g_lua_lock);
-        g_script_cache.clear();
-    }
-
     static void save_exec_ctx(LuaExecContext* ctx)
     {
         LockGuard<SpinMutexLock> guard(g_lua_lock);
@@ -398,6 +438,12 @@ namespace ardb
         }
     }
 
+    static int lua_bytecode_writer(lua_State *lua, const void* p, size_t sz, void* ud)
+    {
+        ((std::string*) ud)->append((const char*) p, sz);
+        return 0;
+    }
+
     /* Define a lua function with the specified function name and body.
      * The function name musts be a 2 characters long string, since all the
      * functions we defined in the Lua context are in the form:
@@ -421,6 +467,11 @@ namespace ardb
             lua_pop(m_lua, 1);
             return -1;
         }
+        /*
+         * dump the compiled chunk before running it, other interpreters would load the bytecode directly.
+         */
+        std::string bytecode;
+        lua_dump(m_lua, lua_bytecode_writer, &bytecode);
         if (lua_pcall(m_lua, 0, 0, 0))
         {
             err.append("Error running script (new function): ").append(lua_tostring(m_lua, -1)).append("\n");
@@ -431,10 +482,47 @@ namespace ardb
         /* We also save a SHA1 -> Original script map in a dictionary
          * so that we can replicate / write in the AOF all the
          * EVALSHA commands as EVAL using the original script. */
-        save_script_to_cache(funcname, body);
+        g_script_registry.Put(funcname.substr(2), body, bytecode);
+        return 0;
+    }
+
+    /*
+     * Define a lua function from the bytecode compiled by another interpreter, no parse needed.
+     */
+    int LUAInterpreter::LoadLuaFunction(const std::string& funcname, const std::string& bytecode, std::string& err)
+    {
+        if (luaL_loadbuffer(m_lua, bytecode.data(), bytecode.size(), "@user_script"))
+        {
+            err.append("Error loading script (new function): ").append(lua_tostring(m_lua, -1)).append("\n");
+            lua_pop(m_lua, 1);
+            return -1;
+        }
+        if (lua_pcall(m_lua, 0, 0, 0))
+        {
+            err.append("Error running script (new function): ").append(lua_tostring(m_lua, -1)).append("\n");
+            lua_pop(m_lua, 1);
+            return -1;
+        }
         return 0;
     }
 
+    std::string LUAInterpreter::GetScriptSHA1(const std::string& body)
+    {
+        if (body.size() > kScriptFingerprintMaxBody)
+        {
+            return sha1_sum(body);
+        }
+        uint32 hash = 0;
+        MurmurHash3_x86_32(body.data(), body.size(), 0, &hash);
+        ScriptFingerprint& fp = m_fingerprints[hash % kScriptFingerprintCacheSize];
+        if (fp.sha1.empty() || fp.body != body)
+        {
+            fp.body = body;
+            fp.sha1 = sha1_sum(body);
+        }
+        return fp.sha1;
+    }
+
     int LUAInterpreter::LoadLibs()
     {
         luaLoadLib(m_lua, "", luaopen_base);
@@ -472,10 +560,180 @@ namespace ardb
             }
     };
 
+    /*
+     * Per thread state reused by every redis.call/redis.pcall: resolved command handlers keyed by the
+     * command name exactly as written in scripts, and a command frame whose argument strings keep their
+     * capacity between calls.
+     */
+    struct LuaCallCache
+    {
+            typedef google::dense_hash_map<std::string, Ardb::RedisCommandHandlerSetting*> HandlerTable;
+            HandlerTable handlers;
+            std::string name;
+            std::string element;
+            RedisCommandFrame frame;
+            LuaCallCache()
+            {
+                handlers.set_empty_key("");
+            }
+    };
+    static ThreadLocal<LuaCallCache> g_lua_call_cache;
+
+    static void luaPushData(lua_State *lua, const Data& data)
+    {
+        if (data.IsString())
+        {
+            lua_pushlstring(lua, data.CStr(), data.StringLength());
+        }
+        else
+        {
+            std::string str;
+            data.ToString(str);
+            lua_pushlstring(lua, str.data(), str.size());
+        }
+    }
+
+    /*
+     * Hot read commands executed directly against the engine with arguments borrowed from the lua stack,
+     * the result is pushed as lua value without building a RedisReply.
+     * Return false if the command is not handled here, errors are left in ctx's reply.
+     */
+    bool LUAInterpreter::CallArdbFast(lua_State *lua, Context& ctx, int type, int argc)
+    {
+        int expected_argc = (type == REDIS_CMD_GET || type == REDIS_CMD_EXISTS) ? 2 : 3;
+        if (argc != expected_argc)
+        {
+            return false;
+        }
+        size_t keylen = 0;
+        const char* keystr = lua_tolstring(lua, 2, &keylen);
+        Data key;
+        key.SetString(keystr, keylen, false);
+        RedisReply& reply = ctx.GetReply();
+        LuaCallCache& cache = g_lua_call_cache.GetValue();
+        switch (type)
+        {
+            case REDIS_CMD_GET:
+            {
+                KeyObject keyobj(ctx.ns, KEY_META, key);
+                ValueObject v;
+                if (!g_db->CheckMeta(ctx, keyobj, KEY_STRING, v))
+                {
+                    return true;
+                }
+                if (v.GetType() == 0)
+                {
+                    lua_pushboolean(lua, 0);
+                }
+                else
+                {
+                    luaPushData(lua, v.GetStringValue());
+                }
+                return true;
+            }
+            case REDIS_CMD_EXISTS:
+            {
+                KeyObject keyobj(ctx.ns, KEY_META, key);
+                ValueObject v;
+                bool existed = g_db->m_engine->Exists(ctx, keyobj, v);
+                if (existed)
+                {
+                    bool expired = false;
+                    g_db->CheckMeta(ctx, keyobj, KEY_UNKNOWN, v, false, &expired);
+                    existed = !expired;
+                }
+                lua_pushnumber(lua, existed ? 1 : 0);
+                return true;
+            }
+            case REDIS_CMD_HGET:
+            {
+                size_t len = 0;
+                const char* field = lua_tolstring(lua, 3, &len);
+                cache.element.assign(field, len);
+                KeyObjectArray keys(2);
+                keys[0] = KeyObject(ctx.ns, KEY_META, key);
+                keys[1] = KeyObject(ctx.ns, KEY_HASH_FIELD, key);
+                keys[1].SetHashField(cache.element);
+                ValueObjectArray vals;
+                ErrCodeArray errs;
+                g_db->m_engine->MultiGet(ctx, keys, vals, errs);
+                if (errs[0] != 0 || errs[1] != 0)
+                {
+                    int err = errs[0] != 0 ? errs[0] : errs[1];
+                    if (err != ERR_ENTRY_NOT_EXIST)
+                    {
+                        reply.SetErrCode(err);
+                    }
+                    else
+                    {
+                        lua_pushboolean(lua, 0);
+                    }
+                    return true;
+                }
+                if (vals[0].GetType() > 0 && vals[0].GetType() != KEY_HASH)
+                {
+                    reply.SetErrCode(ERR_WRONG_TYPE);
+                }
+                else if (vals[1].GetHashValue().IsNil())
+                {
+                    lua_pushboolean(lua, 0);
+                }
+                else
+                {
+                    luaPushData(lua, vals[1].GetHashValue());
+                }
+                return true;
+            }
+            case REDIS_CMD_ZSCORE:
+            {
+                size_t len = 0;
+                const char* member = lua_tolstring(lua, 3, &len);
+                Data member_data;
+                member_data.SetString(member, len, false);
+                KeyObject score_key(ctx.ns, KEY_ZSET_SCORE, key);
+                score_key.SetZSetMember(member_data);
+                ValueObject score;
+                int err = g_db->m_engine->Get(ctx, score_key, score);
+                if (0 != err)
+                {
+                    if (err != ERR_ENTRY_NOT_EXIST)
+                    {
+                        reply.SetErrCode(err);
+                    }
+                    else
+                    {
+                        lua_pushboolean(lua, 0);
+                    }
+                }
+                else
+                {
+                    char buf[256];
+                    int slen = lf2string(buf, sizeof(buf) - 1, score.GetZSetScore());
+                    lua_pushlstring(lua, buf, slen);
+                }
+                return true;
+            }
+            case REDIS_CMD_SISMEMBER:
+            {
+                size_t len = 0;
+                const char* member = lua_tolstring(lua, 3, &len);
+                cache.element.assign(member, len);
+                KeyObject member_key(ctx.ns, KEY_SET_MEMBER, key);
+                member_key.SetSetMember(cache.element);
+                ValueObject tmp;
+                lua_pushnumber(lua, g_db->m_engine->Exists(ctx, member_key, tmp) ? 1 : 0);
+                return true;
+            }
+            default:
+            {
+                return false;
+            }
+        }
+    }
+
     int LUAInterpreter::CallArdb(lua_State *lua, bool raise_error)
     {
         int j, argc = lua_gettop(lua);
-        ArgumentArray cmdargs;
 
         /* Require at least one argument */
         if (argc == 0)
@@ -484,34 +742,51 @@ namespace ardb
             return 1;
         }
 
-        /* Build the arguments vector */
+        /* Check if one of the arguments passed by the Lua script
+         * is not a string or an integer (lua_isstring() return true for
+         * integers as well). */
         for (j = 0; j < argc; j++)
         {
             if (!lua_isstring(lua, j + 1)) break;
-            std::string arg;
-            arg.append(lua_tostring(lua, j + 1), lua_strlen(lua, j + 1));
-            cmdargs.push_back(arg);
         }
-
-        /* Check if one of the arguments passed by the Lua script
-         * is not a string or an integer (lua_isstring() return true for
-         * integers as well). */
         if (j != argc)
         {
             luaPushError(lua, "Lua redis() command arguments must be strings or integers");
             return 1;
         }
 
-        /* Setup our fake client for command execution */
-
-        RedisCommandFrame cmd(cmdargs);
-        Ardb::RedisCommandHandlerSetting* setting = g_db->FindRedisCommandHandlerSetting(cmd);
-        /* Command lookup */
+        /* Command lookup, resolved handlers are cached per thread by the lowercase name as m_settings */
+        LuaCallCache& cache = g_lua_call_cache.GetValue();
+        size_t namelen = 0;
+        const char* name = lua_tolstring(lua, 1, &namelen);
+        cache.name.assign(name, namelen);
+        lower_string(cache.name);
+        Ardb::RedisCommandHandlerSetting* setting = NULL;
+        LuaCallCache::HandlerTable::iterator found = cache.handlers.find(cache.name);
+        if (found != cache.handlers.end())
+        {
+            setting = found->second;
+        }
+        else if (!cache.name.empty())
+        {
+            Ardb::RedisCommandHandlerSettingTable::iterator sit = g_db->m_settings.find(cache.name);
+            if (sit != g_db->m_settings.end())
+            {
+                setting = &(sit->second);
+                cache.handlers[cache.name] = setting;
+            }
+        }
         if (NULL == setting)
         {
             luaPushError(lua, "Unknown Redis command called from Lua script");
             return -1;
         }
+        if ((setting->min_arity > 0 && argc - 1 < setting->min_arity)
+                || (setting->max_arity >= 0 && argc - 1 > setting->max_arity))
+        {
+            luaPushError(lua, "Wrong number of args calling Redis command From Lua script");
+            return -1;
+        }
 
         /* There are commands that are not allowed inside scripts. */
         if (!setting->IsAllowedInScript())
@@ -540,7 +815,35 @@ namespace ardb
         lua_ctx.ClearFlags();
         lua_ctx.flags.lua = 1;
 
-        g_db->DoCall(lua_ctx, *setting, cmd);
+        /*
+         * monitors need the full command frame, only take the fast path without them.
+         */
+        bool handled = false;
+        if (NULL == g_db->m_monitors)
+        {
+            atomic_add_uint32(&g_db->m_db_caller_num, 1);
+            handled = CallArdbFast(lua, lua_ctx, setting->type, argc);
+            atomic_sub_uint32(&g_db->m_db_caller_num, 1);
+            if (handled && reply.type != REDIS_REPLY_ERROR)
+            {
+                return 1;
+            }
+        }
+        if (!handled)
+        {
+            RedisCommandFrame& cmd = cache.frame;
+            ArgumentArray& cmdargs = cmd.GetMutableArguments();
+            cmdargs.resize(argc - 1);
+            cmd.GetMutableCommand().assign(cache.name);
+            for (j = 1; j < argc; j++)
+            {
+                size_t len = 0;
+                const char* arg = lua_tolstring(lua, j + 1, &len);
+                cmdargs[j - 1].assign(arg, len);
+            }
+            cmd.SetType(setting->type);
+            g_db->DoCall(lua_ctx, *setting, cmd);
+        }
         if (raise_error && reply.type != REDIS_REPLY_ERROR)
         {
             raise_error = 0;
@@ -958,7 +1261,6 @@ namespace ardb
         redisSrand48(0);
         std::string err;
         std::string funcname = "f_";
-        const std::string* funptr = &func;
         if (isSHA1Func)
         {
             if (func.size() != 40)
@@ -970,7 +1272,7 @@ namespace ardb
         }
         else
         {
-            funcname.append(sha1_sum(func));
+            funcname.append(GetScriptSHA1(func));
         }
         /* Push the pcall error handler function on the stack. */
         lua_getglobal(m_lua, "__redis__err__handler");
@@ -983,22 +1285,24 @@ namespace ardb
             /* Function not defined... let's define it if we have the
              * body of the function. If this is an EVALSHA call we can just
              * return an error. */
-            if (isSHA1Func)
+            std::string bytecode;
+            int rc = 0;
+            if (g_script_registry.GetBytecode(funcname.substr(2), bytecode))
             {
-                funptr = get_script_from_cache(funcname);
-                if (NULL == funptr)
-                {
-                    lua_pop(m_lua, 1);
-                    /* remove the error handler from the stack. */
-                    reply.SetErrCode(ERR_NOSCRIPT);
-                    return 0;
-                }
+                rc = LoadLuaFunction(funcname, bytecode, err);
+            }
+            else if (isSHA1Func)
+            {
+                lua_pop(m_lua, 1);
+                /* remove the error handler from the stack. */
+                reply.SetErrCode(ERR_NOSCRIPT);
+                return 0;
             }
             else
             {
-                save_script_to_cache(funcname, func);
+                rc = CreateLuaFunction(funcname, func, err);
             }
-            if (CreateLuaFunction(funcname, *funptr, err))
+            if (0 != rc)
             {
                 reply.SetErrorReason(err);
                 lua_pop(m_lua, 1);
@@ -1023,6 +1327,7 @@ namespace ardb
         guard.ctx.lua_executing_func = funcname.c_str() + 2;
         guard.ctx.lua_kill = false;
         guard.ctx.exec.ns = ctx.ns;
+        guard.ctx.exec.locked_keys = ctx.locked_keys;
         save_exec_ctx(&guard.ctx);
         /*
          * only propagate replication log with 'eval' command
@@ -1083,7 +1388,7 @@ namespace ardb
     {
         std::string funcname = "f_";
         ret.clear();
-        ret = sha1_sum(func);
+        ret = GetScriptSHA1(func);
         funcname.append(ret);
         return CreateLuaFunction(funcname, func, ret) == 0;
     }
@@ -1110,6 +1415,7 @@ namespace ardb
     LUAInterpreter::~LUAInterpreter()
     {
         lua_close(m_lua);
+        delete[] m_fingerprints;
     }
 
     int Ardb::Eval(Context& ctx, RedisCommandFrame& cmd)
@@ -1155,10 +1461,10 @@ namespace ardb
                  */
                 cmd.SetCommand("eval");
                 cmd.SetType(REDIS_CMD_EVAL);
-                std::string* body = get_script_from_cache("f_" + cmd.GetArguments()[0]);
-                if (NULL != body)
+                std::string body;
+                if (g_script_registry.GetBody(cmd.GetArguments()[0], body))
                 {
-                    cmd.GetMutableArguments()[0] = *body;
+                    cmd.GetMutableArguments()[0] = body;
                 }
             }
         }
@@ -1175,9 +1481,7 @@ namespace ardb
             for (uint32 i = 1; i < cmd.GetArguments().size(); i++)
             {
                 RedisReply& r = reply.AddMember();
-                std::string funcname = "f_";
-                funcname.append(cmd.GetArguments()[i]);
-                r.SetInteger(get_script_from_cache(funcname) != NULL ? 1 : 0);
+                r.SetInteger(g_script_registry.Exists(cmd.GetArguments()[i]) ? 1 : 0);
             }
             return 0;
         }
@@ -1190,7 +1494,7 @@ namespace ardb
             }
             else
             {
-                clear_script_cache();
+                g_script_registry.Clear();
                 reply.SetStatusCode(STATUS_OK);
             }
         }
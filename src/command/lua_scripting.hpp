@@ -46,9 +46,16 @@ namespace ardb
     class LUAInterpreter
     {
         private:
+            struct ScriptFingerprint
+            {
+                    std::string body;
+                    std::string sha1;
+            };
             lua_State *m_lua;
+            ScriptFingerprint* m_fingerprints;
 
             static int CallArdb(lua_State *lua, bool raise_error);
+            static bool CallArdbFast(lua_State *lua, Context& ctx, int type, int argc);
             static int PCall(lua_State *lua);
             static int Call(lua_State *lua);
             static int Log(lua_State *lua);
@@ -64,6 +71,8 @@ namespace ardb
             int LoadLibs();
             int RemoveUnsupportedFunctions();
             int CreateLuaFunction(const std::string& funcname, const std::string& body, std::string& err);
+            int LoadLuaFunction(const std::string& funcname, const std::string& bytecode, std::string& err);
+            std::string GetScriptSHA1(const std::string& body);
             int Init();
             void Reset();
         public:
@@ -136,6 +136,10 @@ namespace ardb
                 op = REDIS_CMD_PEXPIREAT;
                return true;
             }
+            case REDIS_CMD_PFADD_REGISTERS:
+            {
+                return true;
+            }
             default:
             {
                 ERROR_LOG("Not supported merge operation:%u", op);
@@ -177,6 +181,11 @@ namespace ardb
             	right_args[0] = left_args[0];
             	return 0;
             }
+            case REDIS_CMD_PFADD_REGISTERS:
+            {
+                CombinePFAddRegisters(left_args[0], right_args[0]);
+                return 0;
+            }
             default:
             {
             	//ERROR_LOG("Invalid merge op:%u", left);
@@ -240,6 +249,10 @@ namespace ardb
             {
                 return MergePFAdd(merge_ctx, key, val, args, NULL);
             }
+            case REDIS_CMD_PFADD_REGISTERS:
+            {
+                return MergePFAddRegisters(merge_ctx, key, val, args[0], NULL);
+            }
             case REDIS_CMD_PEXPIREAT:
             {
                 return MergeExpire(merge_ctx, key, val, args[0].GetInt64());
@@ -228,6 +228,7 @@ namespace ardb
             info.append("used_disk_space:").append(tmp).append("\r\n");
             info.append("living_iterator_num:").append(stringfromll(g_db_iterator_counter)).append("\r\n");
             info.append("living_reply_num:").append(stringfromll(living_reply_count())).append("\r\n");
+            FillBackGroundInfo(info);
             std::string stats;
             m_engine->Stats(ctx, stats);
             info.append(stats).append("\r\n");
@@ -241,10 +242,7 @@ namespace ardb
                 LockGuard<SpinMutexLock> guard(m_clients_lock);
                 info.append("connected_clients:").append(stringfromll(m_all_clients.size())).append("\r\n");
             }
-            {
-                LockGuard<SpinMutexLock> guard(m_block_keys_lock);
-                info.append("blocked_clients:").append(stringfromll(m_blocked_ctxs.size())).append("\r\n");
-            }
+            info.append("blocked_clients:").append(stringfromll(m_blocked_clients)).append("\r\n");
             info.append("\r\n");
         }
 
@@ -327,6 +325,16 @@ namespace ardb
                         info.append("slave_loading_left_bytes:").append(stringfromll(g_repl->GetSlave().LoadLeftBytes())).append("\r\n");
                     }
                     info.append("slave_repl_offset:").append(stringfromll(g_repl->GetSlave().SyncOffset())).append("\r\n");
+                    if (g_repl->GetSlave().IsLinkCompressed())
+                    {
+                        const CompressStat& stat = g_repl->GetSlave().LinkInflateStat();
+                        char ratio[32];
+                        snprintf(ratio, sizeof(ratio), "%.2f", stat.Ratio());
+                        info.append("master_link_compress_in_bytes:").append(stringfromll(stat.compressed_bytes)).append("\r\n");
+                        info.append("master_link_compress_out_bytes:").append(stringfromll(stat.raw_bytes)).append("\r\n");
+                        info.append("master_link_compress_ratio:").append(ratio).append("\r\n");
+                        info.append("master_link_decompress_cpu_usec:").append(stringfromll(stat.cost_micros)).append("\r\n");
+                    }
                     info.append("slave_sync_queue_size:").append(stringfromll(g_repl->GetSlave().SyncQueueSize())).append("\r\n");
                     if (!g_repl->GetSlave().IsConnected())
                     {
@@ -379,6 +387,7 @@ namespace ardb
             info.append("sync_full:").append(stringfromll(g_repl->GetMaster().FullSyncCount())).append("\r\n");
             info.append("sync_partial_ok:").append(stringfromll(g_repl->GetMaster().ParitialSyncOKCount())).append("\r\n");
             info.append("sync_partial_err:").append(stringfromll(g_repl->GetMaster().ParitialSyncErrCount())).append("\r\n");
+            info.append("exec_batch_commits:").append(stringfromll(m_exec_batch_commits)).append("\r\n");
             {
                 ReadLockGuard<SpinRWLock> guard(m_pubsub_lock);
                 info.append("pubsub_channels:").append(stringfromll(m_pubsub_channels.size())).append("\r\n");
@@ -895,16 +904,30 @@ namespace ardb
     int Ardb::CompactDB(Context& ctx, RedisCommandFrame& cmd)
     {
         RedisReply& reply = ctx.GetReply();
-        reply.SetStatusCode(STATUS_OK);
-        CompactDB(ctx, ctx.ns);
+        int err = CompactDB(ctx, ctx.ns);
+        if (0 != err)
+        {
+            reply.SetErrCode(err);
+        }
+        else
+        {
+            reply.SetStatusCode(STATUS_OK);
+        }
         return 0;
     }
 
     int Ardb::CompactAll(Context& ctx, RedisCommandFrame& cmd)
     {
         RedisReply& reply = ctx.GetReply();
-        reply.SetStatusCode(STATUS_OK);
-        CompactAll(ctx);
+        int err = CompactAll(ctx);
+        if (0 != err)
+        {
+            reply.SetErrCode(err);
+        }
+        else
+        {
+            reply.SetStatusCode(STATUS_OK);
+        }
         return 0;
     }
     /*
@@ -970,9 +993,13 @@ namespace ardb
             {
                 //do nothing
             }
+            else if (!strcasecmp(cmd.GetArguments()[i].c_str(), "compress"))
+            {
+                g_repl->GetMaster().SetSlaveCompress(ctx.client->client, CompressFrameCodec::ParseType(cmd.GetArguments()[i + 1]));
+            }
             else if (!strcasecmp(cmd.GetArguments()[i].c_str(), "capa"))
             {
-                //do nothing
+                g_repl->GetMaster().SetSlaveCapa(ctx.client->client, cmd.GetArguments()[i + 1]);
             }
             else if (!strcasecmp(cmd.GetArguments()[i].c_str(), "getack"))
             {
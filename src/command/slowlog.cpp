@@ -28,24 +28,95 @@
  */
 
 #include "db/db.hpp"
+#include "util/atomic.hpp"
+
+/*
+ * Same argument snapshot limits as redis: at most 32 arguments, each truncated at 128 bytes.
+ */
+#define SLOWLOG_ENTRY_MAX_ARGC 32
+#define SLOWLOG_ENTRY_MAX_STRING 128
+#define SLOWLOG_ENTRY_MAX_BUFFER (SLOWLOG_ENTRY_MAX_STRING + 32)
+#define SLOWLOG_MAX_RING_SIZE 4096
 
 namespace ardb
 {
+    /*
+     * One slot of the slowlog ring. 'seq' is odd while a writer fills the slot, readers copy the slot
+     * and drop the copy if 'seq' changed meanwhile.
+     */
     struct SlowLogRecord
     {
+            volatile uint64 seq;
             uint64 id;
             uint64 ts;
             uint64 costs;
-            RedisCommandFrame cmd;
-            SlowLogRecord() :
-                    id(0), ts(0), costs(0)
+            uint32 argc;
+            uint32 arglens[SLOWLOG_ENTRY_MAX_ARGC];
+            char args[SLOWLOG_ENTRY_MAX_ARGC][SLOWLOG_ENTRY_MAX_BUFFER];
+    };
+    static SlowLogRecord* g_slowlog_ring = NULL;
+    static uint64 g_slowlog_ring_size = 0;
+    static SpinMutexLock g_slowlog_ring_mutex;
+    static volatile uint64 g_slowlog_next_id = 0;
+    static volatile uint64 g_slowlog_reset_id = 0;
+
+    /*
+     * The ring is allocated once, sized by 'slowlog-max-len' at the first slow command.
+     */
+    static SlowLogRecord* get_slowlog_ring(int64 max_len)
+    {
+        if (NULL != g_slowlog_ring)
+        {
+            return g_slowlog_ring;
+        }
+        LockGuard<SpinMutexLock> guard(g_slowlog_ring_mutex);
+        if (NULL == g_slowlog_ring)
+        {
+            uint64 size = 1;
+            while ((max_len <= 0 || (int64) size < max_len) && size < SLOWLOG_MAX_RING_SIZE)
             {
+                size <<= 1;
             }
-    };
-    typedef std::deque<SlowLogRecord> SlowLogQueue;
-    static SlowLogQueue g_slowlog_queue;
-    static SpinMutexLock g_slowlog_queue_mutex;
-    static uint64 kSlowlogIDSeed = 0;
+            g_slowlog_ring_size = size;
+            g_slowlog_ring = new SlowLogRecord[size]();
+        }
+        return g_slowlog_ring;
+    }
+
+    static void fill_slowlog_arg(SlowLogRecord& log, const std::string& arg)
+    {
+        char* dst = log.args[log.argc];
+        if (arg.size() > SLOWLOG_ENTRY_MAX_STRING)
+        {
+            memcpy(dst, arg.data(), SLOWLOG_ENTRY_MAX_STRING);
+            int n = snprintf(dst + SLOWLOG_ENTRY_MAX_STRING, SLOWLOG_ENTRY_MAX_BUFFER - SLOWLOG_ENTRY_MAX_STRING,
+                    "... (%lu more bytes)", (unsigned long) (arg.size() - SLOWLOG_ENTRY_MAX_STRING));
+            log.arglens[log.argc] = SLOWLOG_ENTRY_MAX_STRING + n;
+        }
+        else
+        {
+            memcpy(dst, arg.data(), arg.size());
+            log.arglens[log.argc] = arg.size();
+        }
+        log.argc++;
+    }
+
+    /*
+     * Number of records still kept in the ring, the oldest one is 'next - count'.
+     */
+    static uint64 slowlog_count(uint64 next, int64 max_len)
+    {
+        uint64 count = next - g_slowlog_reset_id;
+        if (count > g_slowlog_ring_size)
+        {
+            count = g_slowlog_ring_size;
+        }
+        if (max_len > 0 && count > (uint64) max_len)
+        {
+            count = max_len;
+        }
+        return count;
+    }
 
     void Ardb::TryPushSlowCommand(const RedisCommandFrame& cmd, uint64 micros)
     {
@@ -53,27 +124,72 @@ namespace ardb
         {
             return;
         }
-        LockGuard<SpinMutexLock> guard(g_slowlog_queue_mutex);
-        while (GetConf().slowlog_max_len > 0 && g_slowlog_queue.size() >= (uint32) GetConf().slowlog_max_len)
+        SlowLogRecord* ring = get_slowlog_ring(GetConf().slowlog_max_len);
+        uint64 id = atomic_add_uint64(&g_slowlog_next_id, 1) - 1;
+        SlowLogRecord& log = ring[id & (g_slowlog_ring_size - 1)];
+        uint64 seq;
+        while (true)
         {
-            g_slowlog_queue.pop_front();
+            seq = log.seq;
+            if ((seq & 1) == 0 && atomic_cmp_set_uint64(&log.seq, seq, seq + 1))
+            {
+                break;
+            }
         }
-        SlowLogRecord log;
-        log.id = kSlowlogIDSeed++;
-        log.costs = micros;
-        log.ts = get_current_epoch_micros();
-        log.cmd = cmd;
-        g_slowlog_queue.push_back(log);
+        /*
+         * a writer with a newer id already wrapped around to this slot, keep its record
+         */
+        if (seq == 0 || log.id < id)
+        {
+            log.id = id;
+            log.costs = micros;
+            log.ts = get_current_epoch_micros();
+            log.argc = 0;
+            fill_slowlog_arg(log, cmd.GetCommand());
+            size_t argc = cmd.GetArguments().size();
+            for (size_t i = 0; i < argc && log.argc < SLOWLOG_ENTRY_MAX_ARGC; i++)
+            {
+                if (log.argc == SLOWLOG_ENTRY_MAX_ARGC - 1 && i < argc - 1)
+                {
+                    log.arglens[log.argc] = snprintf(log.args[log.argc], SLOWLOG_ENTRY_MAX_BUFFER, "... (%lu more arguments)",
+                            (unsigned long) (argc - i));
+                    log.argc++;
+                    break;
+                }
+                fill_slowlog_arg(log, cmd.GetArguments()[i]);
+            }
+        }
+        atomic_add_uint64(&log.seq, 1);
     }
 
     void Ardb::GetSlowlog(Context& ctx, uint32 len)
     {
         RedisReply& reply = ctx.GetReply();
         reply.type = REDIS_REPLY_ARRAY;
-        LockGuard<SpinMutexLock> guard(g_slowlog_queue_mutex);
-        for (uint32 i = 0; i < len && i < g_slowlog_queue.size(); i++)
+        if (NULL == g_slowlog_ring)
+        {
+            return;
+        }
+        uint64 next = g_slowlog_next_id;
+        uint64 count = slowlog_count(next, GetConf().slowlog_max_len);
+        SlowLogRecord log;
+        for (uint64 id = next - count; id < next && reply.MemberSize() < len; id++)
         {
-            SlowLogRecord& log = g_slowlog_queue[i];
+            SlowLogRecord& slot = g_slowlog_ring[id & (g_slowlog_ring_size - 1)];
+            uint64 seq = atomic_add_uint64(&slot.seq, 0);
+            if (0 == seq || (seq & 1) != 0 || slot.id != id)
+            {
+                /*
+                 * never written(a zeroed slot looks like id 0), being written or already overwritten, skip it
+                 * instead of waiting for the writer
+                 */
+                continue;
+            }
+            memcpy(&log, &slot, sizeof(log));
+            if (atomic_add_uint64(&slot.seq, 0) != seq)
+            {
+                continue;
+            }
             RedisReply& r = reply.AddMember();
             RedisReply& rr1 = r.AddMember();
             RedisReply& rr2 = r.AddMember();
@@ -83,14 +199,11 @@ namespace ardb
             rr3.SetInteger(log.costs);
 
             RedisReply& cmdreply = r.AddMember();
-
             cmdreply.type = REDIS_REPLY_ARRAY;
-            RedisReply& cmdname = cmdreply.AddMember();
-            cmdname.SetString(log.cmd.GetCommand());
-            for (uint32 j = 0; j < log.cmd.GetArguments().size(); j++)
+            for (uint32 j = 0; j < log.argc; j++)
             {
                 RedisReply& arg = cmdreply.AddMember();
-                arg.SetString(*(log.cmd.GetArgument(j)));
+                arg.SetString(std::string(log.args[j], log.arglens[j]));
             }
         }
     }
@@ -101,13 +214,12 @@ namespace ardb
         RedisReply& reply =  ctx.GetReply();
         if (subcmd == "len")
         {
-            reply.SetInteger(g_slowlog_queue.size());
+            reply.SetInteger(NULL == g_slowlog_ring ? 0 : slowlog_count(g_slowlog_next_id, GetConf().slowlog_max_len));
         }
         else if (subcmd == "reset")
         {
             reply.SetStatusCode(STATUS_OK);
-            LockGuard<SpinMutexLock> guard(g_slowlog_queue_mutex);
-            g_slowlog_queue.clear();
+            g_slowlog_reset_id = g_slowlog_next_id;
         }
         else if (subcmd == "get")
         {
@@ -31,6 +31,11 @@
 #include <algorithm>
 #include <vector>
 
+/*
+ * max number of pattern keys resolved by one engine MultiGet call
+ */
+#define SORT_MULTIGET_BATCH 1024
+
 namespace ardb
 {
     struct SortOptions
@@ -191,6 +196,77 @@ namespace ardb
         }
     }
 
+    /*
+     * Batched version of GetValueByPattern, resolves the pattern for every substitution with engine MultiGet calls.
+     * values[i] is left nil if the pattern key/field for substs[i] does not exist.
+     */
+    void Ardb::GetValuesByPattern(Context& ctx, const Slice& pattern, const std::vector<const Data*>& substs, DataArray& values)
+    {
+        values.clear();
+        values.resize(substs.size());
+        const char* spat = pattern.data();
+        if (spat[0] == '#' && spat[1] == '\0')
+        {
+            for (size_t i = 0; i < substs.size(); i++)
+            {
+                values[i] = *(substs[i]);
+            }
+            return;
+        }
+        if (NULL == strchr(spat, '*'))
+        {
+            return;
+        }
+        const char* f = strstr(spat, "->");
+        bool hash_field = NULL != f && (uint32) (f - spat) != (pattern.size() - 2);
+        for (size_t start = 0; start < substs.size(); start += SORT_MULTIGET_BATCH)
+        {
+            size_t end = start + SORT_MULTIGET_BATCH;
+            if (end > substs.size())
+            {
+                end = substs.size();
+            }
+            KeyObjectArray keys;
+            keys.reserve(end - start);
+            std::string vstr;
+            for (size_t i = start; i < end; i++)
+            {
+                substs[i]->ToString(vstr);
+                std::string keystr(pattern.data(), pattern.size());
+                string_replace(keystr, "*", vstr);
+                if (hash_field)
+                {
+                    size_t pos = keystr.find("->");
+                    KeyObject hfield(ctx.ns, KEY_HASH_FIELD, keystr.substr(0, pos));
+                    hfield.SetHashField(keystr.substr(pos + 2));
+                    keys.push_back(hfield);
+                }
+                else
+                {
+                    keys.push_back(KeyObject(ctx.ns, KEY_META, keystr));
+                }
+            }
+            ValueObjectArray vals;
+            ErrCodeArray errs;
+            m_engine->MultiGet(ctx, keys, vals, errs);
+            for (size_t i = 0; i < keys.size(); i++)
+            {
+                if (errs[i] != 0 || vals[i].GetType() == 0)
+                {
+                    continue;
+                }
+                if (hash_field)
+                {
+                    values[start + i] = vals[i].GetHashValue();
+                }
+                else if (CheckMeta(ctx, keys[i], KEY_STRING, vals[i], false, NULL) && vals[i].GetType() > 0)
+                {
+                    values[start + i] = vals[i].GetStringValue();
+                }
+            }
+        }
+    }
+
     int Ardb::Sort(Context& ctx, RedisCommandFrame& cmd)
     {
         RedisReply& reply = ctx.GetReply();
@@ -261,35 +337,53 @@ namespace ardb
             }
             DELETE(iter);
         }
+        if (!options.with_limit)
+        {
+            options.limit_offset = 0;
+            options.limit_count = sortvals.size();
+        }
         if (!options.nosort)
         {
-        	if (NULL != options.by)
-        	{
+            if (NULL != options.by)
+            {
+                std::vector<const Data*> substs(sortvals.size());
+                for (size_t i = 0; i < sortvals.size(); i++)
+                {
+                    substs[i] = &(sortvals[i].value);
+                }
+                DataArray weights;
+                GetValuesByPattern(ctx, options.by, substs, weights);
                 for (size_t i = 0; i < sortvals.size(); i++)
                 {
-                	if (GetValueByPattern(ctx, options.by, sortvals[i].value, sortvals[i].weight) < 0)
-                	{
-                		DEBUG_LOG("Failed to get value by pattern:%s", options.by);
-                	    sortvals[i].weight.Clear();
-                	    continue;
-                	}
-                	if(!options.with_alpha)
-                	{
-                	    if(sortvals[i].weight.IsString())
-                	    {
-                	        //try to convert to double
-                	        double dv;
-                	        std::string str;
-                	        sortvals[i].weight.ToString(str);
-                	        if(string_todouble(str, dv))
-                	        {
-                	            sortvals[i].weight.SetFloat64(dv);
-                	        }
-                	    }
-                	}
+                    sortvals[i].weight = weights[i];
+                    if (!options.with_alpha && sortvals[i].weight.IsString())
+                    {
+                        //try to convert to double
+                        double dv;
+                        std::string str;
+                        sortvals[i].weight.ToString(str);
+                        if (string_todouble(str, dv))
+                        {
+                            sortvals[i].weight.SetFloat64(dv);
+                        }
+                    }
                 }
-        	}
-            if (!options.is_desc)
+            }
+            /*
+             * a bounded LIMIT only needs the first offset+count elements ordered
+             */
+            size_t sort_count = sortvals.size();
+            if (options.with_limit && options.limit_offset >= 0 && options.limit_count >= 0
+                    && (size_t) options.limit_offset + (size_t) options.limit_count < sortvals.size())
+            {
+                sort_count = options.limit_offset + options.limit_count;
+            }
+            if (sort_count < sortvals.size())
+            {
+                std::partial_sort(sortvals.begin(), sortvals.begin() + sort_count, sortvals.end(),
+                        options.is_desc ? greater_value<SortValue> : less_value<SortValue>);
+            }
+            else if (!options.is_desc)
             {
                 std::sort(sortvals.begin(), sortvals.end(), less_value<SortValue>);
             }
@@ -298,32 +392,35 @@ namespace ardb
                 std::sort(sortvals.begin(), sortvals.end(), greater_value<SortValue>);
             }
         }
-        if (!options.with_limit)
-        {
-            options.limit_offset = 0;
-            options.limit_count = sortvals.size();
-        }
 
         DataArray value_list;
-        value_list.reserve(sortvals.size());
+        std::vector<const Data*> range;
         uint32 count = 0;
         for (uint32 i = options.limit_offset; i < sortvals.size() && count < (uint32) options.limit_count; i++, count++)
         {
-            if (options.get_patterns.empty())
+            range.push_back(&(sortvals[i].value));
+        }
+        if (options.get_patterns.empty())
+        {
+            value_list.reserve(range.size());
+            for (size_t i = 0; i < range.size(); i++)
             {
-                value_list.push_back(sortvals[i].value);
+                value_list.push_back(*(range[i]));
             }
-            else
+        }
+        else
+        {
+            std::vector<DataArray> pattern_values(options.get_patterns.size());
+            for (uint32 j = 0; j < options.get_patterns.size(); j++)
+            {
+                GetValuesByPattern(ctx, options.get_patterns[j], range, pattern_values[j]);
+            }
+            value_list.reserve(range.size() * options.get_patterns.size());
+            for (size_t i = 0; i < range.size(); i++)
             {
                 for (uint32 j = 0; j < options.get_patterns.size(); j++)
                 {
-                    Data vo;
-                    if (GetValueByPattern(ctx, options.get_patterns[j], sortvals[i].value, vo) < 0)
-                    {
-                        DEBUG_LOG("Failed to get value by pattern for:%s", options.get_patterns[j]);
-                        vo.Clear();
-                    }
-                    value_list.push_back(vo);
+                    value_list.push_back(pattern_values[j][i]);
                 }
             }
         }
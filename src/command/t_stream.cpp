@@ -258,6 +258,21 @@ OP_NAMESPACE_BEGIN
         }
     }
 
+    static void loadNACK(StreamGroupMeta* gmeta, KeyObject& ik, ValueObject& v)
+    {
+        StreamID sid = ik.GetStreamPELId();
+        if (sid.Empty())
+        {
+            return;
+        }
+        std::string consumer_name;
+        v.GetConsumerName().ToString(consumer_name);
+        StreamNACK* nack = new StreamNACK;
+        nack->delivery_count = v.GetNACKDeliveryCount().GetInt64();
+        nack->delivery_time = v.GetNACKDeliveryTime().GetInt64();
+        addNACK(gmeta, consumer_name, sid, nack);
+    }
+
     StreamGroupTable* Ardb::StreamLoadGroups(Iterator* iter)
     {
         StreamGroupTable* gtable = new StreamGroupTable;
@@ -269,7 +284,7 @@ OP_NAMESPACE_BEGIN
             {
                 break;
             }
-            std::string group_name, consumer_name;
+            std::string group_name;
             ik.GetStreamGroup().ToString(group_name);
             if (NULL == gmeta || gmeta->name != group_name)
             {
@@ -278,16 +293,7 @@ OP_NAMESPACE_BEGIN
                 gmeta->lastid.Decode(iter->Value(false).GetStreamGroupStreamId());
                 gtable->insert(StreamGroupTable::value_type(group_name, gmeta));
             }
-            StreamID sid = ik.GetStreamPELId();
-            if (!sid.Empty())
-            {
-                ValueObject& v = iter->Value(false);
-                v.GetConsumerName().ToString(consumer_name);
-                StreamNACK* nack = new StreamNACK;
-                nack->delivery_count = v.GetNACKDeliveryCount().GetInt64();
-                nack->delivery_time = v.GetNACKDeliveryTime().GetInt64();
-                addNACK(gmeta, consumer_name, sid, nack);
-            }
+            loadNACK(gmeta, ik, iter->Value(false));
             iter->Next();
         }
         if (gtable->size() == 0)
@@ -297,6 +303,97 @@ OP_NAMESPACE_BEGIN
         return gtable;
     }
 
+    /*
+     * Move the PEL loaded into 'from' to 'to', consumers created on 'to' while its PEL was not loaded are merged.
+     */
+    static void spliceGroupPELs(StreamGroupMeta* from, StreamGroupMeta* to)
+    {
+        ConsumerTable::iterator cit = from->consumers.begin();
+        while (cit != from->consumers.end())
+        {
+            StreamConsumerMeta* c = cit->second;
+            ConsumerTable::iterator found = to->consumers.find(cit->first);
+            if (found == to->consumers.end())
+            {
+                to->consumers[cit->first] = c;
+            }
+            else
+            {
+                StreamConsumerMeta* exist = found->second;
+                PELTable::iterator pit = c->pels.begin();
+                while (pit != c->pels.end())
+                {
+                    pit->second->consumer = exist;
+                    exist->pels[pit->first] = pit->second;
+                    pit++;
+                }
+                if (exist->seen_time < c->seen_time)
+                {
+                    exist->seen_time = c->seen_time;
+                }
+                DELETE(c);
+            }
+            cit++;
+        }
+        from->consumers.clear();
+        to->consumer_pels.swap(from->consumer_pels);
+    }
+
+    /*
+     * Load the PEL of a group which was loaded without it, the PEL rows of a group are adjacent and ordered by id.
+     * The scan runs without the global group cache lock, the result is spliced in under it unless another
+     * loader finished first.
+     */
+    int Ardb::StreamLoadGroupPELs(Context& ctx, const KeyPrefix& gk, StreamGroupMeta* gmeta)
+    {
+        if (gmeta->pels_loaded)
+        {
+            return 0;
+        }
+        StreamGroupMeta loaded;
+        KeyObject sk(gk.ns, KEY_STREAM_PEL, gk.key);
+        sk.SetStreamGroup(gmeta->name);
+        Iterator* iter = m_engine->Find(ctx, sk);
+        while (iter->Valid())
+        {
+            KeyObject& ik = iter->Key(false);
+            if (ik.GetType() != KEY_STREAM_PEL || ik.GetNameSpace() != sk.GetNameSpace() || ik.GetKey() != sk.GetKey()
+                    || ik.GetStreamGroup() != sk.GetStreamGroup())
+            {
+                break;
+            }
+            loadNACK(&loaded, ik, iter->Value(false));
+            iter->Next();
+        }
+        DELETE(iter);
+        {
+            LockGuard<ThreadMutex> guard(g_stream_groups_mutex);
+            if (!gmeta->pels_loaded)
+            {
+                spliceGroupPELs(&loaded, gmeta);
+                gmeta->pels_loaded = true;
+            }
+        }
+        ConsumerTable::iterator cit = loaded.consumers.begin();
+        while (cit != loaded.consumers.end())
+        {
+            DELETE(cit->second);
+            cit++;
+        }
+        PELTable::iterator pit = loaded.consumer_pels.begin();
+        while (pit != loaded.consumer_pels.end())
+        {
+            DELETE(pit->second);
+            pit++;
+        }
+        return 0;
+    }
+
+    /*
+     * Only the group headers are loaded on a cache miss, the PEL rows of every group are skipped by a seek.
+     * A group's PEL is loaded by StreamLoadGroupPELs() only for commands needing the whole PEL(XPENDING summary,
+     * XCLAIM, XINFO, reading a consumer's history), delivering new entries and XACK work on the PEL rows directly.
+     */
     StreamGroupTable* Ardb::StreamLoadGroups(Context& ctx, const KeyPrefix& gk, bool create_ifnotexist)
     {
         StreamGroupTable* gtable = NULL;
@@ -308,9 +405,10 @@ OP_NAMESPACE_BEGIN
         }
 
         KeyObject sk(gk.ns, KEY_STREAM_PEL, gk.key);
-        StreamGroupMeta* gmeta = NULL;
+        StreamID max_id;
+        max_id.ms = UINT64_MAX;
+        max_id.seq = UINT64_MAX;
         Iterator* iter = m_engine->Find(ctx, sk);
-        gtable = StreamLoadGroups(iter);
         while (iter->Valid())
         {
             KeyObject& ik = iter->Key(false);
@@ -318,27 +416,32 @@ OP_NAMESPACE_BEGIN
             {
                 break;
             }
-            std::string group_name, consumer_name;
-            ik.GetStreamGroup().ToString(group_name);
-            if (NULL == gmeta || gmeta->name != group_name)
+            if (NULL == gtable)
             {
-                gmeta = new StreamGroupMeta;
-                gmeta->name = group_name;
-                gmeta->lastid.Decode(iter->Value(false).GetStreamGroupStreamId());
-                gtable->insert(StreamGroupTable::value_type(group_name, gmeta));
+                gtable = new StreamGroupTable;
             }
-            StreamID sid = ik.GetStreamPELId();
-            if (!sid.Empty())
-            {
-                ValueObject& v = iter->Value(false);
-                v.GetConsumerName().ToString(consumer_name);
-                StreamNACK* nack = new StreamNACK;
-                nack->delivery_count = v.GetNACKDeliveryCount().GetInt64();
-                nack->delivery_time = v.GetNACKDeliveryTime().GetInt64();
-                addNACK(gmeta, consumer_name, sid, nack);
+            StreamGroupMeta* gmeta = new StreamGroupMeta;
+            ik.GetStreamGroup().ToString(gmeta->name);
+            gmeta->lastid.Decode(iter->Value(false).GetStreamGroupStreamId());
+            gmeta->pels_loaded = false;
+            gtable->insert(StreamGroupTable::value_type(gmeta->name, gmeta));
+
+            KeyObject next(gk.ns, KEY_STREAM_PEL, gk.key);
+            next.SetStreamGroup(gmeta->name);
+            next.SetStreamPELId(max_id);
+            iter->Jump(next);
+            while (iter->Valid())
+            {
+                KeyObject& nk = iter->Key(false);
+                if (nk.GetType() != KEY_STREAM_PEL || nk.GetNameSpace() != sk.GetNameSpace()
+                        || nk.GetKey() != sk.GetKey() || nk.GetStreamGroup() != next.GetStreamGroup())
+                {
+                    break;
+                }
+                iter->Next();
             }
-            iter->Next();
         }
+        DELETE(iter);
         if(create_ifnotexist)
         {
             if(NULL == gtable)
@@ -369,7 +472,7 @@ OP_NAMESPACE_BEGIN
         return StreamLoadGroups(ctx, gk, create_ifnotexist);
     }
 
-    StreamGroupMeta* Ardb::StreamLoadGroup(Context& ctx, const KeyPrefix& gk, const std::string& group)
+    StreamGroupMeta* Ardb::StreamLoadGroup(Context& ctx, const KeyPrefix& gk, const std::string& group, bool load_pels)
     {
         StreamGroupTable* gtable = StreamLoadGroups(ctx, gk, false);
         if (NULL != gtable)
@@ -379,17 +482,21 @@ OP_NAMESPACE_BEGIN
             {
                 return NULL;
             }
+            if (load_pels)
+            {
+                StreamLoadGroupPELs(ctx, gk, git->second);
+            }
             return git->second;
         }
         return NULL;
     }
 
-    StreamGroupMeta* Ardb::StreamLoadGroup(Context& ctx, const std::string& key, const std::string& group)
+    StreamGroupMeta* Ardb::StreamLoadGroup(Context& ctx, const std::string& key, const std::string& group, bool load_pels)
     {
         KeyPrefix gk;
         gk.key.SetString(key, false, true);
         gk.ns = ctx.ns;
-        return StreamLoadGroup(ctx, gk, group);
+        return StreamLoadGroup(ctx, gk, group, load_pels);
     }
 
     int Ardb::StreamUpdateNACK(Context& ctx, const std::string& key, const std::string& group,
@@ -406,13 +513,23 @@ OP_NAMESPACE_BEGIN
         {
             consumer_meta = found->second;
         }
-        nack->consumer = consumer_meta;
-        group_meta->consumer_pels[id] = nack;
         if (NULL != consumer_meta)
         {
-            consumer_meta->pels[id] = nack;
             consumer_meta->seen_time = nack->delivery_time;
         }
+        /*
+         * a group without loaded PEL only keeps the PEL row, it's read back when the PEL is loaded.
+         */
+        bool cached = group_meta->pels_loaded;
+        if (cached)
+        {
+            nack->consumer = consumer_meta;
+            group_meta->consumer_pels[id] = nack;
+            if (NULL != consumer_meta)
+            {
+                consumer_meta->pels[id] = nack;
+            }
+        }
         KeyObject k(ctx.ns, KEY_STREAM_PEL, key);
         k.SetStreamGroup(group);
         k.SetStreamPELId(id);
@@ -448,6 +565,10 @@ OP_NAMESPACE_BEGIN
             xclaim.GetMutableArguments().push_back("JUSTID");
             FeedReplicationBacklog(ctx, ctx.ns, xclaim);
         }
+        if (!cached)
+        {
+            DELETE(nack);
+        }
         return 0;
     }
 
@@ -565,18 +686,46 @@ OP_NAMESPACE_BEGIN
         {
             return 0;
         }
-        int64_t pel_counter = gmeta->consumer_pels.size();
-        PELTable::iterator pit = gmeta->consumer_pels.begin();
-        while (pit != gmeta->consumer_pels.end())
+        int64_t pel_counter = 0;
+        if (gmeta->pels_loaded)
         {
-            KeyObject gk(ctx.ns, KEY_STREAM_PEL, key);
-            gk.SetStreamGroup(group);
-            gk.SetStreamPELId(pit->first);
-            m_engine->Del(ctx, gk);
-            gmeta->consumer_pels.erase(pit->first);
-            DELETE(pit->second);
-            pit++;
+            pel_counter = gmeta->consumer_pels.size();
+            PELTable::iterator pit = gmeta->consumer_pels.begin();
+            while (pit != gmeta->consumer_pels.end())
+            {
+                KeyObject gk(ctx.ns, KEY_STREAM_PEL, key);
+                gk.SetStreamGroup(group);
+                gk.SetStreamPELId(pit->first);
+                m_engine->Del(ctx, gk);
+                pit++;
+            }
         }
+        else
+        {
+            /*
+             * drop the PEL rows directly, there's no need to build the PEL of a group being destroyed.
+             */
+            KeyObject sk(ctx.ns, KEY_STREAM_PEL, key);
+            sk.SetStreamGroup(group);
+            Iterator* iter = m_engine->Find(ctx, sk);
+            while (iter->Valid())
+            {
+                KeyObject& ik = iter->Key(false);
+                if (ik.GetType() != KEY_STREAM_PEL || ik.GetNameSpace() != sk.GetNameSpace() || ik.GetKey() != sk.GetKey()
+                        || ik.GetStreamGroup() != sk.GetStreamGroup())
+                {
+                    break;
+                }
+                if (!ik.GetStreamPELId().Empty())
+                {
+                    iter->Del();
+                    pel_counter++;
+                }
+                iter->Next();
+            }
+            DELETE(iter);
+        }
+        /* the nacks are released with the group */
         clearGroup(gmeta);
         KeyObject gk(ctx.ns, KEY_STREAM_PEL, key);
         gk.SetStreamGroup(group);
@@ -620,13 +769,67 @@ OP_NAMESPACE_BEGIN
         return pel_counter;
     }
 
-    int64_t Ardb::StreamTrimByLength(Context& ctx, const std::string& key, ValueObject& meta, size_t maxlen, int approx)
+    /*
+     * Remove at most 'limit' entries from the head of the stream, stop at the first entry not smaller than 'minid'
+     * if it's not NULL. On engines supporting range deletion the removed entries are located first, then dropped by
+     * one range deletion instead of a tombstone per entry.
+     */
+    int64_t Ardb::StreamTrim(Context& ctx, const std::string& key, ValueObject& meta, int64_t limit,
+            const StreamID* minid)
     {
         int64_t trimed = 0;
+        if (limit <= 0)
+        {
+            return 0;
+        }
         KeyObject start(ctx.ns, KEY_STREAM_ELEMENT, key);
+        if (m_engine->GetFeatureSet().support_delete_range && (NULL != minid || limit >= GetConf().range_delete_min_size))
+        {
+            StreamID first_kept;
+            bool kept = false;
+            Iterator* iter = m_engine->Find(ctx, start);
+            while (iter->Valid())
+            {
+                KeyObject& ik = iter->Key(false);
+                if (ik.GetType() != KEY_STREAM_ELEMENT || ik.GetNameSpace() != start.GetNameSpace()
+                        || ik.GetKey() != start.GetKey())
+                {
+                    break;
+                }
+                StreamID id = ik.GetStreamID();
+                if (trimed >= limit || (NULL != minid && id.Compare(*minid) >= 0))
+                {
+                    first_kept = id;
+                    kept = true;
+                    break;
+                }
+                trimed++;
+                iter->Next();
+            }
+            DELETE(iter);
+            if (0 == trimed)
+            {
+                return 0;
+            }
+            KeyObject end(ctx.ns, kept ? KEY_STREAM_ELEMENT : KEY_STREAM_ELEMENT + 1, key);
+            if (kept)
+            {
+                end.SetStreamID(first_kept);
+            }
+            /*
+             * engine may refuse range deletion in current state, fallback to entry by entry deletion then.
+             */
+            if (0 == m_engine->DelRange(ctx, start, end))
+            {
+                atomic_add_uint64(&m_range_delete_count, 1);
+                meta.SetObjectLen(meta.GetObjectLen() - trimed);
+                return trimed;
+            }
+            trimed = 0;
+        }
         Iterator* iter = m_engine->Find(ctx, start);
         WriteBatchGuard batch(ctx, m_engine);
-        while (iter->Valid() && meta.GetObjectLen() > (int64_t)maxlen)
+        while (iter->Valid() && trimed < limit)
         {
             KeyObject& ik = iter->Key(false);
             if (ik.GetType() != KEY_STREAM_ELEMENT || ik.GetNameSpace() != start.GetNameSpace()
@@ -634,16 +837,42 @@ OP_NAMESPACE_BEGIN
             {
                 break;
             }
+            if (NULL != minid && ik.GetStreamID().Compare(*minid) >= 0)
+            {
+                break;
+            }
             trimed++;
-            meta.SetObjectLen(meta.GetObjectLen() - 1);
             iter->Del();
             iter->Next();
         }
         DELETE(iter);
+        meta.SetObjectLen(meta.GetObjectLen() - trimed);
         return trimed;
     }
 
-    /* XADD key [MAXLEN <count>] <ID or *> [field value] [field value] ... */
+    /*
+     * With 'approx' the stream is only trimmed once at least range-delete-min-size entries are over the limit, like
+     * redis only removing whole radix tree nodes, so most XADD ~ calls do not touch the head of the stream.
+     */
+    int64_t Ardb::StreamTrimByLength(Context& ctx, const std::string& key, ValueObject& meta, size_t maxlen, int approx)
+    {
+        int64_t excess = meta.GetObjectLen() - (int64_t) maxlen;
+        if (excess <= 0 || (approx && excess < GetConf().range_delete_min_size))
+        {
+            return 0;
+        }
+        return StreamTrim(ctx, key, meta, excess, NULL);
+    }
+
+    int64_t Ardb::StreamTrimByMinID(Context& ctx, const std::string& key, ValueObject& meta, const StreamID& minid)
+    {
+        return StreamTrim(ctx, key, meta, meta.GetObjectLen(), &minid);
+    }
+
+#define TRIM_STRATEGY_NONE 0
+#define TRIM_STRATEGY_MAXLEN 1
+#define TRIM_STRATEGY_MINID 2
+    /* XADD key [MAXLEN [~] <count>|MINID [~] <id>] <ID or *> [field value] [field value] ... */
     int Ardb::XAdd(Context& ctx, RedisCommandFrame& cmd)
     {
         ctx.flags.create_if_notexist = 1;
@@ -662,6 +891,8 @@ OP_NAMESPACE_BEGIN
             int approx_maxlen = 0; /* If 1 only delete whole radix tree nodes, so
              the maxium length is not applied verbatim. */
             //int maxlen_arg_idx = 0; /* Index of the count in MAXLEN, for rewriting. */
+            int trim_strategy = TRIM_STRATEGY_NONE;
+            StreamID minid;
             bool id_given = false;
             size_t i = 1;
             for (; i < cmd.GetArguments().size(); i++)
@@ -688,9 +919,21 @@ OP_NAMESPACE_BEGIN
                         reply.SetErrCode(ERR_INVALID_INTEGER_ARGS);
                         return 0;
                     }
+                    trim_strategy = TRIM_STRATEGY_MAXLEN;
                     i++;
                     //maxlen_arg_idx = i;
                 }
+                else if (!strcasecmp(opt, "minid") && moreargs)
+                {
+                    const char *next = cmd.GetArguments()[i + 1].c_str();
+                    if (moreargs >= 2 && next[0] == '~' && next[1] == '\0')
+                    {
+                        i++;
+                    }
+                    if (streamParseIDOrReply(ctx, cmd.GetArguments()[i + 1], minid, 0) != 0) return 0;
+                    trim_strategy = TRIM_STRATEGY_MINID;
+                    i++;
+                }
                 else
                 {
                     /* If we are here is a syntax error or a valid ID. */
@@ -787,9 +1030,18 @@ OP_NAMESPACE_BEGIN
             replyStreamID(reply, id);
 
             //trim stream
-            if (approx_maxlen && meta.GetObjectLen() > maxlen)
+            int64_t trimed = 0;
+            if (trim_strategy == TRIM_STRATEGY_MAXLEN)
             {
-                StreamTrimByLength(ctx, keystr, meta, maxlen, approx_maxlen);
+                trimed = StreamTrimByLength(ctx, keystr, meta, maxlen, approx_maxlen);
+            }
+            else if (trim_strategy == TRIM_STRATEGY_MINID)
+            {
+                trimed = StreamTrimByMinID(ctx, keystr, meta, minid);
+            }
+            if (trimed > 0)
+            {
+                SetKeyValue(ctx, key, meta);
             }
             cmd.ClearRawProtocolData();
             std::string idstr;
@@ -813,7 +1065,7 @@ OP_NAMESPACE_BEGIN
     {
         KeyObject key(ctx.ns, KEY_META, cmd.GetArguments()[0]);
         KeyLockGuard guard(ctx, key);
-        StreamGroupMeta* group = StreamLoadGroup(ctx, cmd.GetArguments()[0], cmd.GetArguments()[1]);
+        StreamGroupMeta* group = StreamLoadGroup(ctx, cmd.GetArguments()[0], cmd.GetArguments()[1], false);
         if (NULL == group)
         {
             ctx.GetReply().SetInteger(0);
@@ -830,6 +1082,16 @@ OP_NAMESPACE_BEGIN
                 return 0;
             }
             pkey.SetStreamPELId(id);
+            if (!group->pels_loaded)
+            {
+                ValueObject pv;
+                if (0 == m_engine->Get(ctx, pkey, pv))
+                {
+                    acknowledged++;
+                    m_engine->Del(ctx, pkey);
+                }
+                continue;
+            }
             PELTable::iterator found = group->consumer_pels.find(id);
             if (found != group->consumer_pels.end())
             {
@@ -887,7 +1149,7 @@ OP_NAMESPACE_BEGIN
 
             /* Certain subcommands require the group to exist. */
             if ((!strcasecmp(opt, "SETID") || !strcasecmp(opt, "DELGROUP") || !strcasecmp(opt, "DELCONSUMER"))
-                    && (NULL == StreamLoadGroup(ctx, cmd.GetArguments()[1], cmd.GetArguments()[2])))
+                    && (NULL == StreamLoadGroup(ctx, cmd.GetArguments()[1], cmd.GetArguments()[2], false)))
             {
                 std::string err = "NOGROUP No such consumer group '" + cmd.GetArguments()[2] + "' for key name '"
                         + cmd.GetArguments()[1] + "'";
@@ -997,10 +1259,11 @@ OP_NAMESPACE_BEGIN
      *                             the specified length. Use ~ before the
      *                             count in order to demand approximated trimming
      *                             (like XADD MAXLEN option).
+     *
+     * MINID [~] <id>           -- Remove the entries with an id smaller than
+     *                             the specified one.
      */
 
-#define TRIM_STRATEGY_NONE 0
-#define TRIM_STRATEGY_MAXLEN 1
     int Ardb::XTrim(Context& ctx, RedisCommandFrame& cmd)
     {
         KeyObject key(ctx.ns, KEY_META, cmd.GetArguments()[0]);
@@ -1021,6 +1284,7 @@ OP_NAMESPACE_BEGIN
         int64_t maxlen = 0; /* 0 means no maximum length. */
         int approx_maxlen = 0; /* If 1 only delete whole radix tree nodes, so
          the maxium length is not applied verbatim. */
+        StreamID minid;
 
         /* Parse options. */
         size_t i = 1; /* Start of options. */
@@ -1046,6 +1310,18 @@ OP_NAMESPACE_BEGIN
                 }
                 i++;
             }
+            else if (!strcasecmp(opt, "minid") && moreargs)
+            {
+                trim_strategy = TRIM_STRATEGY_MINID;
+                const char *next = cmd.GetArguments()[i + 1].c_str();
+                /* Accepted for compatibility, entries older than the id are always removed. */
+                if (moreargs >= 2 && next[0] == '~' && next[1] == '\0')
+                {
+                    i++;
+                }
+                if (streamParseIDOrReply(ctx, cmd.GetArguments()[i + 1], minid, 0) != 0) return 0;
+                i++;
+            }
             else
             {
                 ctx.GetReply().SetErrCode(ERR_INVALID_SYNTAX);
@@ -1055,9 +1331,20 @@ OP_NAMESPACE_BEGIN
 
         /* Perform the trimming. */
         int64_t deleted = 0;
-        if (trim_strategy == TRIM_STRATEGY_MAXLEN)
+        if (trim_strategy != TRIM_STRATEGY_NONE)
         {
-            deleted = StreamTrimByLength(ctx, cmd.GetArguments()[0], meta, maxlen, approx_maxlen);
+            if (trim_strategy == TRIM_STRATEGY_MAXLEN)
+            {
+                deleted = StreamTrimByLength(ctx, cmd.GetArguments()[0], meta, maxlen, approx_maxlen);
+            }
+            else
+            {
+                deleted = StreamTrimByMinID(ctx, cmd.GetArguments()[0], meta, minid);
+            }
+            if (deleted > 0)
+            {
+                SetKeyValue(ctx, key, meta);
+            }
             ctx.GetReply().SetInteger(deleted);
             return 0;
         }
@@ -1497,7 +1784,7 @@ OP_NAMESPACE_BEGIN
 //        {
 //            return 0;
 //        }
-        StreamGroupMeta* group_meta = StreamLoadGroup(ctx, keystr, group);
+        StreamGroupMeta* group_meta = StreamLoadGroup(ctx, keystr, group, justinfo);
         if (NULL == group_meta)
         {
             std::string err = "NOGROUP No such key '" + cmd.GetArguments()[0] + "' or consumer group '"
@@ -1540,6 +1827,51 @@ OP_NAMESPACE_BEGIN
         else /* XPENDING <key> <group> <start> <stop> <count> [<consumer>] variant. */
         {
             ctx.GetReply().ReserveMember(0);
+            int64_t now = get_current_epoch_millis();
+            if (!group_meta->pels_loaded)
+            {
+                /*
+                 * serve the range from the PEL rows, the whole PEL is not needed.
+                 */
+                KeyObject sk(ctx.ns, KEY_STREAM_PEL, keystr);
+                sk.SetStreamGroup(group);
+                sk.SetStreamPELId(startid);
+                Iterator* iter = m_engine->Find(ctx, sk);
+                while (iter->Valid() && count > 0)
+                {
+                    KeyObject& ik = iter->Key(false);
+                    if (ik.GetType() != KEY_STREAM_PEL || ik.GetNameSpace() != sk.GetNameSpace() || ik.GetKey() != sk.GetKey()
+                            || ik.GetStreamGroup() != sk.GetStreamGroup())
+                    {
+                        break;
+                    }
+                    StreamID sid = ik.GetStreamPELId();
+                    if (sid.Compare(endid) > 0)
+                    {
+                        break;
+                    }
+                    ValueObject& iv = iter->Value(false);
+                    std::string owner;
+                    iv.GetNACKConsumer().ToString(owner);
+                    if (sid.Empty() || sid.Compare(startid) < 0 || (!consumer.empty() && owner != consumer))
+                    {
+                        iter->Next();
+                        continue;
+                    }
+                    RedisReply& r = ctx.GetReply().AddMember();
+                    r.ReserveMember(4);
+                    replyStreamID(r.MemberAt(0), sid);
+                    r.MemberAt(1).SetString(owner);
+                    int64_t elapsed = now - iv.GetNACKDeliveryTime().GetInt64();
+                    if (elapsed < 0) elapsed = 0;
+                    r.MemberAt(2).SetInteger(elapsed);
+                    r.MemberAt(3).SetInteger(iv.GetNACKDeliveryCount().GetInt64());
+                    count--;
+                    iter->Next();
+                }
+                DELETE(iter);
+                return 0;
+            }
             PELTable* pel_table = &group_meta->consumer_pels;
             if (!consumer.empty())
             {
@@ -1551,9 +1883,8 @@ OP_NAMESPACE_BEGIN
                 pel_table = &(cit->second->pels);
             }
 
-            int64_t now = get_current_epoch_millis();
-            PELTable::iterator pit = pel_table->begin();
-            while (pit != pel_table->end())
+            PELTable::iterator pit = pel_table->lower_bound(startid);
+            while (pit != pel_table->end() && count > 0 && pit->first.Compare(endid) <= 0)
             {
                 StreamID sid = pit->first;
                 StreamNACK* nack = pit->second;
@@ -1566,6 +1897,7 @@ OP_NAMESPACE_BEGIN
                 r.MemberAt(2).SetInteger(elapsed);
                 /* Number of deliveries. */
                 r.MemberAt(3).SetInteger(nack->delivery_count);
+                count--;
                 pit++;
             }
         }
@@ -1648,13 +1980,17 @@ OP_NAMESPACE_BEGIN
         else if (!strcasecmp(opt, "GROUPS") && cmd.GetArguments().size() == 2)
         {
             ctx.GetReply().ReserveMember(0);
-            StreamGroupTable* gs = StreamLoadGroups(ctx, keystr, false);
+            KeyPrefix gk;
+            gk.key.SetString(keystr, strlen(keystr), true);
+            gk.ns = ctx.ns;
+            StreamGroupTable* gs = StreamLoadGroups(ctx, gk, false);
             if (NULL != gs)
             {
                 StreamGroupTable::iterator git = gs->begin();
                 while (git != gs->end())
                 {
                     StreamGroupMeta* g = git->second;
+                    StreamLoadGroupPELs(ctx, gk, g);
                     RedisReply& rr = r.AddMember();
                     rr.AddMember().SetStatusString("name");
                     rr.AddMember().SetString(g->name);
@@ -1820,7 +2156,7 @@ OP_NAMESPACE_BEGIN
                 {
                     return 0;
                 }
-                StreamGroupMeta* group_meta = StreamLoadGroup(ctx, stream_key, groupname);
+                StreamGroupMeta* group_meta = StreamLoadGroup(ctx, stream_key, groupname, false);
                 if (streams[id_idx].GetType() == 0 || NULL == group_meta)
                 {
                     std::string err = "NOGROUP No such key '" + stream_key + "' or consumer "
@@ -1898,6 +2234,13 @@ OP_NAMESPACE_BEGIN
                     StreamAddConsumer(ctx, consumername, groups[i]);
                     if (start.Compare(groups[i]->lastid) <= 0)
                     {
+                        /*
+                         * reading the consumer's history needs its PEL, new entries('>') do not.
+                         */
+                        KeyPrefix gk;
+                        gk.key.SetString(stream_key_str, false, true);
+                        gk.ns = ctx.ns;
+                        StreamLoadGroupPELs(ctx, gk, groups[i]);
                         reply_count++;
                         r2.ReserveMember(0);
                         StreamConsumerMeta* c = groups[i]->consumers[consumername];
@@ -1906,6 +2249,7 @@ OP_NAMESPACE_BEGIN
                         {
                             StreamID sid = pit->first;
                             KeyObject sk(ctx.ns, KEY_STREAM_ELEMENT, stream_key_str);
+                            sk.SetStreamID(sid);
                             ValueObject sv;
                             if (0 == m_engine->Get(ctx, sk, sv))
                             {
@@ -2017,7 +2361,7 @@ OP_NAMESPACE_BEGIN
         StreamGroupMeta* group_meta = NULL;
         if (!unblock_client.GetBPop().GetStreamTarget().group.empty())
         {
-            group_meta = StreamLoadGroup(unblock_client, ready_key, unblock_client.GetBPop().GetStreamTarget().group);
+            group_meta = StreamLoadGroup(unblock_client, ready_key, unblock_client.GetBPop().GetStreamTarget().group, false);
             if (NULL == group_meta)
             {
                 UnblockKeys(unblock_client, false, r);
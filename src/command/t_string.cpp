@@ -112,7 +112,7 @@ OP_NAMESPACE_BEGIN
         {
             Data merge_data;
             merge_data.SetString(append, false);
-            err = m_engine->Merge(ctx, key, REDIS_CMD_APPEND, merge_data);
+            err = MergeKeyValue(ctx, key, REDIS_CMD_APPEND, DataArray(1, merge_data));
             if (err < 0)
             {
                 reply.SetErrCode(err);
@@ -190,7 +190,7 @@ OP_NAMESPACE_BEGIN
                         merge_op = REDIS_CMD_SETNX;
                         Data v;
                         v.SetString(cmd.GetArguments()[i + 1], true, false);
-                        m_engine->Merge(ctx, key, merge_op, v);
+                        MergeKeyValue(ctx, key, merge_op, DataArray(1, v));
                     }
                     else
                     {
@@ -275,7 +275,7 @@ OP_NAMESPACE_BEGIN
         {
             Data merge_data;
             merge_data.SetFloat64(increment);
-            err = m_engine->Merge(ctx, key, cmd.GetType(), merge_data);
+            err = MergeKeyValue(ctx, key, cmd.GetType(), DataArray(1, merge_data));
             if (err < 0)
             {
                 reply.SetErrCode(err);
@@ -343,7 +343,7 @@ OP_NAMESPACE_BEGIN
         {
             Data merge_data;
             merge_data.SetInt64(incr);
-            err = m_engine->Merge(ctx, key, cmd.GetType(), merge_data);
+            err = MergeKeyValue(ctx, key, cmd.GetType(), DataArray(1, merge_data));
             if (err < 0)
             {
                 reply.SetErrCode(err);
@@ -29,6 +29,8 @@
 
 #include "db/db.hpp"
 #include "thread/thread_mutex.hpp"
+#include "util/murmur3.h"
+#include "util/atomic.hpp"
 
 namespace ardb
 {
@@ -58,6 +60,225 @@ namespace ardb
         return 0;
     }
 
+    /*
+     * Collect the keys a queued transaction command would touch, return -1 if the keys can not be decided
+     * before execution or the command needs to read its own writes(it then runs alone, outside of any
+     * shared write batch).
+     */
+    static int transaction_cmd_keys(const RedisCommandFrame& cmd, Data& ns, KeyPrefixSet& keys)
+    {
+        const ArgumentArray& args = cmd.GetArguments();
+        size_t start = 0, stop = 0, step = 1;
+        switch (cmd.GetType())
+        {
+            case REDIS_CMD_SELECT:
+            {
+                if (!args.empty() && args[0].size() <= ARDB_MAX_NAMESPACE_SIZE)
+                {
+                    ns.SetString(args[0], false);
+                }
+                return 0;
+            }
+            case REDIS_CMD_FLUSHDB:
+            case REDIS_CMD_FLUSHALL:
+            case REDIS_CMD_COMPACTDB:
+            case REDIS_CMD_COMPACTALL:
+            case REDIS_CMD_MIGRATE:
+            case REDIS_CMD_MIGRATEDB:
+            case REDIS_CMD_XREAD:
+            case REDIS_CMD_XREADGROUP:
+            case REDIS_CMD_KEYSCOUNT:
+            {
+                return -1;
+            }
+            case REDIS_CMD_EVAL:
+            case REDIS_CMD_EVALSHA:
+            {
+                /*
+                 * the declared keys are locked, but a script may read what it just wrote, which an
+                 * engine write batch does not provide, so it runs outside of the shared batch.
+                 */
+                uint32 numkey = 0;
+                if (args.size() < 2 || !string_touint32(args[1], numkey) || args.size() < numkey + 2)
+                {
+                    return -1;
+                }
+                for (size_t i = 2; i < numkey + 2; i++)
+                {
+                    KeyPrefix key;
+                    key.ns = ns;
+                    key.key.SetString(args[i], false);
+                    keys.insert(key);
+                }
+                return -1;
+            }
+            case REDIS_CMD_KEYS:
+            case REDIS_CMD_SCAN:
+            case REDIS_CMD_RANDOMKEY:
+            {
+                return 0;
+            }
+            case REDIS_CMD_DEL:
+            case REDIS_CMD_EXISTS:
+            case REDIS_CMD_UNLINK:
+            case REDIS_CMD_TOUCH:
+            case REDIS_CMD_MGET:
+            case REDIS_CMD_SDIFF:
+            case REDIS_CMD_SDIFFCOUNT:
+            case REDIS_CMD_SDIFFSTORE:
+            case REDIS_CMD_SINTER:
+            case REDIS_CMD_SINTERCOUNT:
+            case REDIS_CMD_SINTERSTORE:
+            case REDIS_CMD_SUNION:
+            case REDIS_CMD_SUNIONCOUNT:
+            case REDIS_CMD_SUNIONSTORE:
+            case REDIS_CMD_PFCOUNT:
+            case REDIS_CMD_PFMERGE:
+            {
+                stop = args.size();
+                break;
+            }
+            case REDIS_CMD_BLPOP:
+            case REDIS_CMD_BRPOP:
+            case REDIS_CMD_BZPOPMIN:
+            case REDIS_CMD_BZPOPMAX:
+            {
+                stop = args.empty() ? 0 : args.size() - 1;
+                break;
+            }
+            case REDIS_CMD_RENAME:
+            case REDIS_CMD_RENAMENX:
+            case REDIS_CMD_SMOVE:
+            case REDIS_CMD_RPOPLPUSH:
+            case REDIS_CMD_BRPOPLPUSH:
+            {
+                stop = args.size() < 2 ? args.size() : 2;
+                break;
+            }
+            case REDIS_CMD_MSET:
+            case REDIS_CMD_MSETNX:
+            {
+                stop = args.size();
+                step = 2;
+                break;
+            }
+            case REDIS_CMD_BITOP:
+            case REDIS_CMD_BITOPCUNT:
+            {
+                start = 1;
+                stop = args.size();
+                break;
+            }
+            case REDIS_CMD_ZINTERSTORE:
+            case REDIS_CMD_ZUNIONSTORE:
+            {
+                uint32 numkey = 0;
+                if (args.size() < 2 || !string_touint32(args[1], numkey) || args.size() < numkey + 2)
+                {
+                    stop = args.empty() ? 0 : 1;
+                    break;
+                }
+                KeyPrefix dest;
+                dest.ns = ns;
+                dest.key.SetString(args[0], false);
+                keys.insert(dest);
+                start = 2;
+                stop = numkey + 2;
+                break;
+            }
+            case REDIS_CMD_SORT:
+            case REDIS_CMD_GEO_RADIUS:
+            case REDIS_CMD_GEO_RADIUSBYMEMBER:
+            {
+                bool by_pattern = false;
+                for (size_t i = 1; i + 1 < args.size(); i++)
+                {
+                    if (!strcasecmp(args[i].c_str(), "store") || !strcasecmp(args[i].c_str(), "storedist"))
+                    {
+                        KeyPrefix dest;
+                        dest.ns = ns;
+                        dest.key.SetString(args[i + 1], false);
+                        keys.insert(dest);
+                    }
+                    else if (cmd.GetType() == REDIS_CMD_SORT
+                            && (!strcasecmp(args[i].c_str(), "by") || !strcasecmp(args[i].c_str(), "get"))
+                            && args[i + 1].find('*') != std::string::npos)
+                    {
+                        by_pattern = true;
+                    }
+                }
+                if (!args.empty())
+                {
+                    KeyPrefix key;
+                    key.ns = ns;
+                    key.key.SetString(args[0], false);
+                    keys.insert(key);
+                }
+                /*
+                 * keys addressed by BY/GET patterns depend on the sorted elements, they are only known while
+                 * sorting, so the command reads them after the pending batch committed.
+                 */
+                return by_pattern ? -1 : 0;
+            }
+            case REDIS_CMD_MOVE:
+            {
+                if (args.size() >= 2)
+                {
+                    KeyPrefix key;
+                    key.ns = ns;
+                    key.key.SetString(args[0], false);
+                    keys.insert(key);
+                    KeyPrefix dest;
+                    dest.ns.SetString(args[1], false);
+                    dest.key.SetString(args[0], false);
+                    keys.insert(dest);
+                }
+                return 0;
+            }
+            default:
+            {
+                if (cmd.GetType() < REDIS_CMD_DEL)
+                {
+                    return 0;
+                }
+                stop = args.empty() ? 0 : 1;
+                break;
+            }
+        }
+        for (size_t i = start; i < stop && i < args.size(); i += step)
+        {
+            KeyPrefix key;
+            key.ns = ns;
+            key.key.SetString(args[i], false);
+            keys.insert(key);
+        }
+        return 0;
+    }
+
+    static bool keys_intersect(const KeyPrefixSet& ks1, const KeyPrefixSet& ks2)
+    {
+        const KeyPrefixSet& small = ks1.size() < ks2.size() ? ks1 : ks2;
+        const KeyPrefixSet& large = ks1.size() < ks2.size() ? ks2 : ks1;
+        KeyPrefixSet::const_iterator it = small.begin();
+        while (it != small.end())
+        {
+            if (large.count(*it) > 0)
+            {
+                return true;
+            }
+            it++;
+        }
+        return false;
+    }
+
+    void Ardb::CommitTransactionBatch(Context& transc_ctx)
+    {
+        m_engine->CommitWriteBatch(transc_ctx);
+        transc_ctx.write_batch_depth--;
+        InvalidateBatchTouchedKeys(transc_ctx);
+        atomic_add_uint64(&m_exec_batch_commits, 1);
+    }
+
     int Ardb::Exec(Context& ctx, RedisCommandFrame& cmd)
     {
         RedisReply& reply = ctx.GetReply();
@@ -65,40 +286,134 @@ namespace ardb
         {
             reply.SetErrorReason("EXEC without MULTI");
         }
-        else if (ctx.GetTransaction().abort || ctx.GetTransaction().cas)
+        else if (ctx.GetTransaction().abort)
+        {
+            reply.SetErrCode(ERR_EXEC_ABORT);
+            DiscardTransaction(ctx);
+        }
+        else
         {
-            if (ctx.GetTransaction().abort)
+            RedisCommandFrameArray& cmds = ctx.GetTransaction().cached_cmds;
+            /*
+             * Lock the whole key set of the transaction up front, so no other client could observe or
+             * interleave with a partially applied transaction. Watched keys are locked too, and their
+             * versions are checked only after locking, so no write could slip in between check and execution.
+             */
+            std::vector<KeyPrefixSet> cmd_keys(cmds.size());
+            std::vector<bool> cmd_known(cmds.size(), true);
+            KeyPrefixSet all_keys;
+            Data key_ns = ctx.ns;
+            for (size_t i = 0; i < cmds.size(); i++)
             {
-                reply.SetErrCode(ERR_EXEC_ABORT);
+                cmd_known[i] = transaction_cmd_keys(cmds[i], key_ns, cmd_keys[i]) == 0;
+                all_keys.insert(cmd_keys[i].begin(), cmd_keys[i].end());
             }
-            else
+            TransactionContext::WatchKeyTable::iterator wit = ctx.GetTransaction().watched_keys.begin();
+            while (wit != ctx.GetTransaction().watched_keys.end())
             {
+                all_keys.insert(wit->first);
+                wit++;
+            }
+            LockKeys(all_keys);
+            if (IsWatchedKeysTouched(ctx))
+            {
+                UnlockKeys(all_keys);
                 reply.ReserveMember(-1);
+                DiscardTransaction(ctx);
+                if (NULL != m_monitors && !IsLoadingData())
+                {
+                    FeedMonitors(ctx, ctx.ns, cmd);
+                }
+                return 0;
             }
-            DiscardTransaction(ctx);
-        }
-        else
-        {
             UnwatchKeys(ctx);
-            RedisCommandFrameArray::iterator it = ctx.GetTransaction().cached_cmds.begin();
+
             Context transc_ctx;
             transc_ctx.ns = ctx.ns;
-            while (it != ctx.GetTransaction().cached_cmds.end())
+            transc_ctx.flags.no_wal = ctx.flags.no_wal;
+            transc_ctx.flags.slave = ctx.flags.slave;
+            transc_ctx.locked_keys = &all_keys;
+            RedisCommandFrameArray wal_cmds;
+            transc_ctx.wal_cmds = &wal_cmds;
+            Data wal_ns = ctx.ns;
+            int total_dirty = 0;
+
+            /*
+             * Consecutive commands share one engine write batch. On engines whose reads do not see the batch's
+             * own pending writes(rocksdb/leveldb), the batch is committed before a command touching a key already
+             * written in it. A command whose keys are unknown always runs alone, after the batch committed.
+             */
+            bool read_own_writes = m_engine->GetFeatureSet().support_batch_read_own_writes;
+            bool in_batch = false;
+            KeyPrefixSet batch_write_keys;
+            for (size_t i = 0; i < cmds.size(); i++)
             {
                 RedisReply& r = reply.AddMember();
-                RedisCommandHandlerSetting* setting = FindRedisCommandHandlerSetting(*it);
-                if (NULL != setting)
+                RedisCommandHandlerSetting* setting = FindRedisCommandHandlerSetting(cmds[i]);
+                if (NULL == setting)
                 {
-                    transc_ctx.GetReply().Clear();
-                    DoCall(transc_ctx, *setting, *it);
-                    r.Clone(transc_ctx.GetReply());
+                    r.SetErrorReason("unknown command");
+                    continue;
                 }
-                else
+                if (in_batch && (!cmd_known[i] || (!read_own_writes && keys_intersect(batch_write_keys, cmd_keys[i]))))
                 {
-                    r.SetErrorReason("unknown command");
+                    CommitTransactionBatch(transc_ctx);
+                    in_batch = false;
+                    batch_write_keys.clear();
                 }
-                it++;
+                if (!in_batch && cmd_known[i])
+                {
+                    in_batch = m_engine->BeginWriteBatch(transc_ctx) == 0;
+                    if (in_batch)
+                    {
+                        transc_ctx.write_batch_depth++;
+                    }
+                }
+                if (setting->IsWriteCommand())
+                {
+                    batch_write_keys.insert(cmd_keys[i].begin(), cmd_keys[i].end());
+                }
+                Data call_ns = transc_ctx.ns;
+                size_t wal_pos = wal_cmds.size();
+                transc_ctx.dirty = 0;
+                transc_ctx.GetReply().Clear();
+                DoCall(transc_ctx, *setting, cmds[i]);
+                r.Clone(transc_ctx.GetReply());
+                total_dirty += transc_ctx.dirty;
+                if (wal_cmds.size() > wal_pos && call_ns.Compare(wal_ns) != 0)
+                {
+                    RedisCommandFrame select("select");
+                    select.AddArg(call_ns.AsString());
+                    wal_cmds.insert(wal_cmds.begin() + wal_pos, select);
+                    wal_ns = call_ns;
+                }
+                if (in_batch && !cmd_known[i])
+                {
+                    CommitTransactionBatch(transc_ctx);
+                    in_batch = false;
+                    batch_write_keys.clear();
+                }
+            }
+            if (in_batch)
+            {
+                CommitTransactionBatch(transc_ctx);
+            }
+            UnlockKeys(all_keys);
+
+            /*
+             * Propagate the transaction's writes as one contiguous replication log append.
+             */
+            if (!wal_cmds.empty())
+            {
+                if (wal_ns.Compare(ctx.ns) != 0)
+                {
+                    RedisCommandFrame select("select");
+                    select.AddArg(ctx.ns.AsString());
+                    wal_cmds.push_back(select);
+                }
+                FeedReplicationBacklog(ctx, ctx.ns, wal_cmds);
             }
+            ctx.dirty += total_dirty;
             ctx.ns = transc_ctx.ns;
             DiscardTransaction(ctx);
         }
@@ -121,29 +436,41 @@ namespace ardb
         return 0;
     }
 
+    Ardb::WatchedKeyShard& Ardb::GetWatchedKeyShard(const KeyPrefix& key)
+    {
+        uint32 hash = 0;
+        if (key.key.IsString())
+        {
+            MurmurHash3_x86_32(key.key.CStr(), key.key.StringLength(), 0, &hash);
+        }
+        else
+        {
+            std::string kstr;
+            key.key.ToString(kstr);
+            MurmurHash3_x86_32(kstr.data(), kstr.size(), 0, &hash);
+        }
+        return m_watched_keys[hash % ARDB_WATCH_SHARDS];
+    }
+
     int Ardb::TouchWatchedKeysOnFlush(Context& ctx, const Data& ns)
     {
-        if (NULL == m_watched_ctxs)
+        ClearHLLCardCache();
+        if (0 == m_watched_keys_num)
         {
             return 0;
         }
-        LockGuard<SpinMutexLock> guard(m_watched_keys_lock);
-        if (!m_watched_ctxs->empty())
+        for (uint32 i = 0; i < ARDB_WATCH_SHARDS; i++)
         {
-            WatchedContextTable::iterator wit = m_watched_ctxs->begin();
-            while (wit != m_watched_ctxs->end())
+            WatchedKeyShard& shard = m_watched_keys[i];
+            LockGuard<SpinMutexLock> guard(shard.lock);
+            WatchedKeyTable::iterator it = shard.keys.begin();
+            while (it != shard.keys.end())
             {
-                if (ns.IsNil() || wit->first.ns == ns)
+                if (ns.IsNil() || it->first.ns == ns)
                 {
-                    ContextSet::iterator cit = wit->second.begin();
-                    while (cit != wit->second.end())
-                    {
-                        Context* watch_ctx = *cit;
-                        watch_ctx->GetTransaction().cas = true;
-                        cit++;
-                    }
+                    it->second.version++;
                 }
-                wit++;
+                it++;
             }
         }
         return 0;
@@ -151,80 +478,115 @@ namespace ardb
 
     int Ardb::TouchWatchKey(Context& ctx, const KeyObject& key)
     {
-        if (NULL == m_watched_ctxs)
+        /*
+         * HLLs are plain string values, only meta keys may have cached counts. Inside a write batch the
+         * drop waits for the commit, or a PFCOUNT in between could cache the old value again.
+         */
+        if (key.GetType() == KEY_META && GetConf().hll_card_cache_size > 0)
+        {
+            if (ctx.write_batch_depth > 0)
+            {
+                KeyPrefix touched;
+                touched.ns.SetString(key.GetNameSpace().AsString(), false);
+                touched.key.SetString(key.GetKey().AsString(), false);
+                ctx.batch_touched_keys.insert(touched);
+            }
+            else
+            {
+                InvalidateHLLCardCache(key.GetNameSpace(), key.GetKey());
+            }
+        }
+        /*
+         * writers only pay for the shard lock while some client is watching
+         */
+        if (0 == m_watched_keys_num)
         {
             return 0;
         }
-        LockGuard<SpinMutexLock> guard(m_watched_keys_lock);
-        if (NULL != m_watched_ctxs && !m_watched_ctxs->empty())
+        KeyPrefix prefix;
+        prefix.ns = key.GetNameSpace();
+        prefix.key = key.GetKey();
+        WatchedKeyShard& shard = GetWatchedKeyShard(prefix);
+        LockGuard<SpinMutexLock> guard(shard.lock);
+        WatchedKeyTable::iterator found = shard.keys.find(prefix);
+        if (found != shard.keys.end())
         {
-            KeyPrefix prefix;
-            prefix.ns = key.GetNameSpace();
-            prefix.key = key.GetKey();
-            WatchedContextTable::iterator found = m_watched_ctxs->find(prefix);
-            if (found != m_watched_ctxs->end())
-            {
-                ContextSet::iterator cit = found->second.begin();
-                while (cit != found->second.end())
-                {
-                    Context* watch_ctx = *cit;
-                    watch_ctx->GetTransaction().cas = true;
-                    cit++;
-                }
-            }
+            found->second.version++;
         }
         return 0;
     }
 
     int Ardb::WatchForKey(Context& ctx, const std::string& key)
     {
-        LockGuard<SpinMutexLock> guard(m_watched_keys_lock);
-        if (NULL == m_watched_ctxs)
-        {
-            NEW(m_watched_ctxs, WatchedContextTable);
-        }
         KeyPrefix prefix;
         prefix.ns = ctx.ns;
         prefix.key.SetString(key, false);
-        (*m_watched_ctxs)[prefix].insert(&ctx);
-        ctx.GetTransaction().watched_keys.insert(prefix);
+        TransactionContext::WatchKeyTable& watched = ctx.GetTransaction().watched_keys;
+        if (watched.count(prefix) > 0)
+        {
+            return 0;
+        }
+        WatchedKeyShard& shard = GetWatchedKeyShard(prefix);
+        LockGuard<SpinMutexLock> guard(shard.lock);
+        WatchedKeyVersion& v = shard.keys[prefix];
+        if (0 == v.watchers)
+        {
+            atomic_add_uint32(&m_watched_keys_num, 1);
+        }
+        v.watchers++;
+        watched[prefix] = v.version;
         return 0;
     }
 
+    bool Ardb::IsWatchedKeysTouched(Context& ctx)
+    {
+        if (NULL == ctx.transc)
+        {
+            return false;
+        }
+        TransactionContext::WatchKeyTable::iterator it = ctx.GetTransaction().watched_keys.begin();
+        while (it != ctx.GetTransaction().watched_keys.end())
+        {
+            WatchedKeyShard& shard = GetWatchedKeyShard(it->first);
+            LockGuard<SpinMutexLock> guard(shard.lock);
+            WatchedKeyTable::iterator found = shard.keys.find(it->first);
+            if (found == shard.keys.end() || found->second.version != it->second)
+            {
+                return true;
+            }
+            it++;
+        }
+        return false;
+    }
+
     int Ardb::UnwatchKeys(Context& ctx)
     {
-        if (NULL == m_watched_ctxs)
+        if (NULL == ctx.transc)
         {
             return 0;
         }
-        LockGuard<SpinMutexLock> guard(m_watched_keys_lock);
-        if (NULL != m_watched_ctxs && ctx.transc != NULL && !m_watched_ctxs->empty())
+        TransactionContext::WatchKeyTable::iterator it = ctx.GetTransaction().watched_keys.begin();
+        while (it != ctx.GetTransaction().watched_keys.end())
         {
-            TransactionContext::WatchKeySet::iterator it = ctx.GetTransaction().watched_keys.begin();
-            while (it != ctx.GetTransaction().watched_keys.end())
+            WatchedKeyShard& shard = GetWatchedKeyShard(it->first);
+            LockGuard<SpinMutexLock> guard(shard.lock);
+            WatchedKeyTable::iterator found = shard.keys.find(it->first);
+            if (found != shard.keys.end())
             {
-                const KeyPrefix& prefix = *it;
-                WatchedContextTable::iterator fit = m_watched_ctxs->find(prefix);
-                if (fit != m_watched_ctxs->end())
-                {
-                    ContextSet& cset = fit->second;
-                    cset.erase(&ctx);
-                    if (cset.empty())
-                    {
-                        m_watched_ctxs->erase(fit);
-                    }
-                }
-                else
+                found->second.watchers--;
+                if (0 == found->second.watchers)
                 {
-                    WARN_LOG("No found in global watch contexts");
+                    shard.keys.erase(found);
+                    atomic_sub_uint32(&m_watched_keys_num, 1);
                 }
-                it++;
             }
+            else
+            {
+                WARN_LOG("No found in global watched keys");
+            }
+            it++;
         }
-        if (NULL != m_watched_ctxs && m_watched_ctxs->empty())
-        {
-            DELETE(m_watched_ctxs);
-        }
+        ctx.GetTransaction().watched_keys.clear();
         return 0;
     }
 
@@ -589,6 +589,30 @@ void Channel::OnWrite()
     {
         EnableWriting();
         off_t len = m_file_sending->file_rest_len;
+        if (NULL != m_file_sending->limit)
+        {
+            off_t allowed = m_file_sending->limit(m_file_sending->data, m_file_sending->file_offset, len);
+            if (allowed < 0)
+            {
+                if (m_file_sending->close_fd)
+                {
+                    close(m_file_sending->fd);
+                }
+                IOCallback* cb = m_file_sending->on_failure;
+                void* cbdata = m_file_sending->data;
+                DELETE(m_file_sending);
+                if (NULL != cb)
+                {
+                    cb(cbdata);
+                }
+                Close();
+                return;
+            }
+            if (allowed < len)
+            {
+                len = allowed;
+            }
+        }
 #if defined(__APPLE__)
         int ret = ::sendfile(m_file_sending->fd, GetWriteFD(), m_file_sending->file_offset, &len, NULL, 0);
 #elif defined(__FreeBSD__) || defined(__DragonFly__)
@@ -617,7 +641,10 @@ void Channel::OnWrite()
 
         if (m_file_sending->file_rest_len == 0)
         {
-            close(m_file_sending->fd);
+            if (m_file_sending->close_fd)
+            {
+                close(m_file_sending->fd);
+            }
             m_file_sending->fd = -1;
             if (NULL != m_file_sending->on_complete)
             {
@@ -714,7 +741,10 @@ bool Channel::DoClose(bool inDestructor)
 
     if (NULL != m_file_sending)
     {
-        close(m_file_sending->fd);
+        if (m_file_sending->close_fd)
+        {
+            close(m_file_sending->fd);
+        }
         m_file_sending->fd = -1;
         if (NULL != m_file_sending->on_failure)
         {
@@ -126,6 +126,10 @@ namespace ardb
     };
 
     typedef void IOCallback(void* data);
+    /*
+     * returns how many of the rest bytes may be sent now, < 0 aborts the sending(the file region is no longer valid)
+     */
+    typedef off_t SendFileLimit(void* data, off_t file_offset, off_t rest_len);
     struct SendFileSetting
     {
             int fd;
@@ -134,9 +138,11 @@ namespace ardb
             void* data;
             IOCallback* on_complete;
             IOCallback* on_failure;
+            SendFileLimit* limit; //checked before every partial send if set
+            bool close_fd; //close 'fd' after sending, set false to send from a shared fd
             SendFileSetting() :
                     fd(-1), file_offset(0), file_rest_len(0), data(NULL), on_complete(
-                    NULL), on_failure(NULL)
+                    NULL), on_failure(NULL), limit(NULL), close_fd(true)
             {
             }
     };
@@ -355,6 +361,10 @@ namespace ardb
             }
 
             int SendFile(const SendFileSetting& setting);
+            bool IsSendingFile() const
+            {
+                return NULL != m_file_sending;
+            }
 
             bool Flush();
             virtual const Address* GetLocalAddress()
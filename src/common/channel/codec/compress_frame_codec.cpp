@@ -0,0 +1,151 @@
+/*
+ *Copyright (c) 2013-2013, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "compress_frame_codec.hpp"
+#include "buffer/buffer_helper.hpp"
+#include "util/time_helper.hpp"
+#include <snappy.h>
+#include <string.h>
+
+#define COMPRESS_FRAME_HEADER_SIZE 9
+
+namespace ardb
+{
+    namespace codec
+    {
+        CompressType CompressFrameCodec::ParseType(const std::string& name)
+        {
+            if (!strcasecmp(name.c_str(), "snappy"))
+            {
+                return COMPRESS_SNAPPY;
+            }
+            return COMPRESS_NONE;
+        }
+        const char* CompressFrameCodec::TypeName(CompressType type)
+        {
+            switch (type)
+            {
+                case COMPRESS_SNAPPY:
+                {
+                    return "snappy";
+                }
+                default:
+                {
+                    return "none";
+                }
+            }
+        }
+
+        void CompressFrameCodec::Encode(CompressType type, const void* data, size_t len, Buffer& out, CompressStat* stat)
+        {
+            uint64 start = get_current_epoch_micros();
+            size_t header_idx = out.GetWriteIndex();
+            out.EnsureWritableBytes(COMPRESS_FRAME_HEADER_SIZE + snappy::MaxCompressedLength(len));
+            out.AdvanceWriteIndex(COMPRESS_FRAME_HEADER_SIZE);
+            size_t payload_len = 0;
+            uint8 frame_type = COMPRESS_NONE;
+            if (COMPRESS_SNAPPY == type)
+            {
+                snappy::RawCompress((const char*) data, len, const_cast<char*>(out.GetRawWriteBuffer()), &payload_len);
+                if (payload_len < len)
+                {
+                    frame_type = COMPRESS_SNAPPY;
+                }
+            }
+            if (COMPRESS_NONE == frame_type)
+            {
+                memcpy(const_cast<char*>(out.GetRawWriteBuffer()), data, len);
+                payload_len = len;
+            }
+            out.AdvanceWriteIndex(payload_len);
+            size_t end_idx = out.GetWriteIndex();
+            out.SetWriteIndex(header_idx);
+            BufferHelper::WriteFixUInt8(out, frame_type);
+            BufferHelper::WriteFixUInt32(out, len);
+            BufferHelper::WriteFixUInt32(out, payload_len);
+            out.SetWriteIndex(end_idx);
+            if (NULL != stat)
+            {
+                stat->raw_bytes += len;
+                stat->compressed_bytes += payload_len + COMPRESS_FRAME_HEADER_SIZE;
+                stat->cost_micros += get_current_epoch_micros() - start;
+            }
+        }
+
+        int CompressFrameCodec::Decode(Buffer& in, Buffer& out, size_t max_frame_len, CompressStat* stat)
+        {
+            if (in.ReadableBytes() < COMPRESS_FRAME_HEADER_SIZE)
+            {
+                return 0;
+            }
+            uint64 start = get_current_epoch_micros();
+            size_t mark = in.GetReadIndex();
+            uint8 frame_type;
+            uint32 raw_len, payload_len;
+            BufferHelper::ReadFixUInt8(in, frame_type);
+            BufferHelper::ReadFixUInt32(in, raw_len);
+            BufferHelper::ReadFixUInt32(in, payload_len);
+            if (raw_len > max_frame_len || payload_len > max_frame_len)
+            {
+                return -1;
+            }
+            if (in.ReadableBytes() < payload_len)
+            {
+                in.SetReadIndex(mark);
+                return 0;
+            }
+            out.EnsureWritableBytes(raw_len);
+            if (COMPRESS_SNAPPY == frame_type)
+            {
+                size_t len = 0;
+                if (!snappy::GetUncompressedLength(in.GetRawReadBuffer(), payload_len, &len) || len != raw_len
+                        || !snappy::RawUncompress(in.GetRawReadBuffer(), payload_len, const_cast<char*>(out.GetRawWriteBuffer())))
+                {
+                    return -1;
+                }
+            }
+            else if (COMPRESS_NONE == frame_type && payload_len == raw_len)
+            {
+                memcpy(const_cast<char*>(out.GetRawWriteBuffer()), in.GetRawReadBuffer(), raw_len);
+            }
+            else
+            {
+                return -1;
+            }
+            in.AdvanceReadIndex(payload_len);
+            out.AdvanceWriteIndex(raw_len);
+            if (NULL != stat)
+            {
+                stat->raw_bytes += raw_len;
+                stat->compressed_bytes += payload_len + COMPRESS_FRAME_HEADER_SIZE;
+                stat->cost_micros += get_current_epoch_micros() - start;
+            }
+            return 1;
+        }
+    }
+}
@@ -0,0 +1,83 @@
+/*
+ *Copyright (c) 2013-2013, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef COMMON_CHANNEL_CODEC_COMPRESS_FRAME_CODEC_HPP_
+#define COMMON_CHANNEL_CODEC_COMPRESS_FRAME_CODEC_HPP_
+
+#include "common.hpp"
+#include "buffer/buffer.hpp"
+#include <string>
+
+namespace ardb
+{
+    namespace codec
+    {
+        enum CompressType
+        {
+            COMPRESS_NONE = 0, COMPRESS_SNAPPY = 1,
+        };
+
+        struct CompressStat
+        {
+                uint64 raw_bytes;
+                uint64 compressed_bytes;
+                uint64 cost_micros;
+                CompressStat() :
+                        raw_bytes(0), compressed_bytes(0), cost_micros(0)
+                {
+                }
+                double Ratio() const
+                {
+                    return compressed_bytes > 0 ? (double) raw_bytes / compressed_bytes : 0;
+                }
+                void Clear()
+                {
+                    raw_bytes = compressed_bytes = cost_micros = 0;
+                }
+        };
+
+        /*
+         * A compressed frame is:  | type(1) | raw length(4) | payload length(4) | payload |
+         * payload is stored raw if compression could NOT reduce data size.
+         */
+        struct CompressFrameCodec
+        {
+                static CompressType ParseType(const std::string& name);
+                static const char* TypeName(CompressType type);
+                static void Encode(CompressType type, const void* data, size_t len, Buffer& out, CompressStat* stat = NULL);
+                /*
+                 * decode one frame from 'in' to 'out', return 1 if a frame decoded, 0 if more data required, -1 on error.
+                 * frames whose raw or payload length exceed 'max_frame_len' are rejected before any allocation.
+                 */
+                static int Decode(Buffer& in, Buffer& out, size_t max_frame_len, CompressStat* stat = NULL);
+        };
+    }
+}
+
+#endif /* COMMON_CHANNEL_CODEC_COMPRESS_FRAME_CODEC_HPP_ */
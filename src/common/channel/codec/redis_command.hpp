@@ -277,6 +277,7 @@ namespace ardb
             REDIS_CMD_PEXPIRE2 = 1027,
             REDIS_CMD_SETBIT2 = 1028,
             REDIS_CMD_PFADD2 = 1029,
+            REDIS_CMD_PFADD_REGISTERS = 1030, //merge operand only, register updates computed by PFADD
 
             REDIS_CMD_MAX = 1100,
         };
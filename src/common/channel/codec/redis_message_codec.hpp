@@ -39,6 +39,7 @@
 #include "redis_command_codec.hpp"
 #include "redis_reply_codec.hpp"
 #include "dir_sync_decoder.hpp"
+#include "compress_frame_codec.hpp"
 #include "redis_reply.hpp"
 #include "redis_command.hpp"
 
@@ -88,7 +89,50 @@ namespace ardb
                 RedisReplyDecoder m_reply_decoder;
                 RedisDumpFileChunkDecoder m_dump_file_decoder;
                 DirSyncDecoder m_backup_sync_decoder;
+                bool m_compressed;
+                size_t m_max_frame_len;
+                Buffer m_inflated;
+                CompressStat m_inflate_stat;
+                bool HasPendingFrames()
+                {
+                    return m_compressed && m_inflated.Readable();
+                }
                 bool Decode(ChannelHandlerContext& ctx, Channel* channel, Buffer& buffer, RedisMessage& msg)
+                {
+                    if (!m_compressed)
+                    {
+                        return DecodeMessage(ctx, channel, buffer, msg);
+                    }
+                    /*
+                     * inflate all complete frames, then decode messages from inflated data.
+                     */
+                    int ret;
+                    m_inflated.DiscardReadedBytes();
+                    while ((ret = CompressFrameCodec::Decode(buffer, m_inflated, m_max_frame_len, &m_inflate_stat)) > 0)
+                    {
+                    }
+                    if (ret < 0)
+                    {
+                        ERROR_LOG("Invalid compressed frame received.");
+                        channel->Close();
+                        buffer.Clear();
+                        return false;
+                    }
+                    while (m_inflated.Readable())
+                    {
+                        size_t rest = m_inflated.ReadableBytes();
+                        if (DecodeMessage(ctx, channel, m_inflated, msg))
+                        {
+                            return true;
+                        }
+                        if (rest == m_inflated.ReadableBytes())
+                        {
+                            break;
+                        }
+                    }
+                    return false;
+                }
+                bool DecodeMessage(ChannelHandlerContext& ctx, Channel* channel, Buffer& buffer, RedisMessage& msg)
                 {
                     msg.type = m_decoder_type;
                     if (msg.IsReply())
@@ -111,8 +155,32 @@ namespace ardb
                 }
             public:
                 RedisMessageDecoder() :
-                        m_decoder_type(REDIS_COMMAND_DECODER_TYPE)
+                        m_decoder_type(REDIS_COMMAND_DECODER_TYPE), m_compressed(false), m_max_frame_len(0)
+                {
+                }
+                void Clear()
+                {
+                    StackFrameDecoder<RedisMessage>::Clear();
+                    m_dump_file_decoder.Reset();
+                    m_compressed = false;
+                    m_inflated.Clear();
+                    m_inflate_stat.Clear();
+                }
+                /*
+                 * all data after current decoded message are compressed frames.
+                 */
+                void SwitchToCompressedStream(size_t max_frame_len)
+                {
+                    m_compressed = true;
+                    m_max_frame_len = max_frame_len;
+                }
+                bool IsCompressedStream() const
+                {
+                    return m_compressed;
+                }
+                const CompressStat& GetInflateStat() const
                 {
+                    return m_inflate_stat;
                 }
 
                 void SwitchToCommandDecoder()
@@ -263,8 +263,38 @@ bool RedisReplyDecoder::Decode(ChannelHandlerContext& ctx, Channel* channel, Buf
     return ret > 0;
 }
 
+#define DUMP_EOF_MARK_SIZE 40
+
+bool RedisDumpFileChunkDecoder::DecodeEOFMarkedChunk(Buffer& buffer, RedisDumpFileChunk& msg)
+{
+    msg.len = -1;
+    int mark_index = buffer.IndexOf(m_eof_mark.data(), m_eof_mark.size());
+    if (-1 != mark_index)
+    {
+        msg.chunk.assign(buffer.GetRawReadBuffer(), mark_index - buffer.GetReadIndex());
+        buffer.SetReadIndex(mark_index + m_eof_mark.size());
+        m_eof_mark.clear();
+        msg.flag = msg.flag | LAST_CHUNK_FLAG;
+        return true;
+    }
+    /*
+     * keep the tail bytes which may be the prefix of the eof mark
+     */
+    if (buffer.ReadableBytes() >= m_eof_mark.size())
+    {
+        size_t chunklen = buffer.ReadableBytes() - m_eof_mark.size() + 1;
+        msg.chunk.assign(buffer.GetRawReadBuffer(), chunklen);
+        buffer.SkipBytes(chunklen);
+    }
+    return msg.IsFirstChunk() || !msg.chunk.empty();
+}
+
 bool RedisDumpFileChunkDecoder::Decode(ChannelHandlerContext& ctx, Channel* channel, Buffer& buffer, RedisDumpFileChunk& msg)
 {
+    if (!m_eof_mark.empty())
+    {
+        return DecodeEOFMarkedChunk(buffer, msg);
+    }
     if (m_waiting_chunk_len == 0)
     {
         while (buffer.Readable() && buffer.GetRawReadBuffer()[0] == '\n')
@@ -287,6 +317,13 @@ bool RedisDumpFileChunkDecoder::Decode(ChannelHandlerContext& ctx, Channel* chan
         {
             ERROR_LOG("Unexpected char '%c' for receiving redis dump file.", type);
         }
+        if (crlf_index - buffer.GetReadIndex() == 4 + DUMP_EOF_MARK_SIZE && !strncmp(buffer.GetRawReadBuffer(), "EOF:", 4))
+        {
+            m_eof_mark.assign(buffer.GetRawReadBuffer() + 4, DUMP_EOF_MARK_SIZE);
+            buffer.SetReadIndex(crlf_index + 2);
+            msg.flag = msg.flag | FIRST_CHUNK_FLAG;
+            return DecodeEOFMarkedChunk(buffer, msg);
+        }
         if (!raw_toint64(buffer.GetRawReadBuffer(), crlf_index - buffer.GetReadIndex(), msg.len))
         {
             return -1;
@@ -53,11 +53,23 @@ namespace ardb
 			protected:
 				int64 m_waiting_chunk_len;
 				int64 m_all_chunk_len;
+				/*
+				 * dump with unknown size(diskless sync) is sent as '$EOF:<40 bytes mark>\r\n<data><40 bytes mark>'
+				 */
+				std::string m_eof_mark;
 				bool Decode(ChannelHandlerContext& ctx, Channel* channel, Buffer& buffer, RedisDumpFileChunk& msg);
+				bool DecodeEOFMarkedChunk(Buffer& buffer, RedisDumpFileChunk& msg);
 				friend class RedisMessageDecoder;
 				RedisDumpFileChunkDecoder() :m_waiting_chunk_len(0),m_all_chunk_len(0)
 				{
 				}
+			public:
+				void Reset()
+				{
+					m_waiting_chunk_len = 0;
+					m_all_chunk_len = 0;
+					m_eof_mark.clear();
+				}
 		};
 
 		class RedisReplyEncoder: public ChannelDownstreamHandler<RedisReply>
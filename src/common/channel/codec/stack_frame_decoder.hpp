@@ -70,7 +70,7 @@ namespace ardb
 				void CallDecode(ChannelHandlerContext& context,
 						Channel* channel, Buffer& cumulation)
 				{
-					while (!channel->IsReadBlocked() && cumulation.Readable())
+					while (!channel->IsReadBlocked() && (cumulation.Readable() || HasPendingFrames()))
 					{
 						uint32 oldReadableBytes = cumulation.ReadableBytes();
 						T msg;
@@ -129,6 +129,14 @@ namespace ardb
 			protected:
 				virtual bool Decode(ChannelHandlerContext& ctx,
 						Channel* channel, Buffer& buffer, T& msg) = 0;
+				/*
+				 * subclasses which buffer decoded data internally would return true
+				 * to keep decoding even if there is no more data in cumulation.
+				 */
+				virtual bool HasPendingFrames()
+				{
+					return false;
+				}
 				virtual bool DecodeLast(ChannelHandlerContext& ctx,
 						Channel* channel, Buffer& buffer, T& msg)
 				{
@@ -39,20 +39,9 @@ Timer::Timer()
 
 }
 
-TimerTask* Timer::GetNearestTimerTask()
-{
-	return m_task_queue.GetMin();
-}
-
 int64 Timer::GetNearestTaskTriggerTime()
-
 {
-	TimerTask* task = GetNearestTimerTask();
-	if (NULL != task)
-	{
-		return task->m_nextTriggerTime;
-	}
-	return -1;
+	return m_task_wheel.GetNearestTriggerTime();
 }
 
 uint32 Timer::GenerateTimerTaskID()
@@ -80,7 +69,7 @@ void Timer::DoFinalSchedule(TimerTask* task)
 {
 	BeforeScheduled(task);
 	OnScheduled(task);
-	m_task_queue.Add(task);
+	m_task_wheel.Add(task);
 	AfterScheduled(task);
 }
 
@@ -138,7 +127,16 @@ bool Timer::Cancel(uint32 taskID)
 	TimerTaskMap::iterator found = m_task_table.find(taskID);
 	if (found != m_task_table.end())
 	{
-		found->second->Cancel();
+		TimerTask* task = found->second;
+		task->Cancel();
+		/*
+		 * a running task is not in the wheel, it's terminated after running
+		 */
+		if (NULL != task->m_wheel_list)
+		{
+			m_task_wheel.Remove(task);
+			DoTerminated(task);
+		}
 		return true;
 	}
 	return false;
@@ -146,7 +144,7 @@ bool Timer::Cancel(uint32 taskID)
 
 uint32 Timer::GetAlivedTaskNumber()
 {
-	return m_task_queue.GetSize();
+	return m_task_wheel.GetSize();
 }
 
 int64 Timer::GetNextTriggerMillsTime(uint32 taskID)
@@ -176,8 +174,7 @@ bool Timer::AdjustNextTriggerTime(uint32 taskID, int64 value, TimeUnit unit)
 		{
 			newTime -= adjustvalue;
 		}
-		bool ret = m_task_queue.RescheduleTask(task, newTime);
-		ASSERT(ret);
+		m_task_wheel.Reschedule(task, newTime);
 		return true;
 	}
 	return false;
@@ -185,58 +182,44 @@ bool Timer::AdjustNextTriggerTime(uint32 taskID, int64 value, TimeUnit unit)
 
 int64 Timer::Routine()
 {
-	uint32 scheduled = 0;
-	int64 ret = -1;
-
-	while (!m_task_queue.IsEmpty())
+	uint64 now = get_current_epoch_millis();
+	TimerTask* task = NULL;
+	while (NULL != (task = m_task_wheel.PopExpired(now)))
 	{
-		ret = -1;
-		TimerTask* task = m_task_queue.GetMin();
-		uint64 now = get_current_epoch_millis();
-		if (task->m_nextTriggerTime > now)
+		Runnable* runner = task->m_runner;
+		if (NULL == runner || SCHEDULED != task->GetState())
 		{
-			ret = task->m_nextTriggerTime - now;
-			break;
-		} else
+			DoTerminated(task);
+			continue;
+		}
+		if (task->m_period > 0)
 		{
-			if (NULL != task->m_runner)
+			runner->Run();
+			if (SCHEDULED == task->GetState())
 			{
-				if (SCHEDULED == task->GetState())
-				{
-					Runnable* runner = task->m_runner;
-					scheduled++;
-					if (task->m_period > 0)
-					{
-						//task->m_delay = task->m_period;
-						//DoSchedule(task, task->m_delay, task->m_period,
-						//        task->m_unit);
-						m_task_queue.RescheduleMin(
-								get_current_epoch_millis()
-										+ millistime(task->m_period,
-												task->m_unit));
-						runner->Run();
-						continue;
-					} else
-					{
-						m_task_queue.RemoveMin();
-						task->m_state = EXECUTED;
-						runner->Run();
-						DoTerminated(task);
-					}
-				} else
-				{
-					m_task_queue.RemoveMin();
-					DoTerminated(task);
-				}
-			} else //runner is NULL
+				task->m_nextTriggerTime = get_current_epoch_millis()
+						+ millistime(task->m_period, task->m_unit);
+				m_task_wheel.Add(task);
+			}
+			else
 			{
-				m_task_queue.RemoveMin();
+				DoTerminated(task);
 			}
 		}
-
+		else
+		{
+			task->m_state = EXECUTED;
+			runner->Run();
+			DoTerminated(task);
+		}
 	}
-
-	return ret;
+	int64 next = m_task_wheel.GetNearestTriggerTime();
+	if (next < 0)
+	{
+		return -1;
+	}
+	now = get_current_epoch_millis();
+	return (uint64) next > now ? next - now : 1;
 }
 
 Timer::~Timer()
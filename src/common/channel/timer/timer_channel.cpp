@@ -56,12 +56,15 @@ void TimerChannel::OnScheduled(TimerTask* task)
     if (nextTime < 0
             || static_cast<uint64>(nextTime) > task->GetNextTriggerTime())
     {
+        /* the ae timer is in milliseconds whatever the unit of the task is */
+        uint64 now = get_current_epoch_millis();
+        long long delay = task->GetNextTriggerTime() > now ? task->GetNextTriggerTime() - now : 0;
         if (-1 != m_timer_id)
         {
             if (nextTime > 0)
             {
                 aeModifyTimeEvent(GetService().GetRawEventLoop(), m_timer_id,
-                        task->GetDelay());
+                        delay);
             }
             else
             {
@@ -76,7 +79,7 @@ void TimerChannel::OnScheduled(TimerTask* task)
                 m_timer_id = -1;
             }
             m_timer_id = aeCreateTimeEvent(GetService().GetRawEventLoop(),
-                    task->GetDelay(), TimeoutCB, this, NULL);
+                    delay, TimeoutCB, this, NULL);
         }
     }
 }
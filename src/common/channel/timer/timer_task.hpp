@@ -39,7 +39,7 @@ namespace ardb
 		VIRGIN, SCHEDULED, EXECUTED, CANCELLED
 	};
 	class Timer;
-	class TimerTaskQueue;
+	class TimerWheel;
 	class TimerTask
 	{
 		protected:
@@ -51,19 +51,24 @@ namespace ardb
 			uint64 m_nextTriggerTime;
 			Runnable* m_runner;
 			RunnableDestructor* m_runner_destructor;
-			uint32 m_queue_index;
+			/* intrusive handle of the slot holding the task in the timer wheel */
+			TimerTask* m_wheel_prev;
+			TimerTask* m_wheel_next;
+			TimerTask** m_wheel_list;
+			int32 m_wheel_level;
 			inline uint32 GetID()
 			{
 				return m_id;
 			}
 			friend class Timer;
-			friend class TimerTaskQueue;
+			friend class TimerWheel;
 		public:
 			TimerTask(uint32 id, Runnable* runner,
 					RunnableDestructor* destructor) :
 					m_id(id), m_state(VIRGIN), m_delay(0), m_period(0), m_unit(
 							ardb::MILLIS), m_nextTriggerTime(0), m_runner(
-							runner), m_runner_destructor(destructor), m_queue_index(
+							runner), m_runner_destructor(destructor), m_wheel_prev(
+							NULL), m_wheel_next(NULL), m_wheel_list(NULL), m_wheel_level(
 							0)
 			{
 			}
@@ -0,0 +1,246 @@
+ /*
+ *Copyright (c) 2013-2013, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ * 
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ * 
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "timer_wheel.hpp"
+#include "util/time_helper.hpp"
+#include <string.h>
+
+using namespace ardb;
+
+static const uint64 kNearMask = TIMER_WHEEL_NEAR_SIZE - 1;
+static const uint64 kLevelMask = TIMER_WHEEL_LEVEL_SIZE - 1;
+
+static inline uint32 LevelShift(int32 level)
+{
+	return TIMER_WHEEL_NEAR_BITS + level * TIMER_WHEEL_LEVEL_BITS;
+}
+
+TimerWheel::TimerWheel() :
+		m_expired(NULL), m_current(0), m_size(0), m_near_size(0)
+{
+	memset(m_near, 0, sizeof(m_near));
+	memset(m_levels, 0, sizeof(m_levels));
+}
+
+void TimerWheel::Link(TimerTask** list, TimerTask* task, int32 level)
+{
+	task->m_wheel_prev = NULL;
+	task->m_wheel_next = *list;
+	if (NULL != *list)
+	{
+		(*list)->m_wheel_prev = task;
+	}
+	*list = task;
+	task->m_wheel_list = list;
+	task->m_wheel_level = level;
+	if (0 == level)
+	{
+		m_near_size++;
+	}
+}
+
+void TimerWheel::Unlink(TimerTask* task)
+{
+	if (NULL != task->m_wheel_prev)
+	{
+		task->m_wheel_prev->m_wheel_next = task->m_wheel_next;
+	}
+	else
+	{
+		*(task->m_wheel_list) = task->m_wheel_next;
+	}
+	if (NULL != task->m_wheel_next)
+	{
+		task->m_wheel_next->m_wheel_prev = task->m_wheel_prev;
+	}
+	if (0 == task->m_wheel_level)
+	{
+		m_near_size--;
+	}
+	task->m_wheel_prev = NULL;
+	task->m_wheel_next = NULL;
+	task->m_wheel_list = NULL;
+}
+
+void TimerWheel::Place(TimerTask* task)
+{
+	uint64 expires = task->m_nextTriggerTime < m_current ? m_current : task->m_nextTriggerTime;
+	uint64 delta = expires - m_current;
+	if (delta < TIMER_WHEEL_NEAR_SIZE)
+	{
+		Link(&m_near[expires & kNearMask], task, 0);
+		return;
+	}
+	for (int32 level = 0; level < TIMER_WHEEL_LEVELS; level++)
+	{
+		uint64 range = 1ULL << LevelShift(level + 1);
+		if (delta < range || level == TIMER_WHEEL_LEVELS - 1)
+		{
+			if (delta >= range)
+			{
+				/* placed again when the slot is cascaded */
+				expires = m_current + range - 1;
+			}
+			uint32 index = (expires >> LevelShift(level)) & kLevelMask;
+			Link(&m_levels[level][index], task, level + 1);
+			return;
+		}
+	}
+}
+
+void TimerWheel::Cascade(int32 level, uint32 index)
+{
+	TimerTask* task = m_levels[level][index];
+	m_levels[level][index] = NULL;
+	while (NULL != task)
+	{
+		TimerTask* next = task->m_wheel_next;
+		task->m_wheel_list = NULL;
+		Place(task);
+		task = next;
+	}
+}
+
+void TimerWheel::Tick()
+{
+	uint32 index = m_current & kNearMask;
+	if (0 == index)
+	{
+		for (int32 level = 0; level < TIMER_WHEEL_LEVELS; level++)
+		{
+			uint32 level_index = (m_current >> LevelShift(level)) & kLevelMask;
+			Cascade(level, level_index);
+			if (0 != level_index)
+			{
+				break;
+			}
+		}
+	}
+	while (NULL != m_near[index])
+	{
+		TimerTask* task = m_near[index];
+		Unlink(task);
+		Link(&m_expired, task, -1);
+	}
+	m_current++;
+}
+
+void TimerWheel::Add(TimerTask* task)
+{
+	if (0 == m_size)
+	{
+		m_current = get_current_epoch_millis();
+	}
+	Place(task);
+	m_size++;
+}
+
+void TimerWheel::Remove(TimerTask* task)
+{
+	if (NULL == task->m_wheel_list)
+	{
+		return;
+	}
+	Unlink(task);
+	m_size--;
+}
+
+void TimerWheel::Reschedule(TimerTask* task, uint64 newTime)
+{
+	if (NULL == task->m_wheel_list)
+	{
+		/* running, added back by the timer if needed */
+		task->m_nextTriggerTime = newTime;
+		return;
+	}
+	Remove(task);
+	task->m_nextTriggerTime = newTime;
+	Add(task);
+}
+
+/*
+ * Expire the ticks up to 'now' in one batch, return the expired tasks one by one, NULL if there is no more.
+ */
+TimerTask* TimerWheel::PopExpired(uint64 now)
+{
+	while (NULL == m_expired)
+	{
+		if (0 == m_size || m_current > now)
+		{
+			return NULL;
+		}
+		if (0 == m_near_size && 0 != (m_current & kNearMask))
+		{
+			/* nothing in the near slots, jump to the next cascade */
+			uint64 next = (m_current | kNearMask) + 1;
+			m_current = next > now ? now + 1 : next;
+			continue;
+		}
+		Tick();
+	}
+	TimerTask* task = m_expired;
+	Remove(task);
+	return task;
+}
+
+/*
+ * The exact time for tasks in the near slots, the next cascade for the others, which is never later than the
+ * nearest task.
+ */
+int64 TimerWheel::GetNearestTriggerTime()
+{
+	if (0 == m_size)
+	{
+		return -1;
+	}
+	if (NULL != m_expired)
+	{
+		return m_current - 1;
+	}
+	if (m_near_size > 0)
+	{
+		for (uint64 tick = m_current; tick < m_current + TIMER_WHEEL_NEAR_SIZE; tick++)
+		{
+			if (NULL != m_near[tick & kNearMask])
+			{
+				return tick;
+			}
+		}
+	}
+	return ((m_current - 1) | kNearMask) + 1;
+}
+
+void TimerWheel::Clear()
+{
+	memset(m_near, 0, sizeof(m_near));
+	memset(m_levels, 0, sizeof(m_levels));
+	m_expired = NULL;
+	m_size = 0;
+	m_near_size = 0;
+}
@@ -27,23 +27,40 @@
  *THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#ifndef TIMER_TASK_QUEUE_HPP_
-#define TIMER_TASK_QUEUE_HPP_
+#ifndef TIMER_WHEEL_HPP_
+#define TIMER_WHEEL_HPP_
 #include "common.hpp"
 #include "timer_task.hpp"
+
+/*
+ * Hierarchical timing wheel with 1ms ticks, the first level has 256 slots, each of the next four levels has 64 slots
+ * covering 64 slots of the previous level, so ~49 days are covered, tasks beyond that are put in the last slot and
+ * placed again when it's cascaded.
+ */
+#define TIMER_WHEEL_NEAR_BITS 8
+#define TIMER_WHEEL_LEVEL_BITS 6
+#define TIMER_WHEEL_NEAR_SIZE (1 << TIMER_WHEEL_NEAR_BITS)
+#define TIMER_WHEEL_LEVEL_SIZE (1 << TIMER_WHEEL_LEVEL_BITS)
+#define TIMER_WHEEL_LEVELS 4
+
 namespace ardb
 {
-
-	class TimerTaskQueue
+	class TimerWheel
 	{
 		private:
-			TimerTask** m_queue;
-			uint32 m_queue_capacity;
+			TimerTask* m_near[TIMER_WHEEL_NEAR_SIZE];
+			TimerTask* m_levels[TIMER_WHEEL_LEVELS][TIMER_WHEEL_LEVEL_SIZE];
+			TimerTask* m_expired;
+			uint64 m_current; /* next tick to expire */
 			uint32 m_size;
-			void FixUp(uint32 k);
-			void FixDown(uint32 k);
+			uint32 m_near_size;
+			void Link(TimerTask** list, TimerTask* task, int32 level);
+			void Unlink(TimerTask* task);
+			void Place(TimerTask* task);
+			void Cascade(int32 level, uint32 index);
+			void Tick();
 		public:
-			TimerTaskQueue();
+			TimerWheel();
 			inline uint32 GetSize()
 			{
 				return m_size;
@@ -53,17 +70,12 @@ namespace ardb
 				return m_size == 0;
 			}
 			void Add(TimerTask* task);
-			TimerTask* Get(uint32 i);
-			TimerTask* GetMin();
-			void RemoveMin();
-			void QuickRemove(uint32 i);
-			void Heapify();
+			void Remove(TimerTask* task);
+			void Reschedule(TimerTask* task, uint64 newTime);
+			TimerTask* PopExpired(uint64 now);
+			int64 GetNearestTriggerTime();
 			void Clear();
-			int32 FindTaskIndex(TimerTask* task);
-			void RescheduleMin(uint64 newTime);
-			bool RescheduleTask(TimerTask* task, uint64 newTime);
-			~TimerTaskQueue();
 	};
 }
 
-#endif /* TIMER_TASK_QUEUE_HPP_ */
+#endif /* TIMER_WHEEL_HPP_ */
@@ -485,6 +485,60 @@ namespace ardb
         return 2.0 * EARTH_RADIUS_IN_METERS * asin(sqrt(u * u + cos(lat1r) * cos(lat2r) * v * v));
     }
 
+    /*
+     * Same as GetWGS84Distance over a batch of points, the loop is kept branch free so the compiler could vectorize it.
+     */
+    void GeoHashHelper::GetWGS84Distances(double lon1d, double lat1d, const double* lons, const double* lats, double* distances, size_t n)
+    {
+        double lat1r = deg_rad(lat1d);
+        double lon1r = deg_rad(lon1d);
+        double cos_lat1 = cos(lat1r);
+        for (size_t i = 0; i < n; i++)
+        {
+            double lat2r = deg_rad(lats[i]);
+            double u = sin((lat2r - lat1r) / 2);
+            double v = sin((deg_rad(lons[i]) - lon1r) / 2);
+            distances[i] = 2.0 * EARTH_RADIUS_IN_METERS * asin(sqrt(u * u + cos_lat1 * cos(lat2r) * v * v));
+        }
+    }
+
+    /*
+     * Lower bound of the distance from a point to any point inside the area.
+     * Both haversine terms are minimized independently, so the result never exceeds the real minimum.
+     */
+    double GeoHashHelper::GetWGS84MinDistance(double lon1d, double lat1d, const GeoHashArea& area)
+    {
+        double lat_gap = 0, lon_gap = 0;
+        if (lat1d < area.latitude.min)
+        {
+            lat_gap = area.latitude.min - lat1d;
+        }
+        else if (lat1d > area.latitude.max)
+        {
+            lat_gap = lat1d - area.latitude.max;
+        }
+        if (lon1d < area.longitude.min || lon1d > area.longitude.max)
+        {
+            double d1 = fabs(area.longitude.min - lon1d);
+            double d2 = fabs(area.longitude.max - lon1d);
+            lon_gap = d1 < d2 ? d1 : d2;
+            if (lon_gap > 180)
+            {
+                lon_gap = 360 - lon_gap;
+            }
+        }
+        double cos_min = cos(deg_rad(area.latitude.min));
+        double cos_max = cos(deg_rad(area.latitude.max));
+        double u = sin(deg_rad(lat_gap) / 2);
+        double v = sin(deg_rad(lon_gap) / 2);
+        double h = u * u + cos(deg_rad(lat1d)) * (cos_min < cos_max ? cos_min : cos_max) * v * v;
+        if (h > 1)
+        {
+            h = 1;
+        }
+        return 2.0 * EARTH_RADIUS_IN_METERS * asin(sqrt(h));
+    }
+
     bool GeoHashHelper::GetDistanceSquareIfInRadius(uint8 coord_type, double x1, double y1, double x2, double y2, double radius, double& distance,
             double accurace)
     {
@@ -78,6 +78,8 @@ namespace ardb
             static bool GetMercatorXYByHash(GeoHashFix60Bits hash, double& x, double& y);
             static bool GetXYByHash(uint8 coord_type, uint8 step, uint64_t hash, double& x, double& y);
             static double GetWGS84Distance(double lon1d, double lat1d, double lon2d, double lat2d);
+            static void GetWGS84Distances(double lon1d, double lat1d, const double* lons, const double* lats, double* distances, size_t n);
+            static double GetWGS84MinDistance(double lon1d, double lat1d, const GeoHashArea& area);
     };
 }
 
@@ -197,6 +197,15 @@ OP_NAMESPACE_BEGIN
         }
 
         conf_get_bool(props, "repl-disable-tcp-nodelay", repl_disable_tcp_nodelay);
+        conf_get_bool(props, "repl-backlog-sendfile", repl_backlog_sendfile);
+        conf_get_string(props, "repl-compression", repl_compression);
+        conf_get_int64(props, "repl-compression-max-frame-size", repl_compression_max_frame_size);
+        if (repl_compression_max_frame_size < 64 * 1024)
+        {
+            repl_compression_max_frame_size = 64 * 1024;
+        }
+        conf_get_bool(props, "repl-diskless-sync", repl_diskless_sync);
+        conf_get_int64(props, "repl-diskless-sync-delay", repl_diskless_sync_delay);
         conf_get_int64(props, "lua-time-limit", lua_time_limit);
 
         conf_get_int64(props, "snapshot-max-lag-offset", snapshot_max_lag_offset);
@@ -295,7 +304,16 @@ OP_NAMESPACE_BEGIN
         conf_get_int64(props, "qps-limit-per-host", qps_limit_per_host);
         conf_get_int64(props, "qps-limit-per-connection", qps_limit_per_connection);
         conf_get_int64(props, "range-delete-min-size", range_delete_min_size);
+        conf_get_bool(props, "range-delete-compact", range_delete_compact);
+        conf_get_int64(props, "async-delete-threads", async_delete_threads);
+        if (async_delete_threads <= 0)
+        {
+            async_delete_threads = 1;
+        }
+        conf_get_bool(props, "lazyfree-lazy-user-del", lazyfree_lazy_user_del);
+        conf_get_bool(props, "lazyfree-lazy-expire", lazyfree_lazy_expire);
         conf_get_int64(props, "stream-lru-cache-size", stream_lru_cache_size);
+        conf_get_int64(props, "hll-card-cache-size", hll_card_cache_size);
 
         conf_get_bool(props, "rocksdb.read_fill_cache", rocksdb_read_fill_cache);
         conf_get_bool(props, "rocksdb.iter_fill_cache", rocksdb_iter_fill_cache);
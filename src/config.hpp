@@ -132,6 +132,11 @@ OP_NAMESPACE_BEGIN
             bool slave_ignore_expire;
             bool slave_ignore_del;
             bool repl_disable_tcp_nodelay;
+            bool repl_backlog_sendfile;
+            std::string repl_compression;
+            int64 repl_compression_max_frame_size;
+            bool repl_diskless_sync;
+            int64 repl_diskless_sync_delay;
 
             bool scan_redis_compatible;
             int64_t scan_cursor_expire_after;
@@ -152,8 +157,13 @@ OP_NAMESPACE_BEGIN
             int64_t qps_limit_per_connection;
 
             int64_t range_delete_min_size;
+            bool range_delete_compact;
+            int64_t async_delete_threads;
+            bool lazyfree_lazy_user_del;
+            bool lazyfree_lazy_expire;
 
             int64_t stream_lru_cache_size;
+            int64_t hll_card_cache_size;
 
             std::string _conf_file;
             std::string _executable;
@@ -173,11 +183,11 @@ OP_NAMESPACE_BEGIN
                             true), slave_priority(100), max_slave_worker_queue(1024), lua_time_limit(0), master_port(0), loglevel(
                             "INFO"), hll_sparse_max_bytes(3000), reply_pool_size(1000), slave_client_output_buffer_limit(
                             256 * 1024 * 1024), pubsub_client_output_buffer_limit(32 * 1024 * 1024), slave_ignore_expire(
-                            false), slave_ignore_del(false), repl_disable_tcp_nodelay(true), scan_redis_compatible(
+                            false), slave_ignore_del(false), repl_disable_tcp_nodelay(true), repl_backlog_sendfile(true), repl_compression("none"), repl_compression_max_frame_size(64 * 1024 * 1024), repl_diskless_sync(false), repl_diskless_sync_delay(5), scan_redis_compatible(
                             true), scan_cursor_expire_after(60), snapshot_max_lag_offset(500 * 1024 * 1024), maxsnapshots(
                             10), redis_compatible(false), compact_after_snapshot_load(false), redis_compatible_version(
                             "2.8.0"), statistics_log_period(300), qps_limit_per_host(0), qps_limit_per_connection(0), range_delete_min_size(
-                            100), stream_lru_cache_size(1024),rocksdb_read_fill_cache(true),rocksdb_iter_fill_cache(true)
+                            100), range_delete_compact(true), async_delete_threads(2), lazyfree_lazy_user_del(true), lazyfree_lazy_expire(true), stream_lru_cache_size(1024),hll_card_cache_size(1024),rocksdb_read_fill_cache(true),rocksdb_iter_fill_cache(true)
             {
             }
             bool Parse(const Properties& props);
@@ -139,12 +139,14 @@ OP_NAMESPACE_BEGIN
     {
             bool started;
             bool abort;
-            bool cas;
             RedisCommandFrameArray cached_cmds;
-            typedef TreeSet<KeyPrefix>::Type WatchKeySet;
-            WatchKeySet watched_keys;
+            /*
+             * watched key -> key version at WATCH time
+             */
+            typedef TreeMap<KeyPrefix, uint64>::Type WatchKeyTable;
+            WatchKeyTable watched_keys;
             TransactionContext()
-                    : started(false), abort(false), cas(false)
+                    : started(false), abort(false)
             {
             }
     };
@@ -178,8 +180,9 @@ OP_NAMESPACE_BEGIN
             BlockListTarget* list_target;
             BlockStreamTarget* stream_target;
             uint32 block_keytype;
+            bool woken; /* served by a wakeup, the client is removed from the other keys' queues on unblock */
             BlockingState()
-                    : timeout(0), list_target(NULL), stream_target(NULL), block_keytype(0)
+                    : timeout(0), list_target(NULL), stream_target(NULL), block_keytype(0), woken(false)
             {
             }
             BlockListTarget& GetListTarget()
@@ -235,6 +238,20 @@ OP_NAMESPACE_BEGIN
             CallFlags flags;
             bool authenticated;
             bool keyslocked;
+            /*
+             * keys already locked for the whole transaction(MULTI/EXEC), key lock guards skip them.
+             */
+            const KeyPrefixSet* locked_keys;
+            /*
+             * write commands to propagate are collected here instead of feeding replication log one by one.
+             */
+            RedisCommandFrameArray* wal_cmds;
+            /*
+             * nesting depth of open engine write batches, and the keys written inside them whose cached
+             * reads(PFCOUNT) can only be dropped once the batch is committed and visible.
+             */
+            uint32 write_batch_depth;
+            KeyPrefixSet batch_touched_keys;
 
             const void* engine_snapshot;
             void* cmd_proxy;
@@ -242,7 +259,7 @@ OP_NAMESPACE_BEGIN
             Context()
                     : reply(NULL), client(NULL), transc(NULL), pubsub(
                     NULL), bpop(NULL), current_cmd(NULL), dirty(0), last_cmdtype(REDIS_CMD_INVALID), transc_err(0), authenticated(
-                            true), keyslocked(false), engine_snapshot(NULL), cmd_proxy(NULL)
+                            true), keyslocked(false), locked_keys(NULL), wal_cmds(NULL), write_batch_depth(0), engine_snapshot(NULL), cmd_proxy(NULL)
             {
                 ns.SetString("0", false);
             }
@@ -300,6 +317,10 @@ OP_NAMESPACE_BEGIN
             {
                 DELETE(bpop);
             }
+            bool IsKeyLocked(const KeyPrefix& key) const
+            {
+                return NULL != locked_keys && locked_keys->count(key) > 0;
+            }
             bool InTransaction()
             {
                 return transc != NULL && transc->started;
@@ -633,7 +633,9 @@ OP_NAMESPACE_BEGIN
             StreamID lastid;
             ConsumerTable consumers;
             PELTable consumer_pels;
+            bool pels_loaded; /* false if only the group header was loaded, see Ardb::StreamLoadGroupPELs() */
             StreamGroupMeta()
+                    : pels_loaded(true)
             {
             }
             StreamID StartId()
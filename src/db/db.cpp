@@ -88,9 +88,14 @@ OP_NAMESPACE_BEGIN
     {
         if (lock)
         {
-            ctx.keyslocked = true;
             lk.key = key.GetKey();
             lk.ns = key.GetNameSpace();
+            if (ctx.IsKeyLocked(lk))
+            {
+                lock = false;
+                return;
+            }
+            ctx.keyslocked = true;
             g_db->LockKey(lk);
         }
 
@@ -114,7 +119,10 @@ OP_NAMESPACE_BEGIN
             KeyPrefix lk;
             lk.key = keys[i].GetKey();
             lk.ns = keys[i].GetNameSpace();
-            ks.insert(lk);
+            if (!ctx.IsKeyLocked(lk))
+            {
+                ks.insert(lk);
+            }
         }
         g_db->LockKeys(ks);
     }
@@ -126,8 +134,14 @@ OP_NAMESPACE_BEGIN
         lk1.ns = key1.GetNameSpace();
         lk2.key = key2.GetKey();
         lk2.ns = key2.GetNameSpace();
-        ks.insert(lk1);
-        ks.insert(lk2);
+        if (!ctx.IsKeyLocked(lk1))
+        {
+            ks.insert(lk1);
+        }
+        if (!ctx.IsKeyLocked(lk2))
+        {
+            ks.insert(lk2);
+        }
         g_db->LockKeys(ks);
     }
     Ardb::KeysLockGuard::~KeysLockGuard()
@@ -140,10 +154,11 @@ OP_NAMESPACE_BEGIN
 
     Ardb::Ardb()
             : m_engine(NULL), m_starttime(0), m_loading_data(false), m_compacting_data(false), m_prepare_snapshot_num(
-                    0), m_write_caller_num(0), m_db_caller_num(0), m_redis_cursor_seed(0), m_watched_ctxs(NULL), m_ready_keys(
-                    NULL), m_monitors(
+                    0), m_write_caller_num(0), m_db_caller_num(0), m_redis_cursor_seed(0), m_watched_keys_num(0), m_ready_keys_num(
+                    0), m_blocked_clients(0), m_hll_card_keys_num(0), m_hll_card_seq(0), m_monitors(
             NULL), m_restoring_nss(
-            NULL), m_min_ttl(-1),g_background(NULL)
+            NULL), m_min_ttl(-1), m_async_delete_queued(0), m_async_delete_done(0), m_range_delete_count(
+                    0), m_range_compact_queued(0), m_range_compact_done(0), m_lazy_delete_queued(0), m_lazy_delete_done(0), m_exec_batch_commits(0)
     {
         g_db = this;
         m_settings.set_empty_key("");
@@ -438,8 +453,6 @@ OP_NAMESPACE_BEGIN
     {
     	StopBackGroundThread();
         DELETE(m_engine);
-        DELETE(m_ready_keys);
-        DELETE(m_watched_ctxs);
         ArdbLogger::DestroyDefaultLogger();
     }
 
@@ -673,26 +686,37 @@ OP_NAMESPACE_BEGIN
         if (m_compacting_data)
         {
             WARN_LOG("Can NOT launch compact task since server is compacting db.");
-            return -1;
+            return ERR_NOTPERFORMED;
         }
         KeyObject start, end;
         start.SetNameSpace(ctx.ns);
         m_compacting_data = true;
-        m_engine->Compact(ctx, start, end);
+        int err = m_engine->Compact(ctx, start, end);
+        if (ERR_NOTSUPPORTED == err)
+        {
+            /*
+             * engines without range compaction(lmdb) compact the whole data instead.
+             */
+            err = m_engine->CompactAll(ctx);
+        }
+        else if (ERR_ENTRY_NOT_EXIST == err)
+        {
+            err = 0;
+        }
         m_compacting_data = false;
-        return 0;
+        return err;
     }
     int Ardb::CompactAll(Context& ctx)
     {
         if (m_compacting_data)
         {
             WARN_LOG("Can NOT launch compact task since server is compacting db.");
-            return -1;
+            return ERR_NOTPERFORMED;
         }
         m_compacting_data = true;
-        m_engine->CompactAll(ctx);
+        int err = m_engine->CompactAll(ctx);
         m_compacting_data = false;
-        return 0;
+        return err;
     }
 
     int Ardb::FlushDB(Context& ctx, const Data& ns)
@@ -770,6 +794,20 @@ OP_NAMESPACE_BEGIN
 //        lk.key = key.GetKey();
         {
             LockGuard<SpinMutexLock> guard(m_locking_keys_lock);
+            PurgingKeyTable::iterator purging = m_purging_keys.find(lk);
+            if (purging != m_purging_keys.end())
+            {
+                if (!purging->second)
+                {
+                    /*
+                     * the elements of the deleted key are still purged in background(or the purge finished before
+                     * the lock holder), the lock is released by whichever finishes last.
+                     */
+                    purging->second = true;
+                    return;
+                }
+                m_purging_keys.erase(purging);
+            }
             LockTable::iterator ret = m_locking_keys.find(lk);
             if (ret != m_locking_keys.end())
             {
@@ -840,6 +878,18 @@ OP_NAMESPACE_BEGIN
         FeedReplicationBacklog(ctx, ns, del);
     }
 
+    void Ardb::FeedReplicationBacklog(Context& ctx, const Data& ns, const RedisCommandFrameArray& cmds)
+    {
+        if (!g_repl->IsInited() || cmds.empty())
+        {
+            return;
+        }
+        /*
+         * all commands are appended to the replication log as one contiguous entry
+         */
+        g_repl->GetReplLog().WriteWAL(ns, cmds);
+    }
+
     void Ardb::FeedReplicationBacklog(Context& ctx, const Data& ns, RedisCommandFrame& cmd)
     {
         if (!g_repl->IsInited())
@@ -952,6 +1002,12 @@ OP_NAMESPACE_BEGIN
                     {
                         m_engine->Del(scan_ctx, meta_key);
                     }
+                    else if (GetConf().lazyfree_lazy_expire)
+                    {
+                        Iterator* del_iter = NULL;
+                        DelKeyLazily(scan_ctx, meta_key, del_iter);
+                        DELETE(del_iter);
+                    }
                     else
                     {
                         DelKey(scan_ctx, meta_key);
@@ -1375,6 +1431,10 @@ OP_NAMESPACE_BEGIN
 
         int ret = (this->*(setting.handler))(ctx, args);
         atomic_sub_uint32(&m_db_caller_num, 1);
+        if (0 == ctx.write_batch_depth && !ctx.batch_touched_keys.empty())
+        {
+            InvalidateBatchTouchedKeys(ctx);
+        }
         if(!ctx.post_cmd_func.empty())
         {
             for(size_t i = 0; i < ctx.post_cmd_func.size(); i++)
@@ -1398,7 +1458,14 @@ OP_NAMESPACE_BEGIN
          */
         if (!ctx.flags.no_wal && ctx.dirty > 0 && setting.IsWriteCommand())
         {
-            FeedReplicationBacklog(ctx, ctx.ns, args);
+            if (NULL != ctx.wal_cmds)
+            {
+                ctx.wal_cmds->push_back(args);
+            }
+            else
+            {
+                FeedReplicationBacklog(ctx, ctx.ns, args);
+            }
         }
         if (setting.IsWriteCommand())
         {
@@ -43,9 +43,13 @@
 #include "config.hpp"
 #include "logger.hpp"
 #include <stack>
+#include <deque>
 #include <sparsehash/dense_hash_map>
 
 #define TTL_DB_NSMAESPACE "__TTL_DB__"
+#define ARDB_WATCH_SHARDS 64
+#define ARDB_BLOCKING_SHARDS 64
+#define ARDB_BLOCKING_WAKE_BATCH 64  /* max waiters tried per ready key in one wake round */
 
 using namespace ardb::codec;
 
@@ -57,6 +61,40 @@ OP_NAMESPACE_BEGIN
     struct StreamGroupMeta;
     struct StreamNACK;
     class BackGroundThread;
+
+    /*
+     * Glob pattern compiled for key scans, all matched keys start with 'prefix', so a scan could
+     * start at the prefix and stop at the first key out of it.
+     */
+    struct KeyPattern
+    {
+            std::string pattern;
+            std::string prefix;
+            bool literal;       /* no glob chars, match the exact key */
+            bool prefix_only;   /* 'prefix*', every key in range matches */
+            KeyPattern(const std::string& p);
+            bool InRange(const std::string& key) const
+            {
+                return key.compare(0, prefix.size(), prefix) == 0;
+            }
+            bool Match(const std::string& key) const;
+    };
+    /*
+     * KEYSCOUNT split into disjoint key ranges counted by background workers
+     */
+    struct KeysCountJob
+    {
+            KeyPattern pattern;
+            Data ns;
+            ThreadMutexLock lock;
+            uint32 pending;
+            int64 count;
+            KeysCountJob(const std::string& p)
+                    : pattern(p), pending(0), count(0)
+            {
+            }
+    };
+
     class Ardb
     {
         public:
@@ -126,6 +164,12 @@ OP_NAMESPACE_BEGIN
             SpinMutexLock m_locking_keys_lock;
             LockTable m_locking_keys;
             LockPool m_lock_pool;
+            /*
+             * keys whose elements are purged in background after a lazy deletion, value is true once one of the
+             * lock holder & the purge task released the key lock.
+             */
+            typedef TreeMap<KeyPrefix, bool>::Type PurgingKeyTable;
+            PurgingKeyTable m_purging_keys;
 
             SpinMutexLock m_redis_cursor_lock;
             typedef LRUCache<uint64, std::string> RedisCursorCache;
@@ -137,15 +181,83 @@ OP_NAMESPACE_BEGIN
             PubSubChannelTable m_pubsub_channels;
             PubSubChannelTable m_pubsub_patterns;
 
-            SpinMutexLock m_watched_keys_lock;
-            typedef TreeMap<KeyPrefix, ContextSet>::Type WatchedContextTable;
-            WatchedContextTable* m_watched_ctxs;
-
-            SpinMutexLock m_block_keys_lock;
-            typedef TreeMap<KeyPrefix, ContextSet>::Type BlockedContextTable;
+            /*
+             * WATCH records the version of a watched key, writers bump it, EXEC compares.
+             * Only watched keys have an entry, the table is sharded by key hash to keep writers apart.
+             */
+            struct WatchedKeyVersion
+            {
+                    uint64 version;
+                    uint32 watchers;
+                    WatchedKeyVersion()
+                            : version(0), watchers(0)
+                    {
+                    }
+            };
+            typedef TreeMap<KeyPrefix, WatchedKeyVersion>::Type WatchedKeyTable;
+            struct WatchedKeyShard
+            {
+                    SpinMutexLock lock;
+                    WatchedKeyTable keys;
+            };
+            WatchedKeyShard m_watched_keys[ARDB_WATCH_SHARDS];
+            volatile uint32 m_watched_keys_num;
+
+            /*
+             * Clients blocked on a key wait in a FIFO queue, so they are served in arrival order. The ready keys
+             * have their own lock since a key could be signaled by a wakeup holding the shard lock(BRPOPLPUSH).
+             */
+            typedef std::deque<Context*> BlockedContextQueue;
+            typedef TreeMap<KeyPrefix, BlockedContextQueue>::Type BlockedContextTable;
             typedef TreeSet<KeyPrefix>::Type ReadyKeySet;
-            BlockedContextTable m_blocked_ctxs;
-            ReadyKeySet* m_ready_keys;
+            struct BlockingShard
+            {
+                    SpinMutexLock lock;
+                    BlockedContextTable keys;
+                    volatile uint32 blocked_num;
+                    SpinMutexLock ready_lock;
+                    ReadyKeySet ready_keys;
+                    volatile uint32 ready_num;
+                    BlockingShard()
+                            : blocked_num(0), ready_num(0)
+                    {
+                    }
+            };
+            BlockingShard m_blocking_shards[ARDB_BLOCKING_SHARDS];
+            volatile uint32 m_ready_keys_num;
+            volatile uint32 m_blocked_clients;
+
+            /*
+             * PFCOUNT results of recently counted key sets, an entry is dropped on a write to any of its keys.
+             * The key -> cached key sets links are sharded like the watched keys, so writers only take the lock
+             * of their own key's shard and only while it links some cached set.
+             */
+            struct HLLCardCacheEntry
+            {
+                    uint64 seq;
+                    int64 card; /* -1 while being counted */
+                    HLLCardCacheEntry()
+                            : seq(0), card(-1)
+                    {
+                    }
+            };
+            typedef LRUCache<std::string, HLLCardCacheEntry> HLLCardCache;
+            typedef TreeMap<KeyPrefix, StringTreeSet>::Type HLLCardMemberTable;
+            struct HLLCardMemberShard
+            {
+                    SpinMutexLock lock;
+                    HLLCardMemberTable keys;
+                    volatile uint32 keys_num;
+                    HLLCardMemberShard()
+                            : keys_num(0)
+                    {
+                    }
+            };
+            SpinMutexLock m_hll_card_lock;
+            HLLCardCache m_hll_cards;
+            HLLCardMemberShard m_hll_card_members[ARDB_WATCH_SHARDS];
+            volatile uint32 m_hll_card_keys_num; /* cached key sets */
+            uint64 m_hll_card_seq;
 
             SpinRWLock m_monitors_lock;
             ContextSet* m_monitors;
@@ -160,7 +272,16 @@ OP_NAMESPACE_BEGIN
 
             int64_t m_min_ttl;
 
-            BackGroundThread* g_background;
+            typedef std::vector<BackGroundThread*> BackGroundThreadArray;
+            BackGroundThreadArray m_background_workers;
+            volatile uint64_t m_async_delete_queued;
+            volatile uint64_t m_async_delete_done;
+            volatile uint64_t m_range_delete_count;
+            volatile uint64_t m_range_compact_queued;
+            volatile uint64_t m_range_compact_done;
+            volatile uint64_t m_lazy_delete_queued;
+            volatile uint64_t m_lazy_delete_done;
+            volatile uint64_t m_exec_batch_commits;
 
             static void MigrateCoroTask(void* data);
             static void MigrateDBCoroTask(void* data);
@@ -178,6 +299,7 @@ OP_NAMESPACE_BEGIN
             void SaveTTL(Context& ctx, const Data& ns, const std::string& key, int64 old_ttl, int64_t new_ttl);
             void ScanTTLDB();
             void FeedReplicationBacklog(Context& ctx, const Data& ns, RedisCommandFrame& cmd);
+            void FeedReplicationBacklog(Context& ctx, const Data& ns, const RedisCommandFrameArray& cmds);
             void FeedMonitors(Context& ctx, const Data& ns, RedisCommandFrame& cmd);
 
             int WriteReply(Context& ctx, RedisReply* r, bool async);
@@ -206,6 +328,7 @@ OP_NAMESPACE_BEGIN
             uint64 GetNewRedisCursor(const std::string& element);
 
             int GetValueByPattern(Context& ctx, const Slice& pattern, Data& subst, Data& value);
+            void GetValuesByPattern(Context& ctx, const Slice& pattern, const std::vector<const Data*>& substs, DataArray& values);
 
             void TryPushSlowCommand(const RedisCommandFrame& cmd, uint64 micros);
             void GetSlowlog(Context& ctx, uint32 len);
@@ -242,6 +365,17 @@ OP_NAMESPACE_BEGIN
                     uint8* oldbit);
             int MergePFAdd(Context& ctx, const KeyObject& key, ValueObject& value, const DataArray& ms, int* updated =
             NULL);
+            int64 GetHLLCardCache(const std::string& cache_key, uint64& seq);
+            void SetHLLCardCache(const std::string& cache_key, uint64 seq, uint64 card);
+            HLLCardMemberShard& GetHLLCardMemberShard(const KeyPrefix& member);
+            void LinkHLLCardCache(const std::string& cache_key);
+            void UnlinkHLLCardCache(const std::string& cache_key);
+            void InvalidateHLLCardCache(const Data& ns, const Data& key);
+            void InvalidateBatchTouchedKeys(Context& ctx);
+            void ClearHLLCardCache();
+            int MergePFAddRegisters(Context& ctx, const KeyObject& key, ValueObject& value, const Data& deltas,
+                    std::string* applied = NULL);
+            void CombinePFAddRegisters(const Data& left, Data& right);
 
             bool CheckMeta(Context& ctx, const std::string& key, KeyType expected);
             bool CheckMeta(Context& ctx, const std::string& key, KeyType expected, ValueObject& meta);
@@ -253,6 +387,9 @@ OP_NAMESPACE_BEGIN
             int DelKey(Context& ctx, const KeyObject& meta_key, Iterator*& iter);
             int DelKey(Context& ctx, const std::string& key);
             int DelKey(Context& ctx, const KeyObject& key);
+            int DelKeyLazily(Context& ctx, const KeyObject& meta_key, Iterator*& iter);
+            int RemoveElements(Context& ctx, const KeyObject& meta_key, Iterator*& iter);
+            void RemoveTTLIndex(Context& ctx, const KeyObject& meta_key, int64 ttl);
             int MoveKey(Context& ctx, RedisCommandFrame& cmd);
             int AsyncDeleteKey(Context& ctx, const Data& ns, const std::string& key);
 
@@ -269,25 +406,32 @@ OP_NAMESPACE_BEGIN
             int64_t StreamDelConsumer(Context& ctx, const std::string& key, const std::string& group,
                     const std::string& consumer);
             int64_t StreamDelGroup(Context& ctx, const std::string& key, const std::string& group);
+            int64_t StreamTrim(Context& ctx, const std::string& key, ValueObject& meta, int64_t limit,
+                    const StreamID* minid);
             int64_t StreamTrimByLength(Context& ctx, const std::string& key, ValueObject& meta, size_t maxlen,
                     int approx);
+            int64_t StreamTrimByMinID(Context& ctx, const std::string& key, ValueObject& meta, const StreamID& minid);
             int StreamCreateNACK(Context& ctx, const std::string& key, const std::string& group,
                     const std::string& consumer, const StreamID& id, StreamGroupMeta* group_meta);
             int StreamUpdateNACK(Context& ctx, const std::string& key, const std::string& group,
                     const std::string& consumer, const StreamID& id, StreamGroupMeta* group_meta, StreamNACK* nack);
             int StreamAddConsumer(Context& ctx, const std::string& consumer, StreamGroupMeta* group_meta);
             int StreamMinMaxID(Context& ctx, const std::string& key, StreamID& min, StreamID& max, ValueObject& minv, ValueObject& maxv);
-            StreamGroupMeta* StreamLoadGroup(Context& ctx, const KeyPrefix& key, const std::string& group);
-            StreamGroupMeta* StreamLoadGroup(Context& ctx, const std::string& key, const std::string& group);
+            StreamGroupMeta* StreamLoadGroup(Context& ctx, const KeyPrefix& key, const std::string& group, bool load_pels = true);
+            StreamGroupMeta* StreamLoadGroup(Context& ctx, const std::string& key, const std::string& group, bool load_pels = true);
             StreamGroupTable* StreamLoadGroups(Context& ctx, const std::string& key, bool create_ifnotexist);
             StreamGroupTable* StreamLoadGroups(Context& ctx, const KeyPrefix& key, bool create_ifnotexist);
             StreamGroupTable* StreamLoadGroups(Iterator* iter);
+            int StreamLoadGroupPELs(Context& ctx, const KeyPrefix& key, StreamGroupMeta* group);
             void ClearRetiredStreamCache();
 
             int WatchForKey(Context& ctx, const std::string& key);
             int UnwatchKeys(Context& ctx);
+            bool IsWatchedKeysTouched(Context& ctx);
+            WatchedKeyShard& GetWatchedKeyShard(const KeyPrefix& key);
             int TouchWatchedKeysOnFlush(Context& ctx, const Data& ns);
             int DiscardTransaction(Context& ctx);
+            void CommitTransactionBatch(Context& transc_ctx);
 
             int BlockForKeys(Context& ctx, const StringArray& keys, const AnyArray& vals, KeyType ktype, uint32 mstimeout);
             static void AsyncUnblockKeysCallback(Channel* ch, void * data);
@@ -296,6 +440,7 @@ OP_NAMESPACE_BEGIN
             int WakeClientsBlockingOnList(Context& ctx,  const KeyPrefix& ready_key, Context& unblock_client);
             int WakeClientsBlockingOnStream(Context& ctx, const KeyPrefix& ready_key,  Context& unblock_client);
             int WakeClientsBlockingOnKeys(Context& ctx);
+            BlockingShard& GetBlockingShard(const KeyPrefix& key);
             int SignalKeyAsReady(Context& ctx, const std::string& key);
             int ServeClientBlockedOnList(Context& ctx, const KeyPrefix& key, const std::string& value);
 
@@ -316,6 +461,8 @@ OP_NAMESPACE_BEGIN
             int SlowLog(Context& ctx, RedisCommandFrame& cmd);
             int Client(Context& ctx, RedisCommandFrame& cmd);
             int Keys(Context& ctx, RedisCommandFrame& cmd);
+            int64 MatchKeys(Context& ctx, const KeyPattern& pattern, const std::string& start, const std::string& end, RedisReply* reply);
+            int64 ParallelKeysCount(Context& ctx, const std::string& pattern);
             int KeysCount(Context& ctx, RedisCommandFrame& cmd);
             int Randomkey(Context& ctx, RedisCommandFrame& cmd);
             int Scan(Context& ctx, RedisCommandFrame& cmd);
@@ -514,11 +661,16 @@ OP_NAMESPACE_BEGIN
 
             int CreateBackGroundThread();
             int StopBackGroundThread();
+            BackGroundThread* SelectBackGroundThread(const KeyPrefix& k);
+            void ScheduleRangeCompaction(Context& ctx, const KeyObject& meta_key);
+            void ScheduleElementsPurge(Context& ctx, const KeyObject& meta_key);
+            void FillBackGroundInfo(std::string& info);
 
             friend class LUAInterpreter;
             friend class ObjectIO;
             friend class ObjectBuffer;
             friend class Snapshot;
+            friend class SnapshotStreamLoader;
             friend class Master;
             friend class Slave;
             friend class BackGroundThread;
@@ -63,6 +63,7 @@ OP_NAMESPACE_BEGIN
     };
 
     typedef const void* EngineSnapshot;
+    typedef void CheckpointPinnedCallback(void* data);
 
     struct FeatureSet
     {
@@ -71,8 +72,13 @@ OP_NAMESPACE_BEGIN
             unsigned support_merge :1;
             unsigned support_backup :1;
             unsigned support_delete_range :1;
+            unsigned support_checkpoint :1;
+            unsigned support_range_compact :1; /* Compact() works on the given key range instead of a whole table/file */
+            unsigned support_concurrent_iterator :1; /* iterators of different threads do NOT serialize with each other or writers */
+            unsigned support_batch_read_own_writes :1; /* reads inside a write batch see the batch's pending writes */
             FeatureSet() :
                     support_namespace(0), support_compactfilter(0), support_merge(0), support_backup(0), support_delete_range(
+                            0), support_checkpoint(0), support_range_compact(0), support_concurrent_iterator(0), support_batch_read_own_writes(
                             0)
             {
             }
@@ -137,6 +143,16 @@ OP_NAMESPACE_BEGIN
             {
                 return ERR_NOTSUPPORTED;
             }
+            /*
+             * Create a consistent checkpoint in 'dir' which could be restored by 'Restore'. Immutable files already
+             * exist in 'base_dir'(previous checkpoint) would be hard linked instead of copied.
+             * 'on_pinned' is invoked as soon as the file set is pinned, writes could be resumed after that.
+             */
+            virtual int Checkpoint(Context& ctx, const std::string& dir, const std::string& base_dir, CheckpointPinnedCallback* on_pinned,
+                    void* data)
+            {
+                return ERR_NOTSUPPORTED;
+            }
 
             virtual int64_t EstimateKeysNum(Context& ctx, const Data& ns) = 0;
             virtual void Stats(Context& ctx, std::string& str) = 0;
@@ -178,6 +194,7 @@ OP_NAMESPACE_BEGIN
                 if (0 == err)
                 {
                     engine = e;
+                    ctx.write_batch_depth++;
                 }
             }
             void MarkFailed(int errcode)
@@ -196,6 +213,7 @@ OP_NAMESPACE_BEGIN
                     {
                         engine->DiscardWriteBatch(ctx);
                     }
+                    ctx.write_batch_depth--;
                     ctx.transc_err = err;
                 }
             }
@@ -109,6 +109,13 @@ namespace ardb
     static ForestDBEngine* g_fdb_engine = NULL;
     static std::string g_fdb_dir;
     static fdb_config g_fdb_config;
+    /*
+     * Standalone mutations stay in the handle's WAL(already visible to other handles on the file) and are committed
+     * once wal_threshold ops or 'g_fdb_commit_batch_bytes' bytes are pending, or the oldest one is older than
+     * 'g_fdb_commit_interval' ms. 0 interval commits after every mutation.
+     */
+    static int64 g_fdb_commit_interval = 1000;
+    static int64 g_fdb_commit_batch_bytes = 4 * 1024 * 1024;
 
     struct ForestDBLocalContext
     {
@@ -120,9 +127,13 @@ namespace ardb
             KVStoreTable kv_stores;
             uint32 txn_ref;
             uint32 iter_count;
+            uint64 pending_ops;
+            uint64 pending_bytes;
+            uint64 pending_since;
             Buffer encode_buffer_cache;bool txn_abort;bool inited;
             ForestDBLocalContext() :
-                    fdb(NULL), metadb(NULL), metakv(NULL), txn_ref(0), iter_count(0), txn_abort(false), inited(false)
+                    fdb(NULL), metadb(NULL), metakv(NULL), txn_ref(0), iter_count(0), pending_ops(0), pending_bytes(0), pending_since(
+                            0), txn_abort(false), inited(false)
             {
             }
             fdb_kvs_handle* GetKVStore(const Data& ns, bool create_if_missing)
@@ -268,6 +279,51 @@ namespace ardb
             void ReleaseIterRef(ForestDBIterator* iter)
             {
                 iter_count--;
+                TryCommit(false);
+            }
+            int Commit()
+            {
+                fdb_status fs = FDB_RESULT_SUCCESS;
+                CHECK_EXPR(fs = fdb_commit(fdb, FDB_COMMIT_NORMAL));
+                pending_ops = 0;
+                pending_bytes = 0;
+                pending_since = 0;
+                return fs;
+            }
+            /*
+             * Commit pending standalone mutations if a threshold is reached or 'force' is set, a commit is never issued
+             * while an iterator or transaction is open on this handle.
+             */
+            int TryCommit(bool force)
+            {
+                if (0 == pending_ops || iter_count > 0 || txn_ref > 0)
+                {
+                    return 0;
+                }
+                if (!force && g_fdb_commit_interval > 0 && pending_ops < g_fdb_config.wal_threshold
+                        && pending_bytes < (uint64) g_fdb_commit_batch_bytes
+                        && get_current_epoch_millis() - pending_since < (uint64) g_fdb_commit_interval)
+                {
+                    return 0;
+                }
+                return Commit();
+            }
+            int AddPending(size_t bytes)
+            {
+                if (txn_ref > 0)
+                {
+                    /*
+                     * committed by the enclosing transaction
+                     */
+                    return 0;
+                }
+                if (0 == pending_ops)
+                {
+                    pending_since = get_current_epoch_millis();
+                }
+                pending_ops++;
+                pending_bytes += bytes;
+                return TryCommit(false);
             }
             int AcquireTransanction()
             {
@@ -304,6 +360,7 @@ namespace ardb
                         {
                             rc = fdb_end_transaction(fdb, FDB_COMMIT_NORMAL);
                         }
+                        TryCommit(false);
                     }
                 }
                 return rc;
@@ -315,6 +372,10 @@ namespace ardb
             }
             ~ForestDBLocalContext()
             {
+                if (inited)
+                {
+                    TryCommit(true);
+                }
                 KVStoreTable::iterator it = kv_stores.begin();
                 while (it != kv_stores.end())
                 {
@@ -394,6 +455,27 @@ namespace ardb
         conf_get_size(props, "num_compactor_threads", g_fdb_config.num_compactor_threads);
         conf_get_size(props, "num_bgflusher_threads", g_fdb_config.num_bgflusher_threads);
         conf_get_uint8(props, "compaction_threshold", g_fdb_config.compaction_threshold);
+        conf_get_int64(props, "commit_interval_ms", g_fdb_commit_interval);
+        conf_get_int64(props, "commit_batch_size", g_fdb_commit_batch_bytes);
+        std::string durability;
+        conf_get_string(props, "durability", durability);
+        if (!durability.empty())
+        {
+            lower_string(durability);
+            if (durability == "sync")
+            {
+                g_fdb_config.durability_opt = FDB_DRB_NONE;
+            }
+            else if (durability == "async")
+            {
+                g_fdb_config.durability_opt = FDB_DRB_ASYNC;
+            }
+            else
+            {
+                ERROR_LOG("Invalid forestdb durability:%s, only 'sync' or 'async' supported.", durability.c_str());
+                return -1;
+            }
+        }
         ForestDBLocalContext& local_ctx = g_ctx_local.GetValue();
         return local_ctx.Init() ? 0 : -1;
     }
@@ -419,9 +501,9 @@ namespace ardb
         size_t value_len = encode_buffer.ReadableBytes() - key_len;
         fdb_status fs = fdb_set_kv(kv, (const void*) encode_buffer.GetRawBuffer(), key_len, (const void*) (encode_buffer.GetRawBuffer() + key_len), value_len);
         CHECK_EXPR(fs);
-        if (local_ctx.iter_count == 0 && local_ctx.txn_ref == 0)
+        if (0 == fs)
         {
-            fdb_commit(local_ctx.fdb, FDB_COMMIT_NORMAL);
+            local_ctx.AddPending(key_len + value_len);
         }
         return ENGINE_ERR(fs);
     }
@@ -434,9 +516,9 @@ namespace ardb
         }
         ForestDBLocalContext& local_ctx = GetDBLocalContext();
         fdb_status fs = fdb_set_kv(kv, (const void*) key.data(), key.size(), (const void*) value.data(), value.size());
-        if (local_ctx.iter_count == 0 && local_ctx.txn_ref == 0)
+        if (0 == fs)
         {
-            fdb_commit(local_ctx.fdb, FDB_COMMIT_NORMAL);
+            local_ctx.AddPending(key.size() + value.size());
         }
         return ENGINE_ERR(fs);
     }
@@ -488,9 +570,9 @@ namespace ardb
         size_t key_len = encode_buffer.ReadableBytes();
         fdb_status fs = FDB_RESULT_SUCCESS;
         CHECK_EXPR(fs = fdb_del_kv(kv, (const void* ) encode_buffer.GetRawBuffer(), key_len));
-        if (local_ctx.iter_count == 0 && local_ctx.txn_ref == 0)
+        if (0 == fs)
         {
-            CHECK_EXPR(fs = fdb_commit(local_ctx.fdb, FDB_COMMIT_NORMAL));
+            local_ctx.AddPending(key_len);
         }
         return ENGINE_NERR(fs);
     }
@@ -534,6 +616,23 @@ namespace ardb
         ForestDBLocalContext& local_ctx = GetDBLocalContext();
         return local_ctx.TryReleaseTransanction(false);
     }
+    int ForestDBEngine::FlushAll(Context& ctx)
+    {
+        ForestDBLocalContext& local_ctx = GetDBLocalContext();
+        return ENGINE_NERR(local_ctx.TryCommit(true));
+    }
+    int ForestDBEngine::Routine()
+    {
+        /*
+         * called from every io thread's cron and background worker loop, only commit handles this thread already opened.
+         */
+        ForestDBLocalContext& local_ctx = g_ctx_local.GetValue();
+        if (local_ctx.inited)
+        {
+            local_ctx.TryCommit(false);
+        }
+        return 0;
+    }
     int ForestDBEngine::Compact(Context& ctx, const KeyObject& start, const KeyObject& end)
     {
         //ForestDBLocalContext& local_ctx = GetDBLocalContext();
@@ -825,6 +924,10 @@ namespace ardb
         {
             fdb_status fs = fdb_del(m_kv, m_raw);
             CHECK_EXPR(fs);
+            if (0 == fs)
+            {
+                GetDBLocalContext().AddPending(m_raw->keylen);
+            }
         }
     }
 
@@ -836,7 +939,6 @@ namespace ardb
             fdb_iterator_close(m_iter);
         }
         ForestDBLocalContext& local_ctx = GetDBLocalContext();
-        fdb_commit(local_ctx.fdb, FDB_COMMIT_NORMAL);
         local_ctx.ReleaseIterRef(this);
     }
 }
@@ -149,6 +149,8 @@ namespace ardb
                 features.support_compactfilter = 0;
                 features.support_namespace = 0;
                 features.support_merge = 0;
+                features.support_range_compact = 1;
+                features.support_concurrent_iterator = 1;
                 return features;
             }
             int MaxOpenFiles();
@@ -33,8 +33,11 @@
 #include "db/db_utils.hpp"
 #include "util/helpers.hpp"
 #include "thread/lock_guard.hpp"
+#include "util/atomic.hpp"
+#include "util/file_helper.hpp"
 #include <string.h>
 #include <unistd.h>
+#include <deque>
 
 #define CHECK_RET(expr, fail)  do{\
     int __rc__ = expr; \
@@ -73,6 +76,59 @@ namespace ardb
     static bool g_bgwriter_running = true;
     static ThreadMutex g_bgwriters_mutex;
     static std::vector<BGWriteThread*> g_bgwriters;
+    /*
+     * bumped after every write commit(and every new DBI), cached read transactions older than it are renewed.
+     */
+    static volatile uint64_t g_write_generation = 0;
+    static volatile uint64_t g_dbi_generation = 0;
+
+    /*
+     * Every write transaction holds g_write_gate(shared), every operation touching the env holds g_env_gate(shared),
+     * always in that order. Growing the map or swapping in a compacted copy takes them exclusively, which is the point
+     * where no transaction is active in this process.
+     */
+    static SpinRWLock g_write_gate;
+    static SpinRWLock g_env_gate;
+    static int64 g_mapsize = 0;
+    static int64 g_mapsize_grow_step = 0;
+    static int64 g_mapsize_grow_watermark = 80;
+    static volatile uint32_t g_mapsize_grow_pending = 0;
+
+    static void check_map_usage()
+    {
+        if (NULL == g_mdb_env || g_mapsize_grow_step <= 0)
+        {
+            return;
+        }
+        MDB_envinfo info;
+        MDB_stat stat;
+        if (0 != mdb_env_info(g_mdb_env, &info) || 0 != mdb_env_stat(g_mdb_env, &stat))
+        {
+            return;
+        }
+        uint64 used = (uint64) (info.me_last_pgno + 1) * stat.ms_psize;
+        if (used * 100 >= (uint64) info.me_mapsize * g_mapsize_grow_watermark)
+        {
+            g_mapsize_grow_pending = 1;
+        }
+    }
+    static inline int check_map_full(int rc)
+    {
+        if (MDB_MAP_FULL == rc && g_mapsize_grow_step > 0)
+        {
+            g_mapsize_grow_pending = 1;
+        }
+        return rc;
+    }
+    static inline uint64_t write_committed()
+    {
+        uint64_t gen = atomic_add_uint64(&g_write_generation, 1);
+        if (0 == (gen & 63))
+        {
+            check_map_usage();
+        }
+        return gen;
+    }
 
     struct WriteOperation
     {
@@ -101,8 +157,13 @@ namespace ardb
                 {
                     if (NULL == txn)
                     {
+                        g_write_gate.Lock(READ_LOCK);
+                        g_env_gate.Lock(READ_LOCK);
                         if (NULL == g_mdb_env || 0 != mdb_txn_begin(g_mdb_env, NULL, 0, &txn))
                         {
+                            txn = NULL;
+                            g_env_gate.Unlock(READ_LOCK);
+                            g_write_gate.Unlock(READ_LOCK);
                             Thread::Sleep(10, MILLIS);
                             continue;
                         }
@@ -137,8 +198,11 @@ namespace ardb
                             }
                             case LMDB_CKP_OP:
                             {
-                                CHECK_EXPR(mdb_txn_commit(txn));
+                                CHECK_EXPR(check_map_full(mdb_txn_commit(txn)));
+                                write_committed();
                                 txn = NULL;
+                                g_env_gate.Unlock(READ_LOCK);
+                                g_write_gate.Unlock(READ_LOCK);
                                 event_cond.Notify();
                                 DELETE(op);
                                 break;
@@ -158,8 +222,11 @@ namespace ardb
                     {
                         if (NULL != txn)
                         {
-                            CHECK_EXPR(mdb_txn_commit(txn));
+                            CHECK_EXPR(check_map_full(mdb_txn_commit(txn)));
+                            write_committed();
                             txn = NULL;
+                            g_env_gate.Unlock(READ_LOCK);
+                            g_write_gate.Unlock(READ_LOCK);
                         }
                         queue_cond.Lock();
                         queue_cond.Wait(5);
@@ -209,6 +276,11 @@ namespace ardb
             }
     };
 
+    struct LMDBLocalContext;
+    static ThreadMutex g_local_ctxs_mutex;
+    static std::vector<LMDBLocalContext*> g_local_ctxs;
+    static void grow_map_size();
+
     struct LMDBLocalContext
     {
             MDB_txn *txn;
@@ -223,10 +295,190 @@ namespace ardb
              */
             std::vector<WriteOperation*> delayed_write_ops;
             BGWriteThread bgwriter;
+
+            /*
+             * recycled read-only transaction(mdb_txn_reset/mdb_txn_renew) used by point lookups outside write transactions.
+             * It is reset after each read and renewed by the next one, with 'read_staleness_ms' > 0 it is kept for reuse while
+             * no write of this thread committed after it was taken, for at most that window.
+             */
+            MDB_txn* read_txn;
+            bool read_txn_active;
+            uint64_t read_txn_gen;
+            uint64_t read_txn_dbi_gen;
+            uint64 read_txn_stamp;
+            uint64_t local_write_gen;
+            /*
+             * cursors released by iterators, reused by later Find calls within the same write transaction.
+             */
+            typedef std::vector<std::pair<MDB_dbi, MDB_cursor*> > CursorCache;
+            CursorCache cursor_cache;
+            /*
+             * recursion counters of g_write_gate/g_env_gate held by this thread.
+             */
+            uint32 write_hold;
+            uint32 env_hold;
             LMDBLocalContext() :
-                    txn(NULL), txn_ref(0), iter_ref(0), txn_abort(false), write_dispatched(false)
+                    txn(NULL), txn_ref(0), iter_ref(0), txn_abort(false), write_dispatched(false), read_txn(NULL), read_txn_active(
+                    false), read_txn_gen(0), read_txn_dbi_gen(0), read_txn_stamp(0), local_write_gen(0), write_hold(0), env_hold(0)
             //, iter_txn(NULL),iter_txn_ref(0)
             {
+                LockGuard<ThreadMutex> guard(g_local_ctxs_mutex);
+                g_local_ctxs.push_back(this);
+            }
+            void HoldWrite()
+            {
+                if (0 == write_hold++)
+                {
+                    g_write_gate.Lock(READ_LOCK);
+                }
+            }
+            void UnholdWrite()
+            {
+                if (0 == --write_hold)
+                {
+                    g_write_gate.Unlock(READ_LOCK);
+                }
+            }
+            void HoldEnv()
+            {
+                if (0 == env_hold++)
+                {
+                    g_env_gate.Lock(READ_LOCK);
+                }
+            }
+            void UnholdEnv()
+            {
+                if (0 == --env_hold)
+                {
+                    g_env_gate.Unlock(READ_LOCK);
+                }
+            }
+            /*
+             * nothing held by this thread, a pending map growth can run here.
+             */
+            void SafePoint()
+            {
+                if (0 == write_hold && 0 == env_hold && g_mapsize_grow_pending)
+                {
+                    grow_map_size();
+                }
+            }
+            /*
+             * called by the exclusive gate holder only, the owner thread can not touch its read transaction meanwhile.
+             */
+            void SuspendReadTransaction(bool close)
+            {
+                if (NULL == read_txn)
+                {
+                    return;
+                }
+                if (close)
+                {
+                    mdb_txn_abort(read_txn);
+                    read_txn = NULL;
+                }
+                else if (read_txn_active)
+                {
+                    mdb_txn_reset(read_txn);
+                }
+                read_txn_active = false;
+            }
+            void LocalWriteCommitted()
+            {
+                local_write_gen = write_committed();
+            }
+            void LocalWriteCommitted(uint64_t gen)
+            {
+                if (gen > local_write_gen)
+                {
+                    local_write_gen = gen;
+                }
+            }
+            /*
+             * Called after each read outside write transactions. The snapshot is released right away so an idle thread
+             * does not keep old pages from being reused, unless staleness is allowed, then it is kept for reuse and
+             * released by Routine once it is older than the window.
+             */
+            void ReleaseReadTransaction(int64 staleness_ms)
+            {
+                if (NULL == read_txn || !read_txn_active)
+                {
+                    return;
+                }
+                if (staleness_ms <= 0 || get_current_epoch_micros() - read_txn_stamp >= (uint64) staleness_ms * 1000)
+                {
+                    mdb_txn_reset(read_txn);
+                    read_txn_active = false;
+                }
+            }
+            int AcquireReadTransaction(int64 staleness_ms, MDB_txn*& txn)
+            {
+                uint64_t gen = g_write_generation;
+                uint64_t dbi_gen = g_dbi_generation;
+                if (NULL != read_txn && read_txn_active)
+                {
+                    if (read_txn_gen == gen)
+                    {
+                        txn = read_txn;
+                        return 0;
+                    }
+                    if (staleness_ms > 0 && read_txn_dbi_gen == dbi_gen && local_write_gen <= read_txn_gen
+                            && get_current_epoch_micros() - read_txn_stamp < (uint64) staleness_ms * 1000)
+                    {
+                        txn = read_txn;
+                        return 0;
+                    }
+                    mdb_txn_reset(read_txn);
+                    read_txn_active = false;
+                }
+                if (NULL != read_txn)
+                {
+                    int rc = mdb_txn_renew(read_txn);
+                    if (0 != rc)
+                    {
+                        WARN_LOG("Failed to renew read transaction for reason:%s", mdb_strerror(rc));
+                        mdb_txn_abort(read_txn);
+                        read_txn = NULL;
+                    }
+                }
+                if (NULL == read_txn)
+                {
+                    int rc = mdb_txn_begin(g_mdb_env, NULL, MDB_RDONLY, &read_txn);
+                    if (0 != rc)
+                    {
+                        ERROR_LOG("Failed to create read transaction for reason:%s", mdb_strerror(rc));
+                        read_txn = NULL;
+                        return rc;
+                    }
+                }
+                read_txn_active = true;
+                read_txn_gen = gen;
+                read_txn_dbi_gen = dbi_gen;
+                read_txn_stamp = get_current_epoch_micros();
+                txn = read_txn;
+                return 0;
+            }
+            MDB_cursor* TakeCachedCursor(MDB_dbi dbi)
+            {
+                for (size_t i = 0; i < cursor_cache.size(); i++)
+                {
+                    if (cursor_cache[i].first == dbi)
+                    {
+                        MDB_cursor* cursor = cursor_cache[i].second;
+                        cursor_cache[i] = cursor_cache.back();
+                        cursor_cache.pop_back();
+                        return cursor;
+                    }
+                }
+                return NULL;
+            }
+            void CloseCachedCursors()
+            {
+                for (size_t i = 0; i < cursor_cache.size(); i++)
+                {
+                    mdb_cursor_close(cursor_cache[i].second);
+                }
+                cursor_cache.clear();
             }
             BGWriteThread& GetBGWriter()
             {
@@ -248,7 +500,15 @@ namespace ardb
                 int rc = 0;
                 if (NULL == txn)
                 {
+                    HoldWrite();
+                    HoldEnv();
                     rc = mdb_txn_begin(g_mdb_env, NULL, 0, &txn);
+                    if (0 != rc)
+                    {
+                        txn = NULL;
+                        UnholdEnv();
+                        UnholdWrite();
+                    }
                     txn_abort = false;
                     txn_ref = 0;
                     iter_ref = 0;
@@ -277,16 +537,26 @@ namespace ardb
                     }
                     if (txn_ref == 0)
                     {
+                        CloseCachedCursors();
                         if (txn_abort)
                         {
                             mdb_txn_abort(txn);
                         }
                         else
                         {
-                            rc = mdb_txn_commit(txn);
+                            rc = check_map_full(mdb_txn_commit(txn));
+                            if (0 == rc)
+                            {
+                                LocalWriteCommitted();
+                            }
                         }
                         txn = NULL;
+                        UnholdEnv();
+                        UnholdWrite();
 
+                        /*
+                         * gates released first, the background writer needs them to finish.
+                         */
                         if (write_dispatched)
                         {
                             GetBGWriter().WaitWriteComplete();
@@ -298,6 +568,7 @@ namespace ardb
                 {
                     iter_ref--;
                 }
+                SafePoint();
                 return rc;
             }
             Buffer& GetEncodeBuferCache()
@@ -307,12 +578,237 @@ namespace ardb
             }
             ~LMDBLocalContext()
             {
+                LockGuard<ThreadMutex> guard(g_local_ctxs_mutex);
+                std::vector<LMDBLocalContext*>::iterator found = std::find(g_local_ctxs.begin(), g_local_ctxs.end(), this);
+                if (found != g_local_ctxs.end())
+                {
+                    g_local_ctxs.erase(found);
+                }
             }
     };
     static ThreadLocal<LMDBLocalContext> g_ctx_local;
 
+    static void suspend_read_transactions(bool close)
+    {
+        LockGuard<ThreadMutex> guard(g_local_ctxs_mutex);
+        for (size_t i = 0; i < g_local_ctxs.size(); i++)
+        {
+            g_local_ctxs[i]->SuspendReadTransaction(close);
+        }
+    }
+
+    /*
+     * mdb_env_set_mapsize requires that no transaction is active in the process, so writers and readers are paused by
+     * the exclusive gates and the cached read transactions are reset(renewed by their threads on next use).
+     */
+    static void grow_map_size()
+    {
+        g_write_gate.Lock(WRITE_LOCK);
+        g_env_gate.Lock(WRITE_LOCK);
+        if (g_mapsize_grow_pending && NULL != g_mdb_env)
+        {
+            suspend_read_transactions(false);
+            MDB_envinfo info;
+            MDB_stat stat;
+            mdb_env_info(g_mdb_env, &info);
+            mdb_env_stat(g_mdb_env, &stat);
+            uint64 used = (uint64) (info.me_last_pgno + 1) * stat.ms_psize;
+            uint64 page_size = sysconf(_SC_PAGE_SIZE);
+            uint64 new_size = info.me_mapsize;
+            do
+            {
+                new_size += g_mapsize_grow_step;
+            }
+            while (used * 100 >= new_size * g_mapsize_grow_watermark);
+            new_size = (new_size / page_size) * page_size;
+            int rc = mdb_env_set_mapsize(g_mdb_env, new_size);
+            if (0 == rc)
+            {
+                g_mapsize = new_size;
+                INFO_LOG("Grow lmdb map size from %llu to %llu with %llu bytes used.", (unsigned long long) info.me_mapsize,
+                        (unsigned long long) new_size, (unsigned long long) used);
+            }
+            else
+            {
+                ERROR_LOG("Failed to grow lmdb map size to %llu for reason:%s", (unsigned long long) new_size, mdb_strerror(rc));
+            }
+            g_mapsize_grow_pending = 0;
+        }
+        g_env_gate.Unlock(WRITE_LOCK);
+        g_write_gate.Unlock(WRITE_LOCK);
+    }
+
+    /*
+     * holds the gates for the duration of one engine operation.
+     */
+    class LMDBEnvGuard
+    {
+        private:
+            LMDBLocalContext& m_ctx;
+            bool m_write;
+        public:
+            LMDBEnvGuard(LMDBLocalContext& ctx, bool write) :
+                    m_ctx(ctx), m_write(write)
+            {
+                if (m_write)
+                {
+                    m_ctx.HoldWrite();
+                }
+                m_ctx.HoldEnv();
+            }
+            ~LMDBEnvGuard()
+            {
+                m_ctx.UnholdEnv();
+                if (m_write)
+                {
+                    m_ctx.UnholdWrite();
+                }
+                m_ctx.SafePoint();
+            }
+    };
+
+    struct GroupWriteOperation
+    {
+            MDB_dbi dbi;
+            uint8 type;
+            MDB_val key;
+            MDB_val value;
+            int err;
+            bool done;
+            uint64_t commit_gen;
+            GroupWriteOperation(uint8 t, MDB_dbi d, const MDB_val& k) :
+                    dbi(d), type(t), key(k), err(0), done(false), commit_gen(0)
+            {
+                value.mv_data = NULL;
+                value.mv_size = 0;
+            }
+    };
+
+    /*
+     * LMDB allows only one writer at a time, so standalone writes(not inside a write batch and without open iterators)
+     * are group committed: writers enqueue their encoded operation and block, the writer at the head of the queue
+     * becomes the leader, applies all pending operations(at most 'max_batch') in one write transaction, commits once
+     * and releases every writer of the group with its own result.
+     */
+    class LMDBGroupCommitter
+    {
+        private:
+            ThreadMutexLock m_lock;
+            std::deque<GroupWriteOperation*> m_queue;
+            size_t m_max_batch;
+            int Apply(MDB_txn* txn, GroupWriteOperation* op)
+            {
+                if (LMDB_PUT_OP == op->type)
+                {
+                    return mdb_put(txn, op->dbi, &op->key, &op->value, 0);
+                }
+                return mdb_del(txn, op->dbi, &op->key, NULL);
+            }
+        public:
+            LMDBGroupCommitter() :
+                    m_max_batch(1024)
+            {
+            }
+            void SetMaxBatch(int64 n)
+            {
+                m_max_batch = n > 0 ? n : 1;
+            }
+            int Write(GroupWriteOperation& op)
+            {
+                m_lock.Lock();
+                m_queue.push_back(&op);
+                while (!op.done && m_queue.front() != &op)
+                {
+                    m_lock.Wait();
+                }
+                if (op.done)
+                {
+                    m_lock.Unlock();
+                    /*
+                     * a follower sees its own write even with read_staleness_ms > 0
+                     */
+                    g_ctx_local.GetValue().LocalWriteCommitted(op.commit_gen);
+                    return op.err;
+                }
+                size_t batch_size = m_queue.size() < m_max_batch ? m_queue.size() : m_max_batch;
+                std::vector<GroupWriteOperation*> batch(m_queue.begin(), m_queue.begin() + batch_size);
+                m_lock.Unlock();
+
+                /*
+                 * the queue is unlocked while the leader writes, later writers line up for the next group.
+                 */
+                MDB_txn* txn = NULL;
+                int rc = mdb_txn_begin(g_mdb_env, NULL, 0, &txn);
+                for (size_t i = 0; 0 == rc && i < batch.size(); i++)
+                {
+                    int err = Apply(txn, batch[i]);
+                    if (MDB_NOTFOUND == err)
+                    {
+                        batch[i]->err = err;
+                    }
+                    else if (0 != err)
+                    {
+                        rc = err;
+                    }
+                }
+                if (0 == rc)
+                {
+                    rc = mdb_txn_commit(txn);
+                }
+                else if (NULL != txn)
+                {
+                    mdb_txn_abort(txn);
+                }
+                check_map_full(rc);
+                uint64_t commit_gen = 0;
+                if (0 != rc)
+                {
+                    ERROR_LOG("Failed to group commit %u writes for reason:%s", (uint32) batch.size(), mdb_strerror(rc));
+                }
+                else
+                {
+                    commit_gen = write_committed();
+                    g_ctx_local.GetValue().LocalWriteCommitted(commit_gen);
+                }
+
+                m_lock.Lock();
+                for (size_t i = 0; i < batch.size(); i++)
+                {
+                    if (0 != rc)
+                    {
+                        batch[i]->err = rc;
+                    }
+                    batch[i]->commit_gen = commit_gen;
+                    batch[i]->done = true;
+                }
+                m_queue.erase(m_queue.begin(), m_queue.begin() + batch_size);
+                m_lock.NotifyAll();
+                m_lock.Unlock();
+                return op.err;
+            }
+    };
+    static LMDBGroupCommitter g_group_committer;
+
+    struct DBIOpenOrder
+    {
+            const TreeMap<Data, MDB_dbi>::Type& prev;
+            DBIOpenOrder(const TreeMap<Data, MDB_dbi>::Type& p) :
+                    prev(p)
+            {
+            }
+            MDB_dbi Handle(const Data& ns) const
+            {
+                TreeMap<Data, MDB_dbi>::Type::const_iterator found = prev.find(ns);
+                return found != prev.end() ? found->second : (MDB_dbi) -1;
+            }
+            bool operator()(const Data& a, const Data& b) const
+            {
+                return Handle(a) < Handle(b);
+            }
+    };
+
     LMDBEngine::LMDBEngine() :
-            m_env(NULL), m_meta_dbi(0)
+            m_env(NULL), m_meta_dbi(0), m_compacting(0)
     {
     }
 
@@ -327,6 +823,8 @@ namespace ardb
 
     bool LMDBEngine::GetDBI(Context& ctx, const Data& ns, bool create_if_noexist, MDB_dbi& dbi)
     {
+        LMDBLocalContext& local_ctx = g_ctx_local.GetValue();
+        LMDBEnvGuard env_guard(local_ctx, create_if_noexist);
         RWLockGuard<SpinRWLock> guard(m_lock, !ctx.flags.create_if_notexist);
         DBITable::iterator found = m_dbis.find(ns);
         if (found != m_dbis.end())
@@ -338,7 +836,6 @@ namespace ardb
         {
             return false;
         }
-        LMDBLocalContext& local_ctx = g_ctx_local.GetValue();
         bool recreate_local_txn = false;
         MDB_txn *txn = local_ctx.txn;
         if (NULL == txn)
@@ -369,6 +866,8 @@ namespace ardb
         if (success)
         {
             m_dbis[ns] = dbi;
+            atomic_add_uint64(&g_dbi_generation, 1);
+            local_ctx.LocalWriteCommitted();
         }
 
         if (recreate_local_txn)
@@ -404,14 +903,23 @@ namespace ardb
         mdb_env_create(&m_env);
         mdb_env_set_maxdbs(m_env, cfg.max_dbs);
         int page_size = sysconf(_SC_PAGE_SIZE);
-        int rc = mdb_env_set_mapsize(m_env, (cfg.max_dbsize / page_size) * page_size);
+        int64 mapsize = cfg.max_dbsize > g_mapsize ? cfg.max_dbsize : g_mapsize;
+        int rc = mdb_env_set_mapsize(m_env, (mapsize / page_size) * page_size);
         if (rc != MDB_SUCCESS)
         {
             ERROR_LOG("Invalid db size:%llu for reason:%s", cfg.max_dbsize, mdb_strerror(rc));
             return -1;
         }
         g_mdb_env = m_env;
-        int env_opt = MDB_NOSYNC | MDB_NOMETASYNC | MDB_WRITEMAP | MDB_MAPASYNC;
+        g_mapsize = (mapsize / page_size) * page_size;
+        g_mapsize_grow_step = cfg.mapsize_grow_step;
+        g_mapsize_grow_watermark = cfg.mapsize_grow_watermark;
+        g_group_committer.SetMaxBatch(cfg.batch_commit_watermark);
+        /*
+         * MDB_NOTLS: reader slots belong to the transaction instead of the thread, so a thread can keep its cached
+         * read transaction(see LMDBLocalContext::AcquireReadTransaction) while it opens write transactions.
+         */
+        int env_opt = MDB_NOSYNC | MDB_NOMETASYNC | MDB_WRITEMAP | MDB_MAPASYNC | MDB_NOTLS;
         if (!cfg.readahead)
         {
             env_opt |= MDB_NORDAHEAD;
@@ -438,6 +946,7 @@ namespace ardb
             ERROR_LOG("Failed to create meta cursor for reason:%s", mdb_strerror(rc));
             return -1;
         }
+        DataArray nss;
         do
         {
             MDB_val key, val;
@@ -450,18 +959,7 @@ namespace ardb
                 {
                     Data ns;
                     ns.SetString((const char*) val.mv_data, val.mv_size, true);
-                    MDB_dbi tmp;
-                    //GetDBI(init_ctx, ns, false, tmp);
-                    rc = mdb_open(local_ctx.txn, ns.AsString().c_str(), 0, &tmp);
-                    if (0 == rc)
-                    {
-                        m_dbis[ns] = tmp;
-                        INFO_LOG("Open db:%s success.", ns.AsString().c_str());
-                    }
-                    else
-                    {
-                        ERROR_LOG("Failed to open db:%s with reason:%s", ns.AsString().c_str(), mdb_strerror(rc));
-                    }
+                    nss.push_back(ns);
                 }
             }
             else
@@ -470,6 +968,35 @@ namespace ardb
             }
         }
         while (rc == 0);
+        mdb_cursor_close(cursor);
+
+        /*
+         * dbi handles are assigned in open order, reopening(after compaction) in the previous handle order keeps
+         * every handle unchanged for in-flight background writes.
+         */
+        DBITable prev_dbis = m_dbis;
+        m_dbis.clear();
+        std::stable_sort(nss.begin(), nss.end(), DBIOpenOrder(prev_dbis));
+        for (size_t i = 0; i < nss.size(); i++)
+        {
+            const Data& ns = nss[i];
+            MDB_dbi tmp;
+            rc = mdb_open(local_ctx.txn, ns.AsString().c_str(), 0, &tmp);
+            if (0 == rc)
+            {
+                m_dbis[ns] = tmp;
+                DBITable::iterator found = prev_dbis.find(ns);
+                if (found != prev_dbis.end() && found->second != tmp)
+                {
+                    ERROR_LOG("DB:%s reopened with handle:%u instead of %u", ns.AsString().c_str(), tmp, found->second);
+                }
+                INFO_LOG("Open db:%s success.", ns.AsString().c_str());
+            }
+            else
+            {
+                ERROR_LOG("Failed to open db:%s with reason:%s", ns.AsString().c_str(), mdb_strerror(rc));
+            }
+        }
         mdb_txn_commit(local_ctx.txn);
         local_ctx.txn = NULL;
         INFO_LOG("Success to open lmdb at %s", m_dbdir.c_str());
@@ -485,6 +1012,15 @@ namespace ardb
         conf_get_int64(props, "database_maxsize", cfg.max_dbsize);
         conf_get_int64(props, "database_maxdbs", cfg.max_dbs);
         conf_get_bool(props, "readahead", cfg.readahead);
+        conf_get_bool(props, "group_commit", cfg.group_commit);
+        conf_get_int64(props, "batch_commit_watermark", cfg.batch_commit_watermark);
+        conf_get_int64(props, "read_staleness_ms", cfg.read_staleness_ms);
+        conf_get_int64(props, "database_growsize", cfg.mapsize_grow_step);
+        conf_get_int64(props, "database_grow_watermark", cfg.mapsize_grow_watermark);
+        if (cfg.mapsize_grow_watermark <= 0 || cfg.mapsize_grow_watermark > 100)
+        {
+            cfg.mapsize_grow_watermark = 80;
+        }
 
         m_dbdir = dir;
         return Reopen(cfg);
@@ -498,12 +1034,13 @@ namespace ardb
 
     int LMDBEngine::Put(Context& ctx, const KeyObject& key, const ValueObject& value)
     {
+        LMDBLocalContext& local_ctx = g_ctx_local.GetValue();
+        LMDBEnvGuard guard(local_ctx, true);
         MDB_dbi dbi;
         if (!GetDBI(ctx, key.GetNameSpace(), ctx.flags.create_if_notexist, dbi))
         {
             return ERR_ENTRY_NOT_EXIST;
         }
-        LMDBLocalContext& local_ctx = g_ctx_local.GetValue();
         Buffer& encode_buffer = local_ctx.GetEncodeBuferCache();
         key.Encode(encode_buffer);
         size_t key_len = encode_buffer.ReadableBytes();
@@ -525,23 +1062,29 @@ namespace ardb
             local_ctx.GetBGWriter().Put(dbi, k, v);
             return 0;
         }
+        if (m_cfg.group_commit && NULL == local_ctx.txn)
+        {
+            GroupWriteOperation op(LMDB_PUT_OP, dbi, k);
+            op.value = v;
+            return ENGINE_ERR(g_group_committer.Write(op));
+        }
         int err = local_ctx.AcquireTransanction(false);
         if (0 == err)
         {
-            err = mdb_put(local_ctx.txn, dbi, &k, &v, 0);
+            err = check_map_full(mdb_put(local_ctx.txn, dbi, &k, &v, 0));
             local_ctx.TryReleaseTransanction(err == 0, false);
         }
         return ENGINE_ERR(err);
     }
     int LMDBEngine::PutRaw(Context& ctx, const Data& ns, const Slice& key, const Slice& value)
     {
+        LMDBLocalContext& local_ctx = g_ctx_local.GetValue();
+        LMDBEnvGuard guard(local_ctx, true);
         MDB_dbi dbi;
         if (!GetDBI(ctx, ns, ctx.flags.create_if_notexist, dbi))
         {
             return ERR_ENTRY_NOT_EXIST;
         }
-
-        LMDBLocalContext& local_ctx = g_ctx_local.GetValue();
         MDB_val k, v;
         k.mv_data = const_cast<char*>(key.data());
         k.mv_size = key.size();
@@ -553,10 +1096,16 @@ namespace ardb
             local_ctx.GetBGWriter().Put(dbi, k, v);
             return 0;
         }
+        if (m_cfg.group_commit && NULL == local_ctx.txn)
+        {
+            GroupWriteOperation op(LMDB_PUT_OP, dbi, k);
+            op.value = v;
+            return ENGINE_ERR(g_group_committer.Write(op));
+        }
         int err = local_ctx.AcquireTransanction(false);
         if (0 == err)
         {
-            err = mdb_put(local_ctx.txn, dbi, &k, &v, 0);
+            err = check_map_full(mdb_put(local_ctx.txn, dbi, &k, &v, 0));
             local_ctx.TryReleaseTransanction(err == 0, false);
         }
         return ENGINE_ERR(err);
@@ -564,12 +1113,13 @@ namespace ardb
 
     int LMDBEngine::Get(Context& ctx, const KeyObject& key, ValueObject& value)
     {
+        LMDBLocalContext& local_ctx = g_ctx_local.GetValue();
+        LMDBEnvGuard guard(local_ctx, false);
         MDB_dbi dbi;
         if (!GetDBI(ctx, key.GetNameSpace(), false, dbi))
         {
             return ERR_ENTRY_NOT_EXIST;
         }
-        LMDBLocalContext& local_ctx = g_ctx_local.GetValue();
         Buffer& encode_buffer = local_ctx.GetEncodeBuferCache();
         key.Encode(encode_buffer);
         size_t key_len = encode_buffer.ReadableBytes();
@@ -580,7 +1130,7 @@ namespace ardb
         int rc = 0;
         if (NULL == txn)
         {
-            rc = mdb_txn_begin(m_env, NULL, MDB_RDONLY, &txn);
+            rc = local_ctx.AcquireReadTransaction(m_cfg.read_staleness_ms, txn);
         }
         if (0 == rc)
         {
@@ -590,9 +1140,9 @@ namespace ardb
                 Buffer valBuffer((char*) (v.mv_data), 0, v.mv_size);
                 value.Decode(valBuffer, true);
             }
-            if (NULL == local_ctx.txn)
+            if (txn != local_ctx.txn)
             {
-                mdb_txn_commit(txn);
+                local_ctx.ReleaseReadTransaction(m_cfg.read_staleness_ms);
             }
         }
         return ENGINE_ERR(rc);
@@ -600,6 +1150,8 @@ namespace ardb
 
     int LMDBEngine::MultiGet(Context& ctx, const KeyObjectArray& keys, ValueObjectArray& values, ErrCodeArray& errs)
     {
+        LMDBLocalContext& local_ctx = g_ctx_local.GetValue();
+        LMDBEnvGuard guard(local_ctx, false);
         MDB_dbi dbi;
         values.resize(keys.size());
         if (!GetDBI(ctx, ctx.ns, false, dbi))
@@ -607,7 +1159,6 @@ namespace ardb
             errs.assign(keys.size(), ERR_ENTRY_NOT_EXIST);
             return 0;
         }
-        LMDBLocalContext& local_ctx = g_ctx_local.GetValue();
         Buffer& key_encode_buffers = local_ctx.GetEncodeBuferCache();
         std::vector<size_t> positions;
         std::vector<MDB_val> ks;
@@ -630,39 +1181,42 @@ namespace ardb
         int rc = 0;
         if (NULL == txn)
         {
-            rc = mdb_txn_begin(m_env, NULL, MDB_RDONLY, &txn);
+            rc = local_ctx.AcquireReadTransaction(m_cfg.read_staleness_ms, txn);
         }
-        if (0 == rc)
+        if (0 != rc)
+        {
+            errs.assign(keys.size(), ENGINE_ERR(rc));
+            return ENGINE_ERR(rc);
+        }
+        for (size_t i = 0; i < keys.size(); i++)
         {
-            for (size_t i = 0; i < keys.size(); i++)
+            MDB_val v;
+            rc = mdb_get(txn, dbi, &ks[i], &v);
+            if (0 == rc)
             {
-                MDB_val v;
-                rc = mdb_get(txn, dbi, &ks[i], &v);
-                if (0 == rc)
-                {
-                    Buffer valBuffer((char*) (v.mv_data), 0, v.mv_size);
-                    values[i].Decode(valBuffer, true);
-                }
-                else
-                {
-                    errs[i] = ENGINE_ERR(rc);
-                }
+                Buffer valBuffer((char*) (v.mv_data), 0, v.mv_size);
+                values[i].Decode(valBuffer, true);
             }
-            if (NULL == local_ctx.txn)
+            else
             {
-                mdb_txn_commit(txn);
+                errs[i] = ENGINE_ERR(rc);
             }
         }
+        if (txn != local_ctx.txn)
+        {
+            local_ctx.ReleaseReadTransaction(m_cfg.read_staleness_ms);
+        }
         return ENGINE_NERR(rc);
     }
     int LMDBEngine::Del(Context& ctx, const KeyObject& key)
     {
+        LMDBLocalContext& local_ctx = g_ctx_local.GetValue();
+        LMDBEnvGuard guard(local_ctx, true);
         MDB_dbi dbi;
         if (!GetDBI(ctx, key.GetNameSpace(), false, dbi))
         {
             return ERR_ENTRY_NOT_EXIST;
         }
-        LMDBLocalContext& local_ctx = g_ctx_local.GetValue();
         Buffer& encode_buffer = local_ctx.GetEncodeBuferCache();
         key.Encode(encode_buffer);
         size_t key_len = encode_buffer.ReadableBytes();
@@ -676,6 +1230,11 @@ namespace ardb
             local_ctx.GetBGWriter().Del(dbi, k);
             return 0;
         }
+        if (m_cfg.group_commit && NULL == local_ctx.txn)
+        {
+            GroupWriteOperation op(LMDB_DEL_OP, dbi, k);
+            return ENGINE_NERR(g_group_committer.Write(op));
+        }
         rc = local_ctx.AcquireTransanction(false);
         if (0 == rc)
         {
@@ -690,6 +1249,64 @@ namespace ardb
         return rc;
     }
 
+    int LMDBEngine::DelRange(Context& ctx, const KeyObject& start, const KeyObject& end)
+    {
+        LMDBLocalContext& local_ctx = g_ctx_local.GetValue();
+        LMDBEnvGuard guard(local_ctx, true);
+        MDB_dbi dbi;
+        if (!GetDBI(ctx, start.GetNameSpace(), false, dbi))
+        {
+            return ERR_ENTRY_NOT_EXIST;
+        }
+        /*
+         * range deletion can not be dispatched to background writer, let caller fallback to iterator deletion.
+         */
+        if (local_ctx.iter_ref > 0)
+        {
+            return ERR_NOTSUPPORTED;
+        }
+        Buffer& encode_buffer = local_ctx.GetEncodeBuferCache();
+        start.Encode(encode_buffer);
+        size_t start_len = encode_buffer.ReadableBytes();
+        end.Encode(encode_buffer);
+        size_t end_len = encode_buffer.ReadableBytes() - start_len;
+        MDB_val start_key, end_key;
+        start_key.mv_data = const_cast<char*>(encode_buffer.GetRawBuffer());
+        start_key.mv_size = start_len;
+        end_key.mv_data = const_cast<char*>(encode_buffer.GetRawBuffer() + start_len);
+        end_key.mv_size = end_len;
+
+        int rc = local_ctx.AcquireTransanction(false);
+        if (0 != rc)
+        {
+            return ENGINE_ERR(rc);
+        }
+        /*
+         * delete the whole range with one cursor in one write transaction, freed pages go back to
+         * lmdb's freelist at commit.
+         */
+        MDB_cursor* cursor = NULL;
+        rc = mdb_cursor_open(local_ctx.txn, dbi, &cursor);
+        if (0 == rc)
+        {
+            MDB_val k, v;
+            k = start_key;
+            rc = mdb_cursor_get(cursor, &k, &v, MDB_SET_RANGE);
+            while (0 == rc && LMDBCompareFunc(&k, &end_key) < 0)
+            {
+                rc = mdb_cursor_del(cursor, 0);
+                if (0 == rc)
+                {
+                    rc = mdb_cursor_get(cursor, &k, &v, MDB_NEXT);
+                }
+            }
+            mdb_cursor_close(cursor);
+        }
+        rc = ENGINE_NERR(rc);
+        local_ctx.TryReleaseTransanction(0 == rc, false);
+        return rc;
+    }
+
     int LMDBEngine::Merge(Context& ctx, const KeyObject& key, uint16_t op, const DataArray& args)
     {
         ValueObject current;
@@ -718,18 +1335,141 @@ namespace ardb
     int LMDBEngine::Backup(Context& ctx, const std::string& dir)
     {
         LockGuard<ThreadMutex> guard(m_backup_lock);
+        LMDBEnvGuard env_guard(g_ctx_local.GetValue(), false);
         int err = mdb_env_copy(m_env, dir.c_str());
         return ENGINE_ERR(err);
     }
     int LMDBEngine::Restore(Context& ctx, const std::string& dir)
     {
         LockGuard<ThreadMutex> guard(m_backup_lock);
+        g_write_gate.Lock(WRITE_LOCK);
+        g_env_gate.Lock(WRITE_LOCK);
+        suspend_read_transactions(true);
         Close();
         dir_copy(dir, m_dbdir);
         Reopen(m_cfg);
+        g_env_gate.Unlock(WRITE_LOCK);
+        g_write_gate.Unlock(WRITE_LOCK);
         return 0;
     }
 
+    /*
+     * Copy the env with MDB_CP_COMPACT(free pages dropped, btrees rewritten in order) into a sibling directory, then
+     * swap the data file in with one rename while the env is closed. The first copies run with writers active and are
+     * kept only if no write committed meanwhile, the last one runs with writers paused by the write gate so the swap
+     * always happens under steady writes. Readers keep going during every copy.
+     */
+    int LMDBEngine::CompactEnv()
+    {
+        std::string compact_dir = m_dbdir + ".compact";
+        std::string data_file = m_dbdir + "/data.mdb";
+        std::string compact_file = compact_dir + "/data.mdb";
+        int64 size_before = file_size(data_file);
+        uint64 start = get_current_epoch_millis();
+        int rc = ERR_NOTPERFORMED;
+        LockGuard<ThreadMutex> guard(m_backup_lock);
+        for (int retry = 0; retry < 3 && ERR_NOTPERFORMED == rc; retry++)
+        {
+            bool pause_writers = (retry == 2);
+            file_del(compact_dir);
+            make_dir(compact_dir);
+            MDB_envinfo info;
+            if (pause_writers)
+            {
+                g_write_gate.Lock(WRITE_LOCK);
+            }
+            /*
+             * the gates are taken directly instead of by LMDBEnvGuard, whose SafePoint would grow the map while this
+             * thread still holds the write gate.
+             */
+            g_env_gate.Lock(READ_LOCK);
+            mdb_env_info(m_env, &info);
+            rc = mdb_env_copy2(m_env, compact_dir.c_str(), MDB_CP_COMPACT);
+            g_env_gate.Unlock(READ_LOCK);
+            if (0 != rc)
+            {
+                ERROR_LOG("Failed to copy lmdb env for compaction for reason:%s", mdb_strerror(rc));
+                if (pause_writers)
+                {
+                    g_write_gate.Unlock(WRITE_LOCK);
+                }
+                rc = ERR_NOTPERFORMED;
+                break;
+            }
+            if (!pause_writers)
+            {
+                g_write_gate.Lock(WRITE_LOCK);
+            }
+            MDB_envinfo now;
+            mdb_env_info(m_env, &now);
+            if (now.me_last_txnid != info.me_last_txnid)
+            {
+                rc = ERR_NOTPERFORMED;
+            }
+            else
+            {
+                g_env_gate.Lock(WRITE_LOCK);
+                suspend_read_transactions(true);
+                Close();
+                if (0 != rename(compact_file.c_str(), data_file.c_str()))
+                {
+                    ERROR_LOG("Failed to rename %s to %s for reason:%s", compact_file.c_str(), data_file.c_str(), strerror(errno));
+                    rc = ERR_NOTPERFORMED;
+                }
+                if (0 != Reopen(m_cfg))
+                {
+                    FATAL_LOG("Failed to reopen lmdb at %s after compaction.", m_dbdir.c_str());
+                }
+                g_env_gate.Unlock(WRITE_LOCK);
+                /*
+                 * the loop ends here whether the rename succeeded or not.
+                 */
+                if (0 != rc)
+                {
+                    g_write_gate.Unlock(WRITE_LOCK);
+                    break;
+                }
+            }
+            g_write_gate.Unlock(WRITE_LOCK);
+        }
+        file_del(compact_dir);
+        if (0 == rc)
+        {
+            INFO_LOG("Compact lmdb from %lld to %lld bytes in %llums.", (long long) size_before, (long long) file_size(data_file),
+                    (unsigned long long) (get_current_epoch_millis() - start));
+        }
+        else
+        {
+            WARN_LOG("lmdb compaction did not swap in the compacted env.");
+        }
+        return rc;
+    }
+
+    /*
+     * runs the compaction in the caller's thread so that its result reaches COMPACTDB/COMPACTALL. The caller must
+     * not hold the gates itself(a write batch, an open iterator), the exclusive write gate would never be granted.
+     */
+    int LMDBEngine::StartCompaction()
+    {
+        LMDBLocalContext& local_ctx = g_ctx_local.GetValue();
+        if (0 != local_ctx.write_hold || 0 != local_ctx.env_hold || NULL != local_ctx.txn)
+        {
+            WARN_LOG("Can NOT compact lmdb inside a write batch or while iterating.");
+            return ERR_NOTPERFORMED;
+        }
+        if (!atomic_cmp_set_uint32(&m_compacting, 0, 1))
+        {
+            WARN_LOG("lmdb compaction is already running.");
+            return ERR_NOTPERFORMED;
+        }
+        /*
+         * cached read transactions of this thread are closed by the swap like every other thread's.
+         */
+        int rc = CompactEnv();
+        m_compacting = 0;
+        return rc;
+    }
+
     bool LMDBEngine::Exists(Context& ctx, const KeyObject& key,ValueObject& val)
     {
         return Get(ctx, key, val) == 0;
@@ -750,12 +1490,27 @@ namespace ardb
         LMDBLocalContext& local_ctx = g_ctx_local.GetValue();
         return local_ctx.TryReleaseTransanction(false, false);
     }
+    /*
+     * lmdb can only compact the whole file, which is left to COMPACT(CompactAll) instead of every range deletion.
+     */
     int LMDBEngine::Compact(Context& ctx, const KeyObject& start, const KeyObject& end)
     {
         return ERR_NOTSUPPORTED;
     }
+    int LMDBEngine::CompactAll(Context& ctx)
+    {
+        return StartCompaction();
+    }
+    int LMDBEngine::Routine()
+    {
+        LMDBLocalContext& local_ctx = g_ctx_local.GetValue();
+        LMDBEnvGuard guard(local_ctx, false);
+        local_ctx.ReleaseReadTransaction(m_cfg.read_staleness_ms);
+        return 0;
+    }
     int LMDBEngine::ListNameSpaces(Context& ctx, DataArray& nss)
     {
+        LMDBEnvGuard env_guard(g_ctx_local.GetValue(), false);
         RWLockGuard<SpinRWLock> guard(m_lock, true);
         DBITable::iterator it = m_dbis.begin();
         while (it != m_dbis.end())
@@ -776,7 +1531,7 @@ namespace ardb
         LMDBLocalContext& local_ctx = g_ctx_local.GetValue();
         if (0 == local_ctx.AcquireTransanction())
         {
-            rc = mdb_drop(local_ctx.txn, dbi, 0);
+            rc = check_map_full(mdb_drop(local_ctx.txn, dbi, 0));
             CHECK_EXPR(rc);
             local_ctx.TryReleaseTransanction(rc == 0, false);
         }
@@ -814,8 +1569,11 @@ namespace ardb
             iter->MarkValid(false);
             return iter;
         }
-        MDB_cursor* cursor;
-        rc = mdb_cursor_open(local_ctx.txn, dbi, &cursor);
+        MDB_cursor* cursor = local_ctx.TakeCachedCursor(dbi);
+        if (NULL == cursor)
+        {
+            rc = mdb_cursor_open(local_ctx.txn, dbi, &cursor);
+        }
         if (0 != rc)
         {
             ERROR_LOG("Failed to create cursor for reason:%s", mdb_strerror(rc));
@@ -823,7 +1581,7 @@ namespace ardb
             local_ctx.TryReleaseTransanction(true, true);
             return iter;
         }
-        iter->SetCursor(cursor);
+        iter->SetCursor(cursor, dbi);
         if (key.GetType() > 0)
         {
             if (!ctx.flags.iterate_multi_keys)
@@ -1044,11 +1802,21 @@ namespace ardb
 
     LMDBIterator::~LMDBIterator()
     {
+        LMDBLocalContext& local_ctx = g_ctx_local.GetValue();
         if (NULL != m_cursor)
         {
-            mdb_cursor_close(m_cursor);
+            /*
+             * keep the cursor for the next Find on the same DBI while the transaction stays open.
+             */
+            if (local_ctx.txn_ref > 1 && local_ctx.cursor_cache.size() < DEFAULT_LMDB_LOCAL_MULTI_CACHE_SIZE)
+            {
+                local_ctx.cursor_cache.push_back(std::make_pair(m_dbi, m_cursor));
+            }
+            else
+            {
+                mdb_cursor_close(m_cursor);
+            }
         }
-        LMDBLocalContext& local_ctx = g_ctx_local.GetValue();
         local_ctx.TryReleaseTransanction(true, true);
     }
 }
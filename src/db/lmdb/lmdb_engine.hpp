@@ -37,6 +37,7 @@
 #include "thread/thread_mutex_lock.hpp"
 #include "thread/spin_rwlock.hpp"
 #include "thread/event_condition.hpp"
+#include "thread/thread.hpp"
 #include "util/concurrent_queue.hpp"
 #include <stack>
 
@@ -48,6 +49,7 @@ namespace ardb
         private:
             LMDBEngine *m_engine;
             MDB_cursor * m_cursor;
+            MDB_dbi m_dbi;
             Data m_ns;
             KeyObject m_key;
             ValueObject m_value;
@@ -69,16 +71,17 @@ namespace ardb
             Slice RawKey();
             Slice RawValue();
             void Del();
-            void SetCursor(MDB_cursor *cursor)
+            void SetCursor(MDB_cursor *cursor, MDB_dbi dbi)
             {
                 m_cursor = cursor;
+                m_dbi = dbi;
             }
             void ClearState();
             void CheckBound();
             friend class LMDBEngine;
         public:
             LMDBIterator(LMDBEngine * e, const Data& ns) :
-                    m_engine(e), m_cursor(NULL),m_ns(ns), m_valid(true)
+                    m_engine(e), m_cursor(NULL), m_dbi(0), m_ns(ns), m_valid(true)
             {
             }
             KeyObject& IterateUpperBoundKey()
@@ -99,8 +102,13 @@ namespace ardb
             int64 max_dbs;
             int64 batch_commit_watermark;
             bool readahead;
+            bool group_commit;
+            int64 read_staleness_ms;
+            int64 mapsize_grow_step;
+            int64 mapsize_grow_watermark;
             LMDBConfig() :
-                    max_dbsize(10 * 1024 * 1024 * 1024LL), max_dbs(4096), batch_commit_watermark(1024), readahead(false)
+                    max_dbsize(10 * 1024 * 1024 * 1024LL), max_dbs(4096), batch_commit_watermark(1024), readahead(false), group_commit(
+                            true), read_staleness_ms(0), mapsize_grow_step(1024 * 1024 * 1024LL), mapsize_grow_watermark(80)
             {
             }
     };
@@ -117,10 +125,13 @@ namespace ardb
             DBITable m_dbis;
             SpinRWLock m_lock;
             ThreadMutex m_backup_lock;
+            volatile uint32 m_compacting;
             friend class LMDBIterator;
             bool GetDBI(Context& ctx, const Data& name, bool create_if_noexist, MDB_dbi& dbi);
             int Reopen(const LMDBConfig& cfg);
             int Close();
+            int StartCompaction();
+            int CompactEnv();
         public:
             LMDBEngine();
             ~LMDBEngine();
@@ -131,12 +142,15 @@ namespace ardb
             int Get(Context& ctx, const KeyObject& key, ValueObject& value);
             int MultiGet(Context& ctx, const KeyObjectArray& keys, ValueObjectArray& values, ErrCodeArray& errs);
             int Del(Context& ctx, const KeyObject& key);
+            int DelRange(Context& ctx, const KeyObject& start, const KeyObject& end);
             int Merge(Context& ctx, const KeyObject& key, uint16_t op, const DataArray& args);
             bool Exists(Context& ctx, const KeyObject& key,ValueObject& val);
             int BeginWriteBatch(Context& ctx);
             int CommitWriteBatch(Context& ctx);
             int DiscardWriteBatch(Context& ctx);
             int Compact(Context& ctx, const KeyObject& start, const KeyObject& end);
+            int CompactAll(Context& ctx);
+            int Routine();
             int ListNameSpaces(Context& ctx, DataArray& nss);
             int DropNameSpace(Context& ctx, const Data& ns);
             void Stats(Context& ctx, std::string& str);
@@ -152,6 +166,8 @@ namespace ardb
                 features.support_namespace = 1;
                 features.support_merge = 0;
                 features.support_backup = 1;
+                features.support_delete_range = 1;
+                features.support_batch_read_own_writes = 1;
                 return features;
             }
             int MaxOpenFiles()
@@ -135,6 +135,7 @@ namespace ardb
                 features.support_compactfilter = 0;
                 features.support_namespace = 1;
                 features.support_merge = 0;
+                features.support_batch_read_own_writes = 1;
                 return features;
             }
             int MaxOpenFiles();
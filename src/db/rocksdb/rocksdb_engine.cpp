@@ -37,6 +37,11 @@
 #include "thread/spin_mutex_lock.hpp"
 #include "db/db.hpp"
 #include "util/string_helper.hpp"
+#include "util/file_helper.hpp"
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
 
 OP_NAMESPACE_BEGIN
 
@@ -672,11 +677,232 @@ OP_NAMESPACE_BEGIN
         return rocksdb_err(s);
     }
 
+    /*
+     * copy first 'size' bytes of the file, used to copy a consistent view of MANIFEST which is still appending.
+     */
+    static int copy_file_head(const std::string& src, const std::string& dst, uint64_t size)
+    {
+        FILE* from = fopen(src.c_str(), "r");
+        if (NULL == from)
+        {
+            return -1;
+        }
+        FILE* to = fopen(dst.c_str(), "w");
+        if (NULL == to)
+        {
+            fclose(from);
+            return -1;
+        }
+        int err = 0;
+        char buf[64 * 1024];
+        while (size > 0)
+        {
+            size_t n = size > sizeof(buf) ? sizeof(buf) : size;
+            if (fread(buf, n, 1, from) != 1 || fwrite(buf, n, 1, to) != 1)
+            {
+                err = -1;
+                break;
+            }
+            size -= n;
+        }
+        fclose(from);
+        if (0 != fclose(to))
+        {
+            err = -1;
+        }
+        return err;
+    }
+
+    /*
+     * sst files are immutable, link them if possible, only copy them if 'src' & 'dst' are on different devices.
+     */
+    static int link_or_copy_file(const std::string& src, const std::string& dst)
+    {
+        if (0 == link(src.c_str(), dst.c_str()))
+        {
+            return 0;
+        }
+        return file_copy(src, dst);
+    }
+
+    int RocksDBEngine::Checkpoint(Context& ctx, const std::string& dir, const std::string& base_dir, CheckpointPinnedCallback* on_pinned,
+            void* data)
+    {
+        LockGuard<ThreadMutex> guard(m_backup_lock);
+        uint64_t start = get_current_epoch_millis();
+        rocksdb::Status s = m_db->DisableFileDeletions();
+        std::vector<std::string> live_files;
+        uint64_t manifest_size = 0;
+        if (s.ok())
+        {
+            /*
+             * flush memtables, then all data are in sst files, no wal file need to be copied.
+             */
+            s = m_db->GetLiveFiles(live_files, &manifest_size, true);
+        }
+        if (NULL != on_pinned)
+        {
+            on_pinned(data);
+        }
+        if (!s.ok())
+        {
+            ERROR_LOG("Failed to pin live files for checkpoint:%s", s.ToString().c_str());
+            m_db->EnableFileDeletions(false);
+            return rocksdb_err(s);
+        }
+        uint64_t pinned_ms = get_current_epoch_millis() - start;
+        uint32_t base_linked = 0, db_linked = 0, copied_files = 0;
+        uint64_t copied_bytes = 0;
+        std::string manifest;
+        for (size_t i = 0; i < live_files.size() && s.ok(); i++)
+        {
+            /*
+             * live file name is started with '/'
+             */
+            const std::string& fname = live_files[i];
+            std::string src = m_dbdir + fname;
+            std::string dst = dir + fname;
+            if (has_suffix(fname, ".sst"))
+            {
+                if (0 == link(src.c_str(), dst.c_str()))
+                {
+                    db_linked++;
+                    continue;
+                }
+                /*
+                 * db & checkpoint are on different devices, reuse the same sst from previous checkpoint.
+                 */
+                int64 size = file_size(src);
+                if (!base_dir.empty() && size > 0 && file_size(base_dir + fname) == size && 0 == link((base_dir + fname).c_str(), dst.c_str()))
+                {
+                    base_linked++;
+                    continue;
+                }
+                if (0 != file_copy(src, dst))
+                {
+                    s = rocksdb::Status::IOError("copy file failed", src);
+                }
+                copied_files++;
+                copied_bytes += size;
+            }
+            else if (has_prefix(fname, "/MANIFEST-"))
+            {
+                manifest = fname.substr(1);
+                if (0 != copy_file_head(src, dst, manifest_size))
+                {
+                    s = rocksdb::Status::IOError("copy manifest failed", src);
+                }
+                copied_files++;
+                copied_bytes += manifest_size;
+            }
+            else if (fname == "/CURRENT")
+            {
+                /*
+                 * 'CURRENT' may point to a newer manifest now, create it after all files copied.
+                 */
+                continue;
+            }
+            else
+            {
+                if (0 != file_copy(src, dst))
+                {
+                    s = rocksdb::Status::IOError("copy file failed", src);
+                }
+                copied_files++;
+                copied_bytes += file_size(src);
+            }
+        }
+        if (s.ok() && (manifest.empty() || 0 != file_write_content(dir + "/CURRENT", manifest + "\n")))
+        {
+            s = rocksdb::Status::IOError("create CURRENT failed", dir);
+        }
+        m_db->EnableFileDeletions(false);
+        if (!s.ok())
+        {
+            ERROR_LOG("Failed to create checkpoint for reason:%s", s.ToString().c_str());
+            return rocksdb_err(s);
+        }
+        INFO_LOG("Checkpoint %s created in %llums(pinned in %llums), %u sst linked from db, %u sst linked from %s, %u files with %llu bytes copied.",
+                dir.c_str(), get_current_epoch_millis() - start, pinned_ms, db_linked, base_linked, base_dir.c_str(), copied_files, copied_bytes);
+        return 0;
+    }
+
+    /*
+     * The checkpoint is restored into a sibling dir first, the current db dir is only replaced once every file is in
+     * place, a failed restore leaves it untouched.
+     */
+    int RocksDBEngine::RestoreCheckpoint(const std::string& dir)
+    {
+        std::deque<std::string> fs;
+        list_subfiles(dir, fs);
+        std::string restore_dir = m_dbdir + ".restore";
+        std::string old_dir = m_dbdir + ".old";
+        file_del(restore_dir);
+        if (!make_dir(restore_dir))
+        {
+            ERROR_LOG("Failed to create restore dir:%s", restore_dir.c_str());
+            return -1;
+        }
+        for (size_t i = 0; i < fs.size(); i++)
+        {
+            std::string src = dir + "/" + fs[i];
+            std::string dst = restore_dir + "/" + fs[i];
+            int err = 0;
+            if (has_suffix(fs[i], ".sst"))
+            {
+                /*
+                 * the checkpoint may still be used to sync other slaves, link instead of rename.
+                 */
+                err = link_or_copy_file(src, dst);
+            }
+            else
+            {
+                err = file_copy(src, dst);
+            }
+            if (0 != err)
+            {
+                ERROR_LOG("Failed to restore file:%s from checkpoint.", src.c_str());
+                file_del(restore_dir);
+                return -1;
+            }
+        }
+        /*
+         * rename can not replace a non-empty dir, move the old one aside and put it back if the swap fails.
+         */
+        file_del(old_dir);
+        if (0 != rename(m_dbdir.c_str(), old_dir.c_str()) && ENOENT != errno)
+        {
+            ERROR_LOG("Failed to rename %s to %s for reason:%s", m_dbdir.c_str(), old_dir.c_str(), strerror(errno));
+            file_del(restore_dir);
+            return -1;
+        }
+        if (0 != rename(restore_dir.c_str(), m_dbdir.c_str()))
+        {
+            ERROR_LOG("Failed to rename %s to %s for reason:%s", restore_dir.c_str(), m_dbdir.c_str(), strerror(errno));
+            rename(old_dir.c_str(), m_dbdir.c_str());
+            file_del(restore_dir);
+            return -1;
+        }
+        file_del(old_dir);
+        INFO_LOG("Restore %zu files from checkpoint:%s", fs.size(), dir.c_str());
+        return 0;
+    }
+
     int RocksDBEngine::Restore(Context& ctx, const std::string& dir)
     {
         LockGuard<ThreadMutex> guard(m_backup_lock);
         m_bulk_loading = true;
         Close();
+        if (is_file_exist(dir + "/CURRENT"))
+        {
+            /*
+             * 'dir' is created by 'Checkpoint', it's a db dir could be opened directly.
+             */
+            int err = RestoreCheckpoint(dir);
+            ReOpen(m_options);
+            m_bulk_loading = false;
+            return err;
+        }
         rocksdb::BackupEngineReadOnly* backup_engine = NULL;
         rocksdb::BackupableDBOptions opt(dir);
         rocksdb::Status s = rocksdb::BackupEngineReadOnly::Open(rocksdb::Env::Default(), opt, &backup_engine);
@@ -1308,6 +1534,9 @@ OP_NAMESPACE_BEGIN
         features.support_merge = 1;
         features.support_backup = 1;
         features.support_delete_range = 1;
+        features.support_checkpoint = 1;
+        features.support_range_compact = 1;
+        features.support_concurrent_iterator = 1;
         return features;
     }
 
@@ -114,6 +114,7 @@ OP_NAMESPACE_BEGIN
 
             Data GetNamespaceByColumnFamilyId(uint32 id);
             int ReOpen(rocksdb::Options& options);
+            int RestoreCheckpoint(const std::string& dir);
             void Close();
             friend class RocksDBIterator;
             friend class RocksDBCompactionFilter;
@@ -147,6 +148,7 @@ OP_NAMESPACE_BEGIN
             const std::string GetErrorReason(int err);
             int Backup(Context& ctx, const std::string& dir);
             int Restore(Context& ctx, const std::string& dir);
+            int Checkpoint(Context& ctx, const std::string& dir, const std::string& base_dir, CheckpointPinnedCallback* on_pinned, void* data);
             const FeatureSet GetFeatureSet();
             int Routine();
             int MaxOpenFiles();
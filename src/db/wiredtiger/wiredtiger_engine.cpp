@@ -478,6 +478,49 @@ namespace ardb
         local_ctx.RecycleCursor(key.GetNameSpace(), cursor);
         return WT_NERR(ret);
     }
+    int WiredTigerEngine::DelRange(Context& ctx, const KeyObject& start, const KeyObject& end)
+    {
+        WiredTigerLocalContext& local_ctx = GetDBLocalContext();
+        WT_CURSOR *start_cursor = local_ctx.GetKVStore(start.GetNameSpace(), false, true);
+        if (NULL == start_cursor)
+        {
+            return ERR_ENTRY_NOT_EXIST;
+        }
+        WT_SESSION *session = local_ctx.wsession;
+        WT_CURSOR *stop_cursor = NULL;
+        int ret = session->open_cursor(session, table_url(start.GetNameSpace()).c_str(), NULL, NULL, &stop_cursor);
+        if (0 != ret)
+        {
+            LOG_WTERROR(ret);
+            local_ctx.RecycleCursor(start.GetNameSpace(), start_cursor);
+            return WT_ERR(ret);
+        }
+        Buffer& encode_buffer = local_ctx.GetEncodeBuferCache();
+        start.Encode(encode_buffer);
+        size_t start_len = encode_buffer.ReadableBytes();
+        end.Encode(encode_buffer);
+        size_t end_len = encode_buffer.ReadableBytes() - start_len;
+        WT_ITEM start_item, stop_item;
+        start_item.data = (const void *) encode_buffer.GetRawBuffer();
+        start_item.size = start_len;
+        stop_item.data = (const void *) (encode_buffer.GetRawBuffer() + start_len);
+        stop_item.size = end_len;
+        start_cursor->set_key(start_cursor, &start_item);
+        stop_cursor->set_key(stop_cursor, &stop_item);
+        /*
+         * truncate removes the range [start, stop] by dropping whole pages where possible instead of
+         * writing one tombstone per element, the end key(KEY_END) is never stored so the inclusive stop is safe.
+         */
+        ret = session->truncate(session, NULL, start_cursor, stop_cursor, NULL);
+        if (WT_NOTFOUND != ret)
+        {
+            LOG_WTERROR(ret);
+        }
+        start_cursor->reset(start_cursor);
+        local_ctx.RecycleCursor(start.GetNameSpace(), start_cursor);
+        stop_cursor->close(stop_cursor);
+        return WT_NERR(ret);
+    }
     int WiredTigerEngine::Merge(Context& ctx, const KeyObject& key, uint16_t op, const DataArray& args)
     {
         ValueObject current;
@@ -523,7 +566,19 @@ namespace ardb
     }
     int WiredTigerEngine::Compact(Context& ctx, const KeyObject& start, const KeyObject& end)
     {
-        return ERR_NOTSUPPORTED;
+        /*
+         * wiredtiger only supports compacting a whole table, which reclaims the space released by truncate.
+         */
+        const Data& ns = start.GetNameSpace().IsNil() ? ctx.ns : start.GetNameSpace();
+        if (!GetTable(ns, false))
+        {
+            return ERR_ENTRY_NOT_EXIST;
+        }
+        WiredTigerLocalContext& local_ctx = GetDBLocalContext();
+        WT_SESSION *session = local_ctx.wsession;
+        int ret = session->compact(session, table_url(ns).c_str(), NULL);
+        LOG_WTERROR(ret);
+        return WT_ERR(ret);
     }
     int WiredTigerEngine::ListNameSpaces(Context& ctx, DataArray& nss)
     {
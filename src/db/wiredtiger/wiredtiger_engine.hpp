@@ -115,6 +115,7 @@ namespace ardb
             int Get(Context& ctx, const KeyObject& key, ValueObject& value);
             int MultiGet(Context& ctx, const KeyObjectArray& keys, ValueObjectArray& values, ErrCodeArray& errs);
             int Del(Context& ctx, const KeyObject& key);
+            int DelRange(Context& ctx, const KeyObject& start, const KeyObject& end);
             int Merge(Context& ctx, const KeyObject& key, uint16_t op, const DataArray& args);
             bool Exists(Context& ctx, const KeyObject& key,ValueObject& val);
             int BeginWriteBatch(Context& ctx);
@@ -133,6 +134,7 @@ namespace ardb
                 features.support_compactfilter = 0;
                 features.support_namespace = 1;
                 features.support_merge = 0;
+                features.support_delete_range = 1;
                 return features;
             }
             int MaxOpenFiles();
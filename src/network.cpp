@@ -54,6 +54,7 @@ OP_NAMESPACE_BEGIN
             void Run()
             {
                 g_db->ScanClients();
+                g_engine->Routine();
             }
             void OnStart(ChannelService* serv, uint32 idx)
             {
@@ -33,6 +33,10 @@
 #include "util/file_helper.hpp"
 
 #define MAX_SEND_CACHE_SIZE 8192
+#define MAX_SENDFILE_CHUNK_SIZE (4 * 1024 * 1024)
+#define MAX_COMPRESS_CHUNK_SIZE (64 * 1024)
+#define MAX_COMPRESS_OUTPUT_SIZE (1024 * 1024)
+#define MAX_DISKLESS_INFLIGHT_SIZE (4 * 1024 * 1024)
 
 OP_NAMESPACE_BEGIN
     enum SyncState
@@ -56,8 +60,21 @@ OP_NAMESPACE_BEGIN
             uint32 port;
             bool isRedisSlave;
             uint8 state;
+            bool wal_file_sending;
+            size_t wal_sending_len;
+            CompressType compress_requested;
+            CompressType compress;
+            CompressStat compress_stat;
+            SendFileSetting compress_file;
+            bool compress_file_sending;
+            bool capa_eof;
+            bool diskless;
+            uint64 diskless_chunk;
+            std::string diskless_eof_mark;
             SlaveSyncContext() :
-                    snapshot(NULL), conn(NULL), sync_offset(0), ack_offset(0), sync_cksm(0), acktime(0), port(0), isRedisSlave(false), state(SYNC_STATE_INVALID)
+                    snapshot(NULL), conn(NULL), sync_offset(0), ack_offset(0), sync_cksm(0), acktime(0), port(0), isRedisSlave(false), state(SYNC_STATE_INVALID), wal_file_sending(
+                            false), wal_sending_len(0), compress_requested(COMPRESS_NONE), compress(COMPRESS_NONE), compress_file_sending(false), capa_eof(false), diskless(
+                            false), diskless_chunk(0)
             {
             }
             std::string GetAddress()
@@ -79,9 +96,35 @@ OP_NAMESPACE_BEGIN
             }
     };
 
+    /*
+     * all data written to slave after the psync reply would be compressed frames if compression is negotiated.
+     */
+    static void write_to_slave(SlaveSyncContext* slave, Buffer& buf)
+    {
+        if (COMPRESS_NONE == slave->compress)
+        {
+            slave->conn->Write(buf);
+            return;
+        }
+        /*
+         * keep every frame within MAX_COMPRESS_CHUNK_SIZE, slaves reject frames above their configured limit.
+         */
+        Buffer frame;
+        const char* data = buf.GetRawReadBuffer();
+        size_t rest = buf.ReadableBytes();
+        while (rest > 0)
+        {
+            size_t len = rest > MAX_COMPRESS_CHUNK_SIZE ? MAX_COMPRESS_CHUNK_SIZE : rest;
+            CompressFrameCodec::Encode(slave->compress, data, len, frame, &slave->compress_stat);
+            data += len;
+            rest -= len;
+        }
+        slave->conn->Write(frame);
+    }
+
     Master::Master() :
             m_repl_noslaves_since(0), m_repl_nolag_since(0), m_repl_good_slaves_count(0), m_slaves_count(0), m_sync_full_count(0), m_sync_partial_ok_count(0), m_sync_partial_err_count(
-                    0)
+                    0), m_diskless_snapshot(NULL), m_diskless_wait_since(0), m_diskless_done(false)
     {
     }
 
@@ -135,6 +178,31 @@ OP_NAMESPACE_BEGIN
         return 0;
     }
 
+    static void diskless_snapshot_feed(Channel* ch, void* data)
+    {
+        g_repl->GetMaster().FeedDisklessSlaves();
+    }
+    static void diskless_snapshot_done(Channel* ch, void* data)
+    {
+        g_repl->GetMaster().OnDisklessSnapshotDone((StreamSnapshot*) data);
+    }
+
+    static int diskless_snapshot_routine(SnapshotState state, Snapshot* snapshot, void* cb)
+    {
+        /*
+         * invoked in dump thread, all slaves are fed in replication thread.
+         */
+        if (state == DUMPING)
+        {
+            g_repl->GetIOService().AsyncIO(0, diskless_snapshot_feed, snapshot);
+        }
+        else if (state == DUMP_SUCCESS || state == DUMP_FAIL)
+        {
+            g_repl->GetIOService().AsyncIO(0, diskless_snapshot_done, snapshot);
+        }
+        return 0;
+    }
+
     int Master::Routine()
     {
         m_repl_good_slaves_count = 0;
@@ -147,6 +215,10 @@ OP_NAMESPACE_BEGIN
             return 0;
         }
         m_repl_noslaves_since = 0;
+        if (m_diskless_wait_since > 0 && time(NULL) - m_diskless_wait_since >= g_db->GetConf().repl_diskless_sync_delay)
+        {
+            StartDisklessSync();
+        }
         std::vector<SlaveSyncContext*> to_close;
         SlaveSyncContextSet::iterator fit = m_slaves.begin();
         bool wal_ping_saved = false;
@@ -158,7 +230,7 @@ OP_NAMESPACE_BEGIN
             {
                 Buffer newline;
                 newline.Write("\n", 1);
-                slave->conn->Write(newline);
+                write_to_slave(slave, newline);
             }
             if (slave->state == SYNC_STATE_SYNCED)
             {
@@ -219,6 +291,188 @@ OP_NAMESPACE_BEGIN
         }
     }
 
+    void Master::StartDisklessSync()
+    {
+        if (NULL != m_diskless_snapshot)
+        {
+            /*
+             * waiting slaves would be served by next stream after current one finished.
+             */
+            return;
+        }
+        std::vector<SlaveSyncContext*> waiting;
+        SlaveSyncContextSet::iterator it = m_slaves.begin();
+        while (it != m_slaves.end())
+        {
+            SlaveSyncContext* slave = *it;
+            if (slave != NULL && slave->diskless && slave->state == SYNC_STATE_WAITING_SNAPSHOT && NULL == slave->snapshot)
+            {
+                waiting.push_back(slave);
+            }
+            it++;
+        }
+        m_diskless_wait_since = 0;
+        if (waiting.empty())
+        {
+            return;
+        }
+        StreamSnapshot* snapshot = NULL;
+        NEW(snapshot, StreamSnapshot(g_db->GetConf().slave_client_output_buffer_limit));
+        if (0 != snapshot->BGStream(diskless_snapshot_routine, this))
+        {
+            ERROR_LOG("Failed to create snapshot stream for diskless sync.");
+            DELETE(snapshot);
+            for (size_t i = 0; i < waiting.size(); i++)
+            {
+                CloseSlave(waiting[i]);
+            }
+            return;
+        }
+        m_diskless_snapshot = snapshot;
+        m_diskless_done = false;
+        /*
+         * force to re-emit a SELECT statement in the replication stream after the snapshot.
+         */
+        g_repl->GetReplLog().ClearCurrentNamespace();
+        INFO_LOG("[Master]Start diskless sync for %zu slaves at offset:%llu", waiting.size(), snapshot->CachedReplOffset());
+        for (size_t i = 0; i < waiting.size(); i++)
+        {
+            SlaveSyncContext* slave = waiting[i];
+            slave->snapshot = snapshot;
+            slave->sync_offset = snapshot->CachedReplOffset();
+            slave->sync_cksm = snapshot->CachedReplCksm();
+            slave->diskless_chunk = 0;
+            slave->diskless_eof_mark = random_hex_string(40);
+            slave->state = SYNC_STATE_SYNCING_SNAPSHOT;
+            Buffer msg;
+            msg.Printf("+FULLRESYNC %s %lld %llu diskless", g_repl->GetReplLog().GetReplKey().c_str(), slave->sync_offset, slave->sync_cksm);
+            if (COMPRESS_NONE != slave->compress_requested)
+            {
+                msg.Printf(" compress=%s", CompressFrameCodec::TypeName(slave->compress_requested));
+            }
+            msg.Printf("\r\n");
+            slave->conn->Write(msg);
+            slave->compress = slave->compress_requested;
+            /*
+             * dump size is unknown before the stream finished, use eof mark like redis.
+             */
+            Buffer header;
+            header.Printf("$EOF:%s\r\n", slave->diskless_eof_mark.c_str());
+            write_to_slave(slave, header);
+        }
+    }
+
+    void Master::FeedDisklessSlave(SlaveSyncContext* slave)
+    {
+        StreamSnapshot* snapshot = m_diskless_snapshot;
+        if (NULL == snapshot || slave->snapshot != snapshot)
+        {
+            return;
+        }
+        while (slave->conn->WritableBytes() < MAX_DISKLESS_INFLIGHT_SIZE)
+        {
+            const Buffer* chunk = snapshot->GetChunk(slave->diskless_chunk);
+            if (NULL == chunk)
+            {
+                break;
+            }
+            Buffer content(const_cast<char*>(chunk->GetRawReadBuffer()), 0, chunk->ReadableBytes());
+            write_to_slave(slave, content);
+            slave->diskless_chunk++;
+        }
+        if (m_diskless_done && snapshot->IsStreamComplete() && slave->diskless_chunk == snapshot->ChunkEnd())
+        {
+            Buffer eof;
+            eof.Write(slave->diskless_eof_mark.data(), slave->diskless_eof_mark.size());
+            write_to_slave(slave, eof);
+            slave->snapshot = NULL;
+            slave->state = SYNC_STATE_SYNCED;
+            INFO_LOG("Stream snapshot to slave:%s success.", slave->GetAddress().c_str());
+            SyncWAL(slave);
+        }
+    }
+
+    void Master::FeedDisklessSlaves()
+    {
+        if (NULL == m_diskless_snapshot)
+        {
+            return;
+        }
+        std::vector<SlaveSyncContext*> feeding;
+        SlaveSyncContextSet::iterator it = m_slaves.begin();
+        while (it != m_slaves.end())
+        {
+            SlaveSyncContext* slave = *it;
+            if (slave != NULL && slave->snapshot == m_diskless_snapshot)
+            {
+                feeding.push_back(slave);
+            }
+            it++;
+        }
+        for (size_t i = 0; i < feeding.size(); i++)
+        {
+            FeedDisklessSlave(feeding[i]);
+        }
+        ReleaseDisklessChunks();
+    }
+
+    void Master::ReleaseDisklessChunks()
+    {
+        if (NULL == m_diskless_snapshot)
+        {
+            return;
+        }
+        uint64 min_chunk = m_diskless_snapshot->ChunkEnd();
+        bool attached = false;
+        SlaveSyncContextSet::iterator it = m_slaves.begin();
+        while (it != m_slaves.end())
+        {
+            SlaveSyncContext* slave = *it;
+            if (slave != NULL && slave->snapshot == m_diskless_snapshot)
+            {
+                attached = true;
+                if (slave->diskless_chunk < min_chunk)
+                {
+                    min_chunk = slave->diskless_chunk;
+                }
+            }
+            it++;
+        }
+        if (attached)
+        {
+            m_diskless_snapshot->ReleaseChunks(min_chunk);
+            return;
+        }
+        if (m_diskless_done)
+        {
+            DELETE(m_diskless_snapshot);
+            m_diskless_snapshot = NULL;
+        }
+        else
+        {
+            /*
+             * no slave need the stream anymore, the snapshot would be destroyed after dump thread exit.
+             */
+            m_diskless_snapshot->Abort();
+            m_diskless_snapshot->ReleaseChunks(min_chunk);
+        }
+    }
+
+    void Master::OnDisklessSnapshotDone(StreamSnapshot* snapshot)
+    {
+        if (snapshot != m_diskless_snapshot)
+        {
+            return;
+        }
+        m_diskless_done = true;
+        if (!snapshot->IsStreamComplete())
+        {
+            WARN_LOG("Failed to stream snapshot for diskless sync.");
+            CloseSlaveBySnapshot(snapshot);
+        }
+        FeedDisklessSlaves();
+    }
+
     bool Master::IsAllSlaveSyncingCache()
     {
         SlaveSyncContextSet::iterator it = m_slaves.begin();
@@ -302,13 +556,13 @@ OP_NAMESPACE_BEGIN
             Buffer header;
             BufferHelper::WriteVarString(header, fs);
             BufferHelper::WriteFixInt64(header, (int64_t) (st.st_size));
-            slave->conn->Write(header);
+            write_to_slave(slave, header);
 
             setting.file_rest_len = st.st_size;
             setting.on_complete = OnSnapshotBackupSendComplete;
             setting.on_failure = OnSnapshotBackupSendFailure;
             setting.data = slave;
-            slave->conn->SendFile(setting);
+            SendFileToSlave(slave, setting);
         }
         else
         {
@@ -347,7 +601,7 @@ OP_NAMESPACE_BEGIN
             int64_t filenum = slave->sync_backup_fs.size();
             header.Printf("#");  //start char
             BufferHelper::WriteFixInt64(header, filenum);
-            slave->conn->Write(header);
+            write_to_slave(slave, header);
             return SendBackupToSlave(slave);
         }
 
@@ -364,20 +618,78 @@ OP_NAMESPACE_BEGIN
         fstat(setting.fd, &st);
         Buffer header;
         header.Printf("$%llu\r\n", st.st_size);
-        slave->conn->Write(header);
+        write_to_slave(slave, header);
 
         setting.file_rest_len = st.st_size;
         setting.on_complete = OnSnapshotFileSendComplete;
         setting.on_failure = OnSnapshotFileSendFailure;
         setting.data = slave;
-        slave->conn->SendFile(setting);
+        SendFileToSlave(slave, setting);
         return 0;
     }
 
+    int Master::SendFileToSlave(SlaveSyncContext* slave, const SendFileSetting& setting)
+    {
+        if (COMPRESS_NONE == slave->compress)
+        {
+            return slave->conn->SendFile(setting);
+        }
+        /*
+         * compressed file content can NOT be sent by 'sendfile', read & compress it chunk by chunk when slave is writable.
+         */
+        slave->compress_file = setting;
+        slave->compress_file_sending = true;
+        slave->conn->GetWritableOptions().auto_disable_writing = false;
+        slave->conn->EnableWriting();
+        return 0;
+    }
+
+    void Master::SendCompressedFileChunk(SlaveSyncContext* slave)
+    {
+        SendFileSetting& setting = slave->compress_file;
+        char buf[MAX_COMPRESS_CHUNK_SIZE];
+        while (setting.file_rest_len > 0 && slave->conn->WritableBytes() < MAX_COMPRESS_OUTPUT_SIZE)
+        {
+            size_t len = setting.file_rest_len > MAX_COMPRESS_CHUNK_SIZE ? MAX_COMPRESS_CHUNK_SIZE : setting.file_rest_len;
+            ssize_t n = pread(setting.fd, buf, len, setting.file_offset);
+            if (n <= 0)
+            {
+                int err = errno;
+                ERROR_LOG("Failed to read file to send for reason:%s", strerror(err));
+                slave->conn->Close();
+                return;
+            }
+            CompressFrameCodec::Encode(slave->compress, buf, n, slave->conn->GetOutputBuffer(), &slave->compress_stat);
+            setting.file_offset += n;
+            setting.file_rest_len -= n;
+        }
+        slave->conn->EnableWriting();
+        if (setting.file_rest_len == 0)
+        {
+            slave->compress_file_sending = false;
+            if (setting.close_fd)
+            {
+                close(setting.fd);
+            }
+            setting.fd = -1;
+            if (NULL != setting.on_complete)
+            {
+                setting.on_complete(setting.data);
+            }
+        }
+    }
+
     static size_t send_wal_toslave(const void* log, size_t loglen, void* data)
     {
         SlaveSyncContext* slave = (SlaveSyncContext*) data;
-        slave->conn->GetOutputBuffer().Write(log, loglen);
+        if (COMPRESS_NONE == slave->compress)
+        {
+            slave->conn->GetOutputBuffer().Write(log, loglen);
+        }
+        else
+        {
+            CompressFrameCodec::Encode(slave->compress, log, loglen, slave->conn->GetOutputBuffer(), &slave->compress_stat);
+        }
         slave->sync_offset += loglen;
         if ((uint64_t)slave->sync_offset == g_repl->GetReplLog().WALEndOffset(false))
         {
@@ -391,8 +703,76 @@ OP_NAMESPACE_BEGIN
         return loglen;
     }
 
+    static void OnWALFileSendComplete(void* data)
+    {
+        SlaveSyncContext* slave = (SlaveSyncContext*) data;
+        slave->wal_file_sending = false;
+        slave->sync_offset += slave->wal_sending_len;
+        slave->wal_sending_len = 0;
+        if ((uint64_t) slave->sync_offset == g_repl->GetReplLog().WALEndOffset())
+        {
+            slave->conn->GetWritableOptions().auto_disable_writing = true;
+        }
+    }
+
+    /*
+     * The wal is appended by this same io thread between partial sends, so the unsent rest of the chunk is checked
+     * before every send. Once it has been overwritten in the ring the sending aborts and the slave is closed before
+     * any overwritten byte leaves the master.
+     */
+    static off_t LimitWALFileSend(void* data, off_t file_offset, off_t rest_len)
+    {
+        SlaveSyncContext* slave = (SlaveSyncContext*) data;
+        uint64_t rest_start = slave->sync_offset + slave->wal_sending_len - rest_len;
+        if (rest_start < g_repl->GetReplLog().WALStartOffset())
+        {
+            WARN_LOG("Unsent wal range of slave:%s was overwritten, close it.", slave->GetAddress().c_str());
+            return -1;
+        }
+        return rest_len;
+    }
+
+    static void OnWALFileSendFailure(void* data)
+    {
+        SlaveSyncContext* slave = (SlaveSyncContext*) data;
+        slave->wal_file_sending = false;
+        slave->wal_sending_len = 0;
+        WARN_LOG("Send wal to slave:%s failed.", slave->GetAddress().c_str());
+    }
+
+    int Master::SendWALFileToSlave(SlaveSyncContext* slave)
+    {
+        size_t file_pos = 0, len = 0;
+        int fd = g_repl->GetReplLog().LogFD();
+        if (fd < 0 || 0 != g_repl->GetReplLog().LogFileRange(slave->sync_offset, MAX_SENDFILE_CHUNK_SIZE, file_pos, len) || 0 == len)
+        {
+            return -1;
+        }
+        /*
+         * the wal log file is shared by all slaves, the channel must NOT close it after sending.
+         */
+        SendFileSetting setting;
+        setting.fd = fd;
+        setting.close_fd = false;
+        setting.file_offset = file_pos;
+        setting.file_rest_len = len;
+        setting.on_complete = OnWALFileSendComplete;
+        setting.on_failure = OnWALFileSendFailure;
+        setting.limit = LimitWALFileSend;
+        setting.data = slave;
+        slave->wal_file_sending = true;
+        slave->wal_sending_len = len;
+        slave->conn->GetWritableOptions().auto_disable_writing = false;
+        slave->conn->SendFile(setting);
+        return 0;
+    }
+
     void Master::SyncWAL(SlaveSyncContext* slave)
     {
+        if (slave->wal_file_sending)
+        {
+            return;
+        }
         if ((uint64_t)slave->sync_offset < g_repl->GetReplLog().WALStartOffset() || (uint64_t)slave->sync_offset > g_repl->GetReplLog().WALEndOffset())
         {
             WARN_LOG("Slave synced offset:%llu is invalid in offset range[%llu-%llu] for wal.", slave->sync_offset, g_repl->GetReplLog().WALStartOffset(),
@@ -409,6 +789,18 @@ OP_NAMESPACE_BEGIN
         }
         if ((uint64_t)slave->sync_offset < g_repl->GetReplLog().WALEndOffset())
         {
+            if (COMPRESS_NONE != slave->compress)
+            {
+                /*
+                 * replay larger chunk for compressed link to get better compression ratio
+                 */
+                g_repl->GetReplLog().Replay(slave->sync_offset, MAX_COMPRESS_CHUNK_SIZE, send_wal_toslave, slave);
+                return;
+            }
+            if (g_db->GetConf().repl_backlog_sendfile && !slave->conn->IsSendingFile() && 0 == SendWALFileToSlave(slave))
+            {
+                return;
+            }
             g_repl->GetReplLog().Replay(slave->sync_offset, MAX_SEND_CACHE_SIZE, send_wal_toslave, slave);
         }
     }
@@ -475,8 +867,16 @@ OP_NAMESPACE_BEGIN
             }
             if (!fullsync)
             {
-                msg.Printf("+CONTINUE\r\n");
+                if (COMPRESS_NONE != slave->compress_requested)
+                {
+                    msg.Printf("+CONTINUE compress=%s\r\n", CompressFrameCodec::TypeName(slave->compress_requested));
+                }
+                else
+                {
+                    msg.Printf("+CONTINUE\r\n");
+                }
                 slave->conn->Write(msg);
+                slave->compress = slave->compress_requested;
                 slave->state = SYNC_STATE_SYNCED;
                 INFO_LOG("[Master]Send +CONTINUE to slave %s.", slave->GetAddress().c_str());
                 SyncWAL(slave);
@@ -492,6 +892,23 @@ OP_NAMESPACE_BEGIN
                         slave->repl_key.c_str(), slave->sync_offset, slave->sync_cksm, g_repl->GetReplLog().GetReplKey().c_str(),
                         g_repl->GetReplLog().WALEndOffset(), g_repl->GetReplLog().WALCksm());
                 slave->state = SYNC_STATE_WAITING_SNAPSHOT;
+                if (g_db->GetConf().repl_diskless_sync && !slave->isRedisSlave && slave->capa_eof)
+                {
+                    /*
+                     * slaves arrived in 'repl-diskless-sync-delay' seconds would share the same snapshot stream.
+                     */
+                    slave->diskless = true;
+                    m_sync_full_count++;
+                    if (0 == m_diskless_wait_since)
+                    {
+                        m_diskless_wait_since = time(NULL);
+                    }
+                    if (g_db->GetConf().repl_diskless_sync_delay <= 0)
+                    {
+                        StartDisklessSync();
+                    }
+                    return;
+                }
                 SnapshotType snapshot_type = slave->isRedisSlave ? REDIS_DUMP : ARDB_DUMP;
                 if (slave->engine == g_engine_name && g_engine->GetFeatureSet().support_backup)
                 {
@@ -514,10 +931,19 @@ OP_NAMESPACE_BEGIN
                     }
                     else
                     {
-                        msg.Printf("+%s %s %lld %llu\r\n", BACKUP_DUMP == snapshot_type ? "FULLBACKUP" : "FULLRESYNC",
+                        msg.Printf("+%s %s %lld %llu", BACKUP_DUMP == snapshot_type ? "FULLBACKUP" : "FULLRESYNC",
                                 g_repl->GetReplLog().GetReplKey().c_str(), slave->sync_offset, slave->sync_cksm);
+                        if (COMPRESS_NONE != slave->compress_requested)
+                        {
+                            msg.Printf(" compress=%s", CompressFrameCodec::TypeName(slave->compress_requested));
+                        }
+                        msg.Printf("\r\n");
                     }
                     slave->conn->Write(msg);
+                    if (!slave->isRedisSlave)
+                    {
+                        slave->compress = slave->compress_requested;
+                    }
                     m_sync_full_count++;
                     if (slave->snapshot->IsReady())
                     {
@@ -538,9 +964,27 @@ OP_NAMESPACE_BEGIN
         SlaveSyncContext* slave = (SlaveSyncContext*) (ctx.GetChannel()->Attachment());
         if (NULL != slave)
         {
+            if (slave->compress_file_sending)
+            {
+                slave->compress_file_sending = false;
+                if (slave->compress_file.close_fd)
+                {
+                    close(slave->compress_file.fd);
+                }
+                slave->compress_file.fd = -1;
+                if (NULL != slave->compress_file.on_failure)
+                {
+                    slave->compress_file.on_failure(slave->compress_file.data);
+                }
+            }
             WARN_LOG("Slave %s closed.", slave->GetAddress().c_str());
             m_slaves.erase(slave);
             m_slaves_count = m_slaves.size();
+            if (slave->diskless && NULL != slave->snapshot)
+            {
+                slave->snapshot = NULL;
+                ReleaseDisklessChunks();
+            }
         }
     }
     void Master::ChannelWritable(ChannelHandlerContext& ctx, ChannelStateEvent& e)
@@ -549,7 +993,16 @@ OP_NAMESPACE_BEGIN
         SlaveSyncContext* slave = (SlaveSyncContext*) (ctx.GetChannel()->Attachment());
         if (NULL != slave)
         {
-            if (slave->state == SYNC_STATE_SYNCED)
+            if (slave->compress_file_sending)
+            {
+                SendCompressedFileChunk(slave);
+            }
+            else if (slave->diskless && slave->state == SYNC_STATE_SYNCING_SNAPSHOT)
+            {
+                FeedDisklessSlave(slave);
+                ReleaseDisklessChunks();
+            }
+            else if (slave->state == SYNC_STATE_SYNCED)
             {
                 DEBUG_LOG("[Master]Slave sync from %lld to %llu at state:%u", slave->sync_offset, g_repl->GetReplLog().WALEndOffset(), slave->state);
                 SyncWAL(slave);
@@ -759,11 +1212,19 @@ OP_NAMESPACE_BEGIN
 
             uint32 lag = time(NULL) - slave->acktime;
             sprintf(buffer, "slave%u:%s,state=%s,"
-                    "offset=%" PRId64 ",ack_offset=%" PRId64",lag=%u,o_buffer_size=%u,o_buffer_capacity=%zu\r\n", i, slave->GetAddress().c_str(), state,
+                    "offset=%" PRId64 ",ack_offset=%" PRId64",lag=%u,o_buffer_size=%u,o_buffer_capacity=%zu", i, slave->GetAddress().c_str(), state,
                     slave->sync_offset, slave->ack_offset, lag, slave->conn->WritableBytes(), slave->conn->GetOutputBuffer().Capacity());
+            str.append(buffer);
+            if (COMPRESS_NONE != slave->compress)
+            {
+                sprintf(buffer, ",compress=%s,compress_in_bytes=%" PRIu64 ",compress_out_bytes=%" PRIu64 ",compress_ratio=%.2f,compress_cpu_usec=%" PRIu64,
+                        CompressFrameCodec::TypeName(slave->compress), slave->compress_stat.raw_bytes, slave->compress_stat.compressed_bytes,
+                        slave->compress_stat.Ratio(), slave->compress_stat.cost_micros);
+                str.append(buffer);
+            }
+            str.append("\r\n");
             it++;
             i++;
-            str.append(buffer);
         }
     }
 
@@ -772,6 +1233,19 @@ OP_NAMESPACE_BEGIN
         getSlaveContext(slave).port = port;
     }
 
+    void Master::SetSlaveCompress(Channel* slave, CompressType type)
+    {
+        getSlaveContext(slave).compress_requested = type;
+    }
+
+    void Master::SetSlaveCapa(Channel* slave, const std::string& capa)
+    {
+        if (!strcasecmp(capa.c_str(), "eof"))
+        {
+            getSlaveContext(slave).capa_eof = true;
+        }
+    }
+
     Master::~Master()
     {
     }
@@ -223,6 +223,24 @@ OP_NAMESPACE_BEGIN
         swal_replay(m_wal, offset, limit_len, func, data);
     }
 
+    int ReplicationBacklog::LogFD()
+    {
+        if (NULL == m_wal)
+        {
+            return -1;
+        }
+        return swal_log_fd(m_wal);
+    }
+
+    int ReplicationBacklog::LogFileRange(size_t offset, int64_t limit_len, size_t& file_pos, size_t& len)
+    {
+        if (NULL == m_wal)
+        {
+            return -1;
+        }
+        return swal_log_file_range(m_wal, offset, limit_len, &file_pos, &len);
+    }
+
     int ReplicationBacklog::WriteWAL(const Data& ns, RedisCommandFrame& cmd)
     {
         if (!g_repl->IsInited())
@@ -254,6 +272,23 @@ OP_NAMESPACE_BEGIN
         return 0;
     }
 
+    int ReplicationBacklog::WriteWAL(const Data& ns, const RedisCommandFrameArray& cmds)
+    {
+        if (!g_repl->IsInited())
+        {
+            return -1;
+        }
+        ReplCommand* repl_cmd = get_repl_cmd();
+        repl_cmd->ns = ns;
+        for (size_t i = 0; i < cmds.size(); i++)
+        {
+            RedisCommandEncoder::Encode(repl_cmd->cmdbuf, cmds[i]);
+        }
+        atomic_add_uint32(&m_wal_queue_size, 1);
+        g_repl->GetIOService().AsyncIO(0, WriteWALCallback, repl_cmd);
+        return 0;
+    }
+
     static size_t cksm_callback(const void* log, size_t loglen, void* data)
     {
         uint64_t* cksm = (uint64_t*) data;
@@ -72,7 +72,10 @@ OP_NAMESPACE_BEGIN
             bool IsReplKeySelfGen();
             void SetReplKey(const std::string& str);
             int WriteWAL(const Data& ns, RedisCommandFrame& cmd);
+            int WriteWAL(const Data& ns, const RedisCommandFrameArray& cmds);
             void Replay(size_t offset, int64_t limit_len, swal_replay_logfunc func, void* data);
+            int LogFD();
+            int LogFileRange(size_t offset, int64_t limit_len, size_t& file_pos, size_t& len);
             bool IsValidOffsetCksm(int64_t offset, uint64_t cksm);
             uint64_t WALStartOffset(bool lock = true);
             uint64_t WALEndOffset(bool lock = true);
@@ -105,12 +108,14 @@ OP_NAMESPACE_BEGIN
             time_t master_last_interaction_time;
             Snapshot snapshot;
             std::string snapshot_path;
+            bool diskless;
+            SnapshotStreamLoader snapshot_stream;
             void UpdateSyncOffsetCksm(const Buffer& buffer);
             void Clear();
             void ResetCallFlags();
             SlaveContext() :
                     server_is_redis(false), server_support_psync(false), state(0), cached_master_repl_offset(0), cached_master_repl_cksm(0), sync_repl_offset(
-                            0), sync_repl_cksm(0), cmd_recved_time(0), master_link_down_time(0), master_last_interaction_time(0)
+                            0), sync_repl_cksm(0), cmd_recved_time(0), master_link_down_time(0), master_last_interaction_time(0), diskless(false)
             {
             }
     };
@@ -128,6 +133,7 @@ OP_NAMESPACE_BEGIN
             void HandleRedisCommand(Channel* ch, RedisCommandFrame& cmd);
             void HandleRedisReply(Channel* ch, RedisReply& reply);
             void HandleRedisDumpChunk(Channel* ch, RedisDumpFileChunk& chunk);
+            void LoadSnapshotStream(Channel* ch, RedisDumpFileChunk& chunk);
             void HandleBackupSync(Channel* ch, DirSyncStatus& cmd);
             void MessageReceived(ChannelHandlerContext& ctx, MessageEvent<RedisMessage>& e);
             void ChannelClosed(ChannelHandlerContext& ctx, ChannelStateEvent& e);
@@ -158,6 +164,8 @@ OP_NAMESPACE_BEGIN
             int64 LoadLeftBytes();
             int64 SyncOffset();
             int64 SyncQueueSize();
+            bool IsLinkCompressed();
+            const CompressStat& LinkInflateStat();
             void SendACK();
 
     };
@@ -177,6 +185,9 @@ OP_NAMESPACE_BEGIN
             int64 m_sync_full_count;
             int64 m_sync_partial_ok_count;
             int64 m_sync_partial_err_count;
+            StreamSnapshot* m_diskless_snapshot;
+            time_t m_diskless_wait_since;
+            bool m_diskless_done;
 
             void ChannelClosed(ChannelHandlerContext& ctx, ChannelStateEvent& e);
             void ChannelWritable(ChannelHandlerContext& ctx, ChannelStateEvent& e);
@@ -185,6 +196,12 @@ OP_NAMESPACE_BEGIN
             void SyncSlave(SlaveSyncContext* slave);
             int SendBackupToSlave(SlaveSyncContext* slave);
             int SendSnapshotToSlave(SlaveSyncContext* slave);
+            int SendWALFileToSlave(SlaveSyncContext* slave);
+            int SendFileToSlave(SlaveSyncContext* slave, const SendFileSetting& setting);
+            void SendCompressedFileChunk(SlaveSyncContext* slave);
+            void StartDisklessSync();
+            void FeedDisklessSlave(SlaveSyncContext* slave);
+            void ReleaseDisklessChunks();
             bool IsAllSlaveSyncingCache();
             static void OnSnapshotBackupSendComplete(void* data);
             friend class ReplicationService;
@@ -195,10 +212,14 @@ OP_NAMESPACE_BEGIN
             void FullResyncSlaves(Snapshot* snapshot);
             void CloseSlaveBySnapshot(Snapshot* snapshot);
             void CloseSlave(SlaveSyncContext* slave);
+            void FeedDisklessSlaves();
+            void OnDisklessSnapshotDone(StreamSnapshot* snapshot);
 
             void AddSlave(SlaveSyncContext* slave);
             void AddSlave(Channel* slave, RedisCommandFrame& cmd);
             void SetSlavePort(Channel* slave, uint32 port);
+            void SetSlaveCompress(Channel* slave, CompressType type);
+            void SetSlaveCapa(Channel* slave, const std::string& capa);
             void SyncWAL(SlaveSyncContext* slave);
             size_t ConnectedSlaves();
             int64 FullSyncCount()
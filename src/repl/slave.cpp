@@ -138,6 +138,8 @@ OP_NAMESPACE_BEGIN
             snapshot.Remove();
         }
         snapshot.SetRoutineCallback(NULL, NULL);
+        diskless = false;
+        snapshot_stream.Reset();
     }
 
     Slave::Slave() :
@@ -437,7 +439,23 @@ OP_NAMESPACE_BEGIN
                     m_ctx.server_support_psync = true;
                 }
                 Buffer replconf;
-                replconf.Printf("replconf listening-port %u\r\n", g_db->GetConf().PrimaryPort());
+                CompressType compress = CompressFrameCodec::ParseType(g_db->GetConf().repl_compression);
+                if (!m_ctx.server_is_redis)
+                {
+                    /*
+                     * only ardb master support diskless sync with eof marked dump stream & compressed replication stream
+                     */
+                    replconf.Printf("replconf listening-port %u capa eof", g_db->GetConf().PrimaryPort());
+                    if (COMPRESS_NONE != compress)
+                    {
+                        replconf.Printf(" compress %s", CompressFrameCodec::TypeName(compress));
+                    }
+                    replconf.Printf("\r\n");
+                }
+                else
+                {
+                    replconf.Printf("replconf listening-port %u\r\n", g_db->GetConf().PrimaryPort());
+                }
                 m_ctx.state = SLAVE_STATE_WAITING_REPLCONF_REPLY;
                 ch->Write(replconf);
                 break;
@@ -488,6 +506,34 @@ OP_NAMESPACE_BEGIN
                 }
                 INFO_LOG("Recv psync reply:%s", reply.str.c_str());
                 std::vector<std::string> ss = split_string(reply.str, " ");
+                /*
+                 * master would append 'compress=<type>' if it accept the compression requested by slave,
+                 * all data after this reply are compressed frames.
+                 * 'diskless' means the snapshot would be streamed with eof mark instead of sending a dump file.
+                 */
+                bool diskless = false;
+                while (ss.size() > 1)
+                {
+                    std::string opt = ss[ss.size() - 1];
+                    if (has_prefix(opt, "compress="))
+                    {
+                        CompressType compress = CompressFrameCodec::ParseType(opt.substr(strlen("compress=")));
+                        if (COMPRESS_NONE != compress)
+                        {
+                            INFO_LOG("[Slave]Replication stream is compressed by %s.", CompressFrameCodec::TypeName(compress));
+                            m_decoder.SwitchToCompressedStream(g_db->GetConf().repl_compression_max_frame_size);
+                        }
+                    }
+                    else if (opt == "diskless")
+                    {
+                        diskless = true;
+                    }
+                    else
+                    {
+                        break;
+                    }
+                    ss.pop_back();
+                }
                 if (!strcasecmp(ss[0].c_str(), "FULLRESYNC") || !strcasecmp(ss[0].c_str(), "FULLBACKUP"))
                 {
                     int64 offset;
@@ -516,6 +562,7 @@ OP_NAMESPACE_BEGIN
                     }
 
                     m_ctx.state = SLAVE_STATE_WAITING_SNAPSHOT;
+                    m_ctx.diskless = diskless;
                     m_decoder.SwitchToDumpFileDecoder();
                     if (!strcasecmp(ss[0].c_str(), "FULLBACKUP"))
                     {
@@ -631,8 +678,55 @@ OP_NAMESPACE_BEGIN
         }
     }
 
+    void Slave::LoadSnapshotStream(Channel* ch, RedisDumpFileChunk& chunk)
+    {
+        if (chunk.IsFirstChunk())
+        {
+            m_ctx.snapshot_stream.Reset();
+            m_ctx.state = SLAVE_STATE_LOADING_SNAPSHOT;
+            /*
+             * same as loading synced snapshot file, reset repl key & wal offset before loading any data.
+             */
+            g_repl->GetReplLog().SetReplKey(random_hex_string(40));
+            g_repl->GetReplLog().ResetWALOffsetCksm(m_ctx.cached_master_repl_offset, m_ctx.cached_master_repl_cksm);
+            if (g_db->GetConf().slave_cleardb_before_fullresync)
+            {
+                g_db->FlushAll(m_ctx.ctx);
+            }
+            INFO_LOG("[Slave]Start loading snapshot stream from master.");
+        }
+        m_ctx.cmd_recved_time = time(NULL);
+        if (!chunk.chunk.empty() && 0 != m_ctx.snapshot_stream.Feed(chunk.chunk.data(), chunk.chunk.size()))
+        {
+            ERROR_LOG("Failed to load snapshot stream from master.");
+            ch->Close();
+            return;
+        }
+        if (chunk.IsLastChunk())
+        {
+            if (!m_ctx.snapshot_stream.IsComplete())
+            {
+                ERROR_LOG("Snapshot stream is truncated after %llu bytes loaded.", m_ctx.snapshot_stream.LoadedBytes());
+                ch->Close();
+                return;
+            }
+            m_ctx.snapshot_stream.Reset();
+            m_decoder.SwitchToCommandDecoder();
+            g_repl->GetReplLog().SetReplKey(m_ctx.cached_master_runid);
+            m_ctx.sync_repl_offset = m_ctx.cached_master_repl_offset;
+            m_ctx.sync_repl_cksm = m_ctx.cached_master_repl_cksm;
+            m_ctx.state = SLAVE_STATE_REPLAYING_WAL;
+            ReplayWAL();
+        }
+    }
+
     void Slave::HandleRedisDumpChunk(Channel* ch, RedisDumpFileChunk& chunk)
     {
+        if (m_ctx.diskless && (m_ctx.state == SLAVE_STATE_WAITING_SNAPSHOT || m_ctx.state == SLAVE_STATE_LOADING_SNAPSHOT))
+        {
+            LoadSnapshotStream(ch, chunk);
+            return;
+        }
         if (m_ctx.state != SLAVE_STATE_WAITING_SNAPSHOT)
         {
             ERROR_LOG("Invalid state:%s to handler redis dump file chunk.", state2String(m_ctx.state));
@@ -753,6 +847,15 @@ OP_NAMESPACE_BEGIN
         return m_ctx.snapshot.ProcessLeftDataSize();
     }
 
+    bool Slave::IsLinkCompressed()
+    {
+        return NULL != m_client && m_decoder.IsCompressedStream();
+    }
+    const CompressStat& Slave::LinkInflateStat()
+    {
+        return m_decoder.GetInflateStat();
+    }
+
     bool Slave::IsSynced()
     {
         return NULL != m_client && SLAVE_STATE_SYNCED == m_ctx.state;
@@ -2595,7 +2595,13 @@ namespace ardb
         int err = 0;
         if (type != BACKUP_DUMP)
         {
-            err = OpenWriteFile(file);
+            /*
+             * empty file path means the dump would be written into a stream(diskless sync)
+             */
+            if (!file.empty())
+            {
+                err = OpenWriteFile(file);
+            }
         }
         else
         {
@@ -3395,27 +3401,61 @@ namespace ardb
         struct BGTask: public Thread
         {
                 std::string path;
+                std::string base_path;
                 int err;
-                bool complete;
+                volatile bool pinned;
+                volatile bool complete;
+                ThreadMutexLock state_cond;
 
-                BGTask(const std::string& f)
-                        : path(f), err(0), complete(false)
+                BGTask(const std::string& f, const std::string& base)
+                        : path(f), base_path(base), err(0), pinned(false), complete(false)
                 {
                 }
+                static void OnPinned(void* data)
+                {
+                    BGTask* task = (BGTask*) data;
+                    LockGuard<ThreadMutexLock> guard(task->state_cond);
+                    task->pinned = true;
+                    task->state_cond.NotifyAll();
+                }
                 void Run()
                 {
                     Context dumpctx;
-                    err = g_engine->Backup(dumpctx, path);
+                    if (g_engine->GetFeatureSet().support_checkpoint)
+                    {
+                        err = g_engine->Checkpoint(dumpctx, path, base_path, OnPinned, this);
+                    }
+                    else
+                    {
+                        err = g_engine->Backup(dumpctx, path);
+                    }
+                    LockGuard<ThreadMutexLock> guard(state_cond);
                     complete = true;
+                    state_cond.NotifyAll();
                 }
         };
-        BGTask task(m_file_path);
+        BGTask task(m_file_path, g_snapshot_manager->LatestBackupPath());
         task.Start();
-        /*
-         * Wait 1s to make sure the backup operation start,
-         * and after backup started, we can open write latch again
-         */
-        Thread::Sleep(1000);
+        if (g_engine->GetFeatureSet().support_checkpoint)
+        {
+            /*
+             * Open write latch right after the checkpoint pinned its file set, so that the
+             * cached wal offset/cksm is exactly matched with the checkpoint.
+             */
+            LockGuard<ThreadMutexLock> guard(task.state_cond);
+            while (!task.pinned && !task.complete)
+            {
+                task.state_cond.Wait();
+            }
+        }
+        else
+        {
+            /*
+             * Wait 1s to make sure the backup operation start,
+             * and after backup started, we can open write latch again
+             */
+            Thread::Sleep(1000);
+        }
         g_db->OpenWriteLatchAfterSnapshotPrepare();
         while (!task.complete)
         {
@@ -3495,6 +3535,364 @@ namespace ardb
         return task.err;
     }
 
+    /*
+     * chunks are pushed to consumer at least 64KB to avoid too many notifications.
+     */
+    static const size_t kstream_chunk_size = 64 * 1024;
+
+    StreamSnapshot::StreamSnapshot(size_t max_buffer_bytes)
+            : m_chunks_base(0), m_chunks_bytes(0), m_max_buffer_bytes(max_buffer_bytes), m_aborted(false), m_complete(false)
+    {
+    }
+
+    int64_t StreamSnapshot::WriteSeek(int64_t pos)
+    {
+        /*
+         * a stream can not be seeked back
+         */
+        return -1;
+    }
+    int64_t StreamSnapshot::GetWritePos()
+    {
+        return m_writed_data_size;
+    }
+
+    int StreamSnapshot::Write(const void* buf, size_t buflen)
+    {
+        if (m_aborted)
+        {
+            ERROR_LOG("Snapshot stream is aborted while writing.");
+            return -1;
+        }
+        m_cksm = crc64(m_cksm, (const unsigned char *) buf, buflen);
+        m_writed_data_size += buflen;
+        m_pending.Write(buf, buflen);
+        if (m_pending.ReadableBytes() >= kstream_chunk_size)
+        {
+            return PushChunk();
+        }
+        return 0;
+    }
+
+    int StreamSnapshot::PushChunk()
+    {
+        if (m_pending.Readable())
+        {
+            Buffer* chunk = NULL;
+            NEW(chunk, Buffer(m_pending.ReadableBytes()));
+            chunk->Write(m_pending.GetRawReadBuffer(), m_pending.ReadableBytes());
+            m_pending.Clear();
+            {
+                LockGuard<ThreadMutexLock> guard(m_chunks_lock);
+                m_chunks.push_back(chunk);
+                m_chunks_bytes += chunk->ReadableBytes();
+            }
+            if (NULL != m_routine_cb && 0 != m_routine_cb(DUMPING, this, m_routine_cbdata))
+            {
+                m_aborted = true;
+            }
+        }
+        /*
+         * block the dump thread until slaves consumed enough chunks, woken by ReleaseChunks once the slave
+         * connections drained their output, or by Abort.
+         */
+        {
+            LockGuard<ThreadMutexLock> guard(m_chunks_lock);
+            while (!m_aborted && m_chunks_bytes >= m_max_buffer_bytes)
+            {
+                m_chunks_lock.Wait(100);
+            }
+        }
+        return m_aborted ? -1 : 0;
+    }
+
+    int StreamSnapshot::BGStream(SnapshotRoutine* cb, void *data)
+    {
+        int ret = PrepareSave(ARDB_DUMP, "", cb, data);
+        if (0 != ret)
+        {
+            return ret;
+        }
+        struct BGTask: public Thread
+        {
+                StreamSnapshot* snapshot;
+                BGTask(StreamSnapshot* s)
+                        : snapshot(s)
+                {
+                }
+                void Run()
+                {
+                    uint64 start = get_current_epoch_millis();
+                    int ret = snapshot->ArdbSave();
+                    if (0 == ret)
+                    {
+                        ret = snapshot->PushChunk();
+                    }
+                    uint64 dump_bytes = snapshot->m_writed_data_size;
+                    snapshot->Close();
+                    snapshot->m_complete = (0 == ret);
+                    snapshot->m_state = ret == 0 ? DUMP_SUCCESS : DUMP_FAIL;
+                    if (0 == ret)
+                    {
+                        INFO_LOG("Cost %llums to stream %llu bytes snapshot.", get_current_epoch_millis() - start, dump_bytes);
+                    }
+                    else
+                    {
+                        WARN_LOG("Failed to stream snapshot with err:%d", ret);
+                    }
+                    /*
+                     * the snapshot may be destroyed by the callback, do not touch it after this.
+                     */
+                    if (NULL != snapshot->m_routine_cb)
+                    {
+                        snapshot->m_routine_cb(snapshot->m_state, snapshot, snapshot->m_routine_cbdata);
+                    }
+                    delete this;
+                }
+        };
+        BGTask* task = new BGTask(this);
+        task->Start();
+        return 0;
+    }
+
+    uint64 StreamSnapshot::ChunkEnd()
+    {
+        LockGuard<ThreadMutexLock> guard(m_chunks_lock);
+        return m_chunks_base + m_chunks.size();
+    }
+
+    const Buffer* StreamSnapshot::GetChunk(uint64 seq)
+    {
+        LockGuard<ThreadMutexLock> guard(m_chunks_lock);
+        if (seq < m_chunks_base || seq >= m_chunks_base + m_chunks.size())
+        {
+            return NULL;
+        }
+        return m_chunks[seq - m_chunks_base];
+    }
+
+    void StreamSnapshot::ReleaseChunks(uint64 seq)
+    {
+        LockGuard<ThreadMutexLock> guard(m_chunks_lock);
+        while (m_chunks_base < seq && !m_chunks.empty())
+        {
+            Buffer* chunk = m_chunks.front();
+            m_chunks_bytes -= chunk->ReadableBytes();
+            DELETE(chunk);
+            m_chunks.pop_front();
+            m_chunks_base++;
+        }
+        m_chunks_lock.NotifyAll();
+    }
+
+    void StreamSnapshot::Abort()
+    {
+        LockGuard<ThreadMutexLock> guard(m_chunks_lock);
+        m_aborted = true;
+        m_chunks_lock.NotifyAll();
+    }
+
+    StreamSnapshot::~StreamSnapshot()
+    {
+        ReleaseChunks(ChunkEnd());
+    }
+
+    SnapshotStreamLoader::SnapshotStreamLoader()
+            : m_cksm(0), m_loaded_bytes(0), m_started(false), m_header_loaded(false), m_complete(false), m_short_read(false)
+    {
+        m_loadctx.flags.no_fill_reply = 1;
+        m_loadctx.flags.no_wal = 1;
+        m_loadctx.flags.create_if_notexist = 1;
+        m_loadctx.flags.bulk_loading = 1;
+    }
+
+    bool SnapshotStreamLoader::Read(void* buf, size_t buflen, bool cksm)
+    {
+        if (m_buffer.ReadableBytes() < buflen)
+        {
+            m_short_read = true;
+            return false;
+        }
+        m_buffer.Read(buf, buflen);
+        return true;
+    }
+    int SnapshotStreamLoader::Write(const void* buf, size_t buflen)
+    {
+        return -1;
+    }
+    int64_t SnapshotStreamLoader::WriteSeek(int64_t pos)
+    {
+        return -1;
+    }
+    int64_t SnapshotStreamLoader::GetWritePos()
+    {
+        return -1;
+    }
+
+    int SnapshotStreamLoader::LoadRecord()
+    {
+        if (!m_header_loaded)
+        {
+            char buf[9];
+            if (!Read(buf, 8, true)) return -1;
+            buf[8] = '\0';
+            if (memcmp(buf, "ARDB", 4) != 0)
+            {
+                WARN_LOG("Wrong signature:%s trying to load DB from stream.", buf);
+                return -1;
+            }
+            int rdbver = atoi(buf + 4);
+            if (rdbver < 1 || rdbver > ARDB_RDB_VERSION)
+            {
+                WARN_LOG("Can't handle ARDB format version %d", rdbver);
+                return -1;
+            }
+            m_header_loaded = true;
+            return 0;
+        }
+        int type = ReadType();
+        if (-1 == type) return -1;
+        if (type == ARDB_RDB_TYPE_EOF)
+        {
+            unsigned char eof = ARDB_RDB_TYPE_EOF;
+            uint64_t cksum, expected = crc64(m_cksm, &eof, 1);
+            if (!Read(&cksum, 8, true)) return -1;
+            memrev64ifbe(&cksum);
+            if (cksum != 0 && cksum != expected)
+            {
+                ERROR_LOG("Wrong snapshot stream checksum.(%llu-%llu)", cksum, expected);
+                return -1;
+            }
+            m_complete = true;
+        }
+        else if (type == ARDB_RDB_OPCODE_SELECTDB)
+        {
+            std::string ns;
+            if (!ReadString(ns)) return -1;
+            m_loadctx.ns.SetString(ns, false);
+        }
+        else if (type == ARDB_OPCODE_AUX)
+        {
+            std::string aux_key, aux_val;
+            if (!ReadString(aux_key) || !ReadString(aux_val)) return -1;
+            INFO_LOG("Snapshot aux info: %s=%s", aux_key.c_str(), aux_val.c_str());
+        }
+        else if (type == ARDB_RDB_TYPE_CHUNK)
+        {
+            uint32 len = ReadLen(NULL);
+            if (m_short_read) return -1;
+            if (m_buffer.ReadableBytes() < len)
+            {
+                m_short_read = true;
+                return -1;
+            }
+            Buffer chunk(const_cast<char*>(m_buffer.GetRawReadBuffer()), 0, len);
+            m_buffer.AdvanceReadIndex(len);
+            RETURN_NEGATIVE_EXPR(ArdbLoadBuffer(m_loadctx, chunk));
+        }
+        else if (type == ARDB_RDB_TYPE_SNAPPY_CHUNK)
+        {
+            uint32 rawlen = ReadLen(NULL);
+            uint32 compressedlen = ReadLen(NULL);
+            if (m_short_read) return -1;
+            if (m_buffer.ReadableBytes() < compressedlen)
+            {
+                m_short_read = true;
+                return -1;
+            }
+            std::string origin;
+            origin.reserve(rawlen);
+            if (!snappy::Uncompress(m_buffer.GetRawReadBuffer(), compressedlen, &origin))
+            {
+                ERROR_LOG("Failed to decompress snappy chunk.");
+                return -1;
+            }
+            m_buffer.AdvanceReadIndex(compressedlen);
+            Buffer chunk(const_cast<char*>(origin.data()), 0, origin.size());
+            RETURN_NEGATIVE_EXPR(ArdbLoadBuffer(m_loadctx, chunk));
+        }
+        else
+        {
+            ERROR_LOG("Invalid type:%d.", type);
+            return -1;
+        }
+        return 0;
+    }
+
+    int SnapshotStreamLoader::Feed(const char* data, size_t len)
+    {
+        if (m_complete)
+        {
+            return 0;
+        }
+        if (!m_started)
+        {
+            g_engine->BeginBulkLoad(m_loadctx);
+            m_started = true;
+        }
+        m_buffer.Write(data, len);
+        while (!m_complete)
+        {
+            /*
+             * rollback to record start if the record is not completely received.
+             */
+            size_t record_start = m_buffer.GetReadIndex();
+            m_short_read = false;
+            if (0 != LoadRecord())
+            {
+                if (m_short_read)
+                {
+                    m_buffer.SetReadIndex(record_start);
+                    break;
+                }
+                ERROR_LOG("Failed to load snapshot stream at offset:%llu", m_loaded_bytes);
+                return -1;
+            }
+            size_t record_len = m_buffer.GetReadIndex() - record_start;
+            m_cksm = crc64(m_cksm, (const unsigned char *) (m_buffer.GetRawBuffer() + record_start), record_len);
+            if ((m_loaded_bytes + record_len) / kloading_process_events_interval_bytes > m_loaded_bytes / kloading_process_events_interval_bytes)
+            {
+                INFO_LOG("%llu bytes loaded from snapshot stream.", m_loaded_bytes + record_len);
+            }
+            m_loaded_bytes += record_len;
+        }
+        m_buffer.DiscardReadedBytes();
+        if (m_complete)
+        {
+            g_engine->FlushAll(m_loadctx);
+            g_engine->EndBulkLoad(m_loadctx);
+            m_started = false;
+            INFO_LOG("All data load successfully from snapshot stream with %llu bytes.", m_loaded_bytes);
+            if (g_db->GetConf().compact_after_snapshot_load)
+            {
+                g_db->CompactAll(m_loadctx);
+            }
+        }
+        return 0;
+    }
+
+    void SnapshotStreamLoader::Reset()
+    {
+        if (m_started)
+        {
+            g_engine->EndBulkLoad(m_loadctx);
+            m_started = false;
+        }
+        m_buffer.Clear();
+        m_buffer.Compact(256);
+        m_cksm = 0;
+        m_loaded_bytes = 0;
+        m_header_loaded = false;
+        m_complete = false;
+        m_short_read = false;
+        m_loadctx.ns.Clear();
+    }
+
+    SnapshotStreamLoader::~SnapshotStreamLoader()
+    {
+        Reset();
+    }
+
     static SnapshotManager g_snapshot_manager_instance;
     SnapshotManager* g_snapshot_manager = &g_snapshot_manager_instance;
 
@@ -3654,6 +4052,22 @@ namespace ardb
         return NULL;
     }
 
+    std::string SnapshotManager::LatestBackupPath()
+    {
+        LockGuard<ThreadMutexLock> guard(m_snapshots_lock);
+        SnapshotArray::reverse_iterator it = m_snapshots.rbegin();
+        while (it != m_snapshots.rend())
+        {
+            Snapshot* s = *it;
+            if (s->GetType() == BACKUP_DUMP && s->IsReady())
+            {
+                return s->GetPath();
+            }
+            it++;
+        }
+        return "";
+    }
+
     Snapshot* SnapshotManager::GetSyncSnapshot(SnapshotType type, SnapshotRoutine* cb, void *data)
     {
         LockGuard<ThreadMutexLock> guard(m_snapshots_lock);
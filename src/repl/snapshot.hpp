@@ -242,6 +242,79 @@ namespace ardb
             static std::string GetSyncSnapshotPath(SnapshotType type, uint64 offset, uint64 cksm);
     };
 
+    /*
+     * Snapshot for diskless full resync, the ardb dump is written into in-memory chunks instead of a file.
+     * Chunks are produced by a background thread & consumed by the replication thread, the producer would
+     * be blocked if the buffered chunks exceed the limit.
+     */
+    class StreamSnapshot: public Snapshot
+    {
+        private:
+            typedef std::deque<Buffer*> ChunkQueue;
+            ThreadMutexLock m_chunks_lock;
+            ChunkQueue m_chunks;
+            uint64 m_chunks_base;
+            size_t m_chunks_bytes;
+            size_t m_max_buffer_bytes;
+            Buffer m_pending;
+            volatile bool m_aborted;
+            volatile bool m_complete;
+            int PushChunk();
+            int64_t WriteSeek(int64_t pos);
+            int64_t GetWritePos();
+        public:
+            StreamSnapshot(size_t max_buffer_bytes);
+            int Write(const void* buf, size_t buflen);
+            int BGStream(SnapshotRoutine* cb, void *data);
+            /*
+             * all chunks are produced, 'ChunkEnd' would not change anymore.
+             */
+            bool IsStreamComplete()
+            {
+                return m_complete;
+            }
+            uint64 ChunkEnd();
+            const Buffer* GetChunk(uint64 seq);
+            void ReleaseChunks(uint64 seq);
+            void Abort();
+            ~StreamSnapshot();
+    };
+
+    /*
+     * Incremental loader for ardb dump stream, the data could be fed in any size, records are loaded
+     * as soon as they are completely received.
+     */
+    class SnapshotStreamLoader: public ObjectIO
+    {
+        private:
+            Buffer m_buffer;
+            Context m_loadctx;
+            uint64 m_cksm;
+            uint64 m_loaded_bytes;
+            bool m_started;
+            bool m_header_loaded;
+            bool m_complete;
+            bool m_short_read;
+            bool Read(void* buf, size_t buflen, bool cksm);
+            int Write(const void* buf, size_t buflen);
+            int64_t WriteSeek(int64_t pos);
+            int64_t GetWritePos();
+            int LoadRecord();
+        public:
+            SnapshotStreamLoader();
+            int Feed(const char* data, size_t len);
+            bool IsComplete()
+            {
+                return m_complete;
+            }
+            uint64 LoadedBytes()
+            {
+                return m_loaded_bytes;
+            }
+            void Reset();
+            ~SnapshotStreamLoader();
+    };
+
     class SnapshotManager
     {
         private:
@@ -255,6 +328,7 @@ namespace ardb
             Snapshot* GetSyncSnapshot(SnapshotType type, SnapshotRoutine* cb, void *data);
             Snapshot* NewSnapshot(SnapshotType type, bool bgsave, SnapshotRoutine* cb, void *data);
             void AddSnapshot(const std::string& path);
+            std::string LatestBackupPath();
             time_t LastSave();
             int CurrentSaverNum();
             time_t LastSaveCost();
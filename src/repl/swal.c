@@ -378,6 +378,43 @@ int swal_clear_replay_cache(swal_t* wal)
     }
     return 0;
 }
+int swal_log_fd(swal_t* wal)
+{
+    return wal->fd;
+}
+/*
+ * Map a log offset to the file position of the continuous log data start from it,
+ * the returned range never wraps around the end of the log file.
+ */
+int swal_log_file_range(swal_t* wal, size_t offset, int64_t limit_len, size_t* file_pos, size_t* len)
+{
+    if (offset < wal->meta->log_start_offset || offset > wal->meta->log_end_offset)
+    {
+        return -1;
+    }
+    size_t data_len = wal->meta->log_end_offset - offset;
+    size_t start_pos;
+    if (wal->meta->log_file_pos >= data_len)
+    {
+        start_pos = wal->meta->log_file_pos - data_len;
+    }
+    else
+    {
+        start_pos = wal->options.max_file_size - data_len + wal->meta->log_file_pos;
+    }
+    size_t total = data_len;
+    if (total > wal->options.max_file_size - start_pos)
+    {
+        total = wal->options.max_file_size - start_pos;
+    }
+    if (limit_len > 0 && limit_len < total)
+    {
+        total = limit_len;
+    }
+    *file_pos = start_pos;
+    *len = total;
+    return 0;
+}
 int swal_reset(swal_t* wal, size_t offset, uint64_t cksm)
 {
     swal_clear_replay_cache(wal);
@@ -67,6 +67,8 @@ extern "C"
     typedef size_t swal_replay_logfunc(const void* log, size_t loglen, void* data);
     int swal_replay(swal_t* wal, size_t offset, int64_t limit_len, swal_replay_logfunc func, void* data);
     int swal_clear_replay_cache(swal_t* wal);
+    int swal_log_fd(swal_t* wal);
+    int swal_log_file_range(swal_t* wal, size_t offset, int64_t limit_len, size_t* file_pos, size_t* len);
     int swal_reset(swal_t* wal, size_t offset, uint64_t cksm);
     uint64_t swal_cksm(swal_t* wal);
     size_t swal_start_offset(swal_t* wal);
@@ -0,0 +1,504 @@
+/*
+ *Copyright (c) 2013-2016, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * ardb-bench: closed-loop load generator driving an embedded Ardb instance.
+ * Every worker thread issues 'pipeline' commands back to back and waits for all of them before the next batch,
+ * the batch latency is recorded for each command in it(same as redis-benchmark does).
+ */
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include "util/time_helper.hpp"
+#include "util/string_helper.hpp"
+#include "thread/thread.hpp"
+#include "db/db.hpp"
+
+using namespace ardb;
+
+enum BenchDataType
+{
+    BENCH_STRING = 0, BENCH_HASH, BENCH_LIST, BENCH_SET, BENCH_ZSET, BENCH_TYPE_MAX
+};
+static const char* kBenchTypeNames[] = { "string", "hash", "list", "set", "zset" };
+
+struct BenchOptions
+{
+        std::string conf;
+        uint32 threads;
+        uint64 requests;
+        uint32 pipeline;
+        uint64 keyspace;
+        uint32 key_size;
+        uint32 value_min;
+        uint32 value_max;
+        double read_ratio;
+        double zipf_theta;
+        bool preload;
+        uint64 seed;
+        std::vector<BenchDataType> types;
+        BenchOptions()
+                : conf("../ardb.conf"), threads(4), requests(100000), pipeline(1), keyspace(10000), key_size(16), value_min(
+                        64), value_max(64), read_ratio(0.8), zipf_theta(0), preload(false), seed(1234)
+        {
+        }
+};
+
+/*
+ * xorshift64* generator, one per worker so threads never share random state.
+ */
+struct BenchRandom
+{
+        uint64 state;
+        BenchRandom(uint64 seed)
+                : state(seed == 0 ? 0x9E3779B97F4A7C15ULL : seed)
+        {
+        }
+        uint64 Next()
+        {
+            state ^= state >> 12;
+            state ^= state << 25;
+            state ^= state >> 27;
+            return state * 2685821657736338717ULL;
+        }
+        double NextDouble()
+        {
+            return (Next() >> 11) * (1.0 / 9007199254740992.0);
+        }
+};
+
+/*
+ * Zipfian key generator from "Quickly Generating Billion-Record Synthetic Databases" (Gray et al.),
+ * theta == 0 degrades to uniform keys.
+ */
+class ZipfGenerator
+{
+    private:
+        uint64 m_items;
+        double m_theta;
+        double m_zetan;
+        double m_alpha;
+        double m_eta;
+    public:
+        ZipfGenerator(uint64 items, double theta)
+                : m_items(items), m_theta(theta), m_zetan(0), m_alpha(0), m_eta(0)
+        {
+            if (m_theta <= 0)
+            {
+                return;
+            }
+            for (uint64 i = 1; i <= m_items; i++)
+            {
+                m_zetan += 1.0 / pow((double) i, m_theta);
+            }
+            double zeta2 = 1.0 + 1.0 / pow(2.0, m_theta);
+            m_alpha = 1.0 / (1.0 - m_theta);
+            m_eta = (1.0 - pow(2.0 / m_items, 1.0 - m_theta)) / (1.0 - zeta2 / m_zetan);
+        }
+        uint64 Next(BenchRandom& rnd) const
+        {
+            if (m_theta <= 0)
+            {
+                return rnd.Next() % m_items;
+            }
+            double u = rnd.NextDouble();
+            double uz = u * m_zetan;
+            if (uz < 1.0)
+            {
+                return 0;
+            }
+            if (uz < 1.0 + pow(0.5, m_theta))
+            {
+                return 1;
+            }
+            uint64 v = (uint64) (m_items * pow(m_eta * u - m_eta + 1, m_alpha));
+            return v >= m_items ? m_items - 1 : v;
+        }
+};
+
+struct BenchResult
+{
+        std::vector<uint32> read_latency;
+        std::vector<uint32> write_latency;
+        uint64 errors;
+        BenchResult()
+                : errors(0)
+        {
+        }
+};
+
+static void bench_key(const BenchOptions& options, BenchDataType type, uint64 idx, std::string& key)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), "bench:%s:%llu", kBenchTypeNames[type], (unsigned long long) idx);
+    key = buf;
+    if (key.size() < options.key_size)
+    {
+        key.append(options.key_size - key.size(), 'x');
+    }
+}
+
+static void bench_command(const BenchOptions& options, BenchRandom& rnd, BenchDataType type, uint64 idx, bool read,
+        RedisCommandFrame& cmd)
+{
+    std::string key, member, value;
+    bench_key(options, type, idx, key);
+    member = "m" + stringfromll(rnd.Next() % 128);
+    if (!read)
+    {
+        uint32 vlen = options.value_min;
+        if (options.value_max > options.value_min)
+        {
+            vlen += rnd.Next() % (options.value_max - options.value_min + 1);
+        }
+        value.assign(vlen, 'v');
+    }
+    cmd.Clear();
+    switch (type)
+    {
+        case BENCH_STRING:
+        {
+            cmd.SetCommand(read ? "get" : "set");
+            cmd.AddArg(key);
+            if (!read)
+            {
+                cmd.AddArg(value);
+            }
+            break;
+        }
+        case BENCH_HASH:
+        {
+            cmd.SetCommand(read ? "hget" : "hset");
+            cmd.AddArg(key);
+            cmd.AddArg(member);
+            if (!read)
+            {
+                cmd.AddArg(value);
+            }
+            break;
+        }
+        case BENCH_LIST:
+        {
+            cmd.SetCommand(read ? "lrange" : "lpush");
+            cmd.AddArg(key);
+            if (read)
+            {
+                cmd.AddArg("0");
+                cmd.AddArg("9");
+            }
+            else
+            {
+                cmd.AddArg(value);
+            }
+            break;
+        }
+        case BENCH_SET:
+        {
+            cmd.SetCommand(read ? "sismember" : "sadd");
+            cmd.AddArg(key);
+            cmd.AddArg(read ? member : member + value);
+            break;
+        }
+        case BENCH_ZSET:
+        {
+            cmd.SetCommand(read ? "zscore" : "zadd");
+            cmd.AddArg(key);
+            if (!read)
+            {
+                cmd.AddArg(stringfromll(rnd.Next() % 1000000));
+            }
+            cmd.AddArg(member);
+            break;
+        }
+        default:
+        {
+            break;
+        }
+    }
+}
+
+class BenchWorker: public Thread
+{
+    private:
+        Ardb& m_db;
+        const BenchOptions& m_options;
+        const ZipfGenerator& m_keys;
+        uint64 m_requests;
+        uint32 m_id;
+    public:
+        BenchResult result;
+        BenchWorker(Ardb& db, const BenchOptions& options, const ZipfGenerator& keys, uint64 requests, uint32 id)
+                : m_db(db), m_options(options), m_keys(keys), m_requests(requests), m_id(id)
+        {
+        }
+        void Run()
+        {
+            BenchRandom rnd(m_options.seed + m_id * 7919);
+            Context ctx;
+            std::vector<RedisCommandFrame> batch(m_options.pipeline);
+            std::vector<bool> reads(m_options.pipeline);
+            result.read_latency.reserve(m_requests);
+            result.write_latency.reserve(m_requests);
+            uint64 done = 0;
+            while (done < m_requests)
+            {
+                uint32 n = 0;
+                while (n < m_options.pipeline && done + n < m_requests)
+                {
+                    BenchDataType type = m_options.types[rnd.Next() % m_options.types.size()];
+                    reads[n] = rnd.NextDouble() < m_options.read_ratio;
+                    bench_command(m_options, rnd, type, m_keys.Next(rnd), reads[n], batch[n]);
+                    n++;
+                }
+                uint64 start = get_current_epoch_micros();
+                for (uint32 i = 0; i < n; i++)
+                {
+                    ctx.GetReply().Clear();
+                    m_db.Call(ctx, batch[i]);
+                    if (ctx.GetReply().IsErr())
+                    {
+                        result.errors++;
+                    }
+                }
+                uint32 cost = (uint32) (get_current_epoch_micros() - start);
+                for (uint32 i = 0; i < n; i++)
+                {
+                    (reads[i] ? result.read_latency : result.write_latency).push_back(cost);
+                }
+                done += n;
+            }
+        }
+};
+
+static void print_latency(const char* name, std::vector<uint32>& samples, double seconds, bool last)
+{
+    std::sort(samples.begin(), samples.end());
+    size_t n = samples.size();
+    uint32 p50 = 0, p90 = 0, p99 = 0, p999 = 0, max = 0;
+    if (n > 0)
+    {
+        p50 = samples[(size_t) (n * 0.5)];
+        p90 = samples[(size_t) (n * 0.9)];
+        p99 = samples[(size_t) (n * 0.99)];
+        p999 = samples[(size_t) (n * 0.999)];
+        max = samples[n - 1];
+    }
+    printf("\"%s\":{\"count\":%llu,\"ops_per_sec\":%.2f,\"latency_us\":{\"p50\":%u,\"p90\":%u,\"p99\":%u,\"p999\":%u,\"max\":%u}}%s",
+            name, (unsigned long long) n, seconds > 0 ? n / seconds : 0, p50, p90, p99, p999, max, last ? "" : ",");
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: ./ardb-bench [options]\n");
+    fprintf(stderr, "  -c <conf>          Ardb config file of the embedded instance (default ../ardb.conf)\n");
+    fprintf(stderr, "  -t <threads>       Worker threads (default 4)\n");
+    fprintf(stderr, "  -n <requests>      Total requests (default 100000)\n");
+    fprintf(stderr, "  -P <pipeline>      Commands issued back to back per batch (default 1)\n");
+    fprintf(stderr, "  -r <keyspace>      Number of distinct keys per data type (default 10000)\n");
+    fprintf(stderr, "  -k <size>          Key size in bytes (default 16)\n");
+    fprintf(stderr, "  -d <min>[-<max>]   Value size, uniformly distributed in [min, max] (default 64)\n");
+    fprintf(stderr, "  -w <types>         Comma separated data types: string,hash,list,set,zset (default string)\n");
+    fprintf(stderr, "  --read-ratio <r>   Fraction of read commands (default 0.8)\n");
+    fprintf(stderr, "  --zipf <theta>     Zipfian key skew, 0 for uniform keys (default 0)\n");
+    fprintf(stderr, "  --seed <n>         Random seed (default 1234)\n");
+    fprintf(stderr, "  --preload          Write every key once before the run\n");
+    fprintf(stderr, "The storage engine is the one ardb-bench was built with(make storage_engine=...).\n");
+    fprintf(stderr, "Results are printed as one JSON object on stdout.\n");
+    exit(1);
+}
+
+static bool parse_types(const std::string& arg, std::vector<BenchDataType>& types)
+{
+    std::vector<std::string> ss = split_string(arg, ",");
+    types.clear();
+    for (size_t i = 0; i < ss.size(); i++)
+    {
+        bool found = false;
+        for (int t = 0; t < BENCH_TYPE_MAX; t++)
+        {
+            if (!strcasecmp(ss[i].c_str(), kBenchTypeNames[t]))
+            {
+                types.push_back((BenchDataType) t);
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            return false;
+        }
+    }
+    return !types.empty();
+}
+
+int main(int argc, char** argv)
+{
+    BenchOptions options;
+    options.types.push_back(BENCH_STRING);
+    for (int i = 1; i < argc; i++)
+    {
+        bool has_value = i + 1 < argc;
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help")
+        {
+            usage();
+        }
+        else if (arg == "--preload")
+        {
+            options.preload = true;
+        }
+        else if (!has_value)
+        {
+            usage();
+        }
+        else if (arg == "-c")
+        {
+            options.conf = argv[++i];
+        }
+        else if (arg == "-t")
+        {
+            options.threads = strtoul(argv[++i], NULL, 10);
+        }
+        else if (arg == "-n")
+        {
+            options.requests = strtoull(argv[++i], NULL, 10);
+        }
+        else if (arg == "-P")
+        {
+            options.pipeline = strtoul(argv[++i], NULL, 10);
+        }
+        else if (arg == "-r")
+        {
+            options.keyspace = strtoull(argv[++i], NULL, 10);
+        }
+        else if (arg == "-k")
+        {
+            options.key_size = strtoul(argv[++i], NULL, 10);
+        }
+        else if (arg == "-d")
+        {
+            char* end = NULL;
+            options.value_min = strtoul(argv[++i], &end, 10);
+            options.value_max = (NULL != end && *end == '-') ? strtoul(end + 1, NULL, 10) : options.value_min;
+        }
+        else if (arg == "-w")
+        {
+            if (!parse_types(argv[++i], options.types))
+            {
+                usage();
+            }
+        }
+        else if (arg == "--read-ratio")
+        {
+            options.read_ratio = atof(argv[++i]);
+        }
+        else if (arg == "--zipf")
+        {
+            options.zipf_theta = atof(argv[++i]);
+        }
+        else if (arg == "--seed")
+        {
+            options.seed = strtoull(argv[++i], NULL, 10);
+        }
+        else
+        {
+            usage();
+        }
+    }
+    if (options.threads == 0 || options.pipeline == 0 || options.keyspace == 0 || options.value_max < options.value_min
+            || options.zipf_theta >= 1)
+    {
+        usage();
+    }
+
+    Ardb db;
+    if (db.Init(options.conf) != 0)
+    {
+        fprintf(stderr, "Failed to init db with config:%s\n", options.conf.c_str());
+        return -1;
+    }
+    if (options.preload)
+    {
+        Context ctx;
+        BenchRandom rnd(options.seed);
+        RedisCommandFrame cmd;
+        for (size_t t = 0; t < options.types.size(); t++)
+        {
+            for (uint64 i = 0; i < options.keyspace; i++)
+            {
+                bench_command(options, rnd, options.types[t], i, false, cmd);
+                ctx.GetReply().Clear();
+                db.Call(ctx, cmd);
+            }
+        }
+    }
+
+    ZipfGenerator keys(options.keyspace, options.zipf_theta);
+    std::vector<BenchWorker*> workers;
+    for (uint32 i = 0; i < options.threads; i++)
+    {
+        uint64 requests = options.requests / options.threads + (i < options.requests % options.threads ? 1 : 0);
+        workers.push_back(new BenchWorker(db, options, keys, requests, i));
+    }
+    uint64 start = get_current_epoch_micros();
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i]->Start();
+    }
+    BenchResult total;
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i]->Join();
+        BenchResult& r = workers[i]->result;
+        total.read_latency.insert(total.read_latency.end(), r.read_latency.begin(), r.read_latency.end());
+        total.write_latency.insert(total.write_latency.end(), r.write_latency.begin(), r.write_latency.end());
+        total.errors += r.errors;
+    }
+    double seconds = (get_current_epoch_micros() - start) / 1000000.0;
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        delete workers[i];
+    }
+
+    std::vector<uint32> all = total.read_latency;
+    all.insert(all.end(), total.write_latency.begin(), total.write_latency.end());
+    std::string types;
+    for (size_t i = 0; i < options.types.size(); i++)
+    {
+        types.append(i > 0 ? "," : "").append(kBenchTypeNames[options.types[i]]);
+    }
+    printf("{\"engine\":\"%s\",\"types\":\"%s\",\"threads\":%u,\"pipeline\":%u,\"keyspace\":%llu,\"zipf\":%.2f,"
+            "\"read_ratio\":%.2f,\"seconds\":%.3f,\"errors\":%llu,", g_engine_name, types.c_str(), options.threads,
+            options.pipeline, (unsigned long long) options.keyspace, options.zipf_theta, options.read_ratio, seconds,
+            (unsigned long long) total.errors);
+    print_latency("all", all, seconds, false);
+    print_latency("read", total.read_latency, seconds, false);
+    print_latency("write", total.write_latency, seconds, true);
+    printf("}\n");
+    return 0;
+}
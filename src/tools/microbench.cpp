@@ -0,0 +1,624 @@
+/*
+ *Copyright (c) 2013-2016, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * ardb-microbench: isolated benchmarks of the codec/comparator/protocol hot paths.
+ * Each case is calibrated to run at least 'min-time' ms, repeated and the fastest round reported as:
+ *     Benchmark<Name>  <iterations>  <ns> ns/op  <throughput> MB/s
+ * which is the format benchstat understands, so two runs can be compared directly.
+ * MB/s is derived from the bytes each op processed(as go's b.SetBytes), allocations are NOT measured.
+ */
+#include <stdlib.h>
+#include <time.h>
+#include "db/engine.hpp"
+#include "db/codec.hpp"
+#include "channel/codec/redis_command_codec.hpp"
+#include "channel/codec/redis_reply_codec.hpp"
+#include "util/string_helper.hpp"
+
+using namespace ardb;
+using namespace ardb::codec;
+
+/*
+ * Results are folded into this sink so that the compiler can not drop the benchmarked calls.
+ */
+static volatile uint64 g_bench_sink = 0;
+
+static uint64 bench_nanos()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static std::string bench_string(size_t len, uint32 seed)
+{
+    std::string s;
+    s.resize(len);
+    for (size_t i = 0; i < len; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        s[i] = 'a' + (seed >> 16) % 26;
+    }
+    return s;
+}
+
+class MicroBench
+{
+    public:
+        std::string name;
+        MicroBench(const std::string& n)
+                : name(n)
+        {
+        }
+        /*
+         * run 'iterations' ops, return the total bytes processed.
+         */
+        virtual uint64 Run(uint64 iterations) = 0;
+        virtual ~MicroBench()
+        {
+        }
+};
+
+/*
+ * Op is a functor 'size_t operator()(uint64 i)' returning the bytes processed by op i,
+ * templated instead of virtual so that the call overhead is not part of the measured ns/op.
+ */
+template<typename Op>
+class MicroBenchCase: public MicroBench
+{
+    public:
+        Op op;
+        MicroBenchCase(const std::string& n, const Op& o)
+                : MicroBench(n), op(o)
+        {
+        }
+        uint64 Run(uint64 iterations)
+        {
+            uint64 bytes = 0;
+            for (uint64 i = 0; i < iterations; i++)
+            {
+                bytes += op(i);
+            }
+            return bytes;
+        }
+};
+
+template<typename Op>
+static MicroBench* new_bench(const std::string& name, const Op& op)
+{
+    return new MicroBenchCase<Op>(name, op);
+}
+
+/*
+ * every key type with short(8 bytes) and long(128 bytes) key/element parts.
+ */
+static void build_keys(size_t key_len, std::vector<KeyObject>& keys, std::vector<std::string>& names)
+{
+    static const KeyType types[] = { KEY_META, KEY_STRING, KEY_HASH, KEY_HASH_FIELD, KEY_LIST, KEY_LIST_ELEMENT, KEY_SET,
+            KEY_SET_MEMBER, KEY_ZSET, KEY_ZSET_SORT, KEY_ZSET_SCORE, KEY_STREAM, KEY_STREAM_ELEMENT, KEY_STREAM_PEL,
+            KEY_TTL_SORT };
+    static const char* type_names[] = { "Meta", "String", "Hash", "HashField", "List", "ListElement", "Set", "SetMember",
+            "ZSet", "ZSetSort", "ZSetScore", "Stream", "StreamElement", "StreamPEL", "TTLSort" };
+    Data ns;
+    ns.SetString("0", false);
+    for (size_t i = 0; i < arraysize(types); i++)
+    {
+        KeyObject key(ns, types[i], bench_string(key_len, i));
+        std::string member = bench_string(key_len, i + 100);
+        switch (types[i])
+        {
+            case KEY_HASH_FIELD:
+            {
+                key.SetHashField(member);
+                break;
+            }
+            case KEY_LIST_ELEMENT:
+            {
+                key.SetListIndex((int64_t) 123456);
+                break;
+            }
+            case KEY_SET_MEMBER:
+            {
+                key.SetSetMember(member);
+                break;
+            }
+            case KEY_ZSET_SORT:
+            {
+                key.SetZSetScore(3.1415926);
+                key.SetZSetMember(member);
+                break;
+            }
+            case KEY_ZSET_SCORE:
+            {
+                key.SetZSetMember(member);
+                break;
+            }
+            case KEY_STREAM_ELEMENT:
+            {
+                StreamID id;
+                id.ms = 1500000000000ULL;
+                id.seq = 7;
+                key.SetStreamID(id);
+                break;
+            }
+            case KEY_STREAM_PEL:
+            {
+                StreamID id;
+                id.ms = 1500000000000ULL;
+                id.seq = 7;
+                key.SetStreamGroup(member);
+                key.SetStreamPELId(id);
+                break;
+            }
+            case KEY_TTL_SORT:
+            {
+                key.SetTTL(1500000000000LL);
+                key.SetTTLKeyNamespace(ns);
+                key.SetTTLKey(member);
+                break;
+            }
+            default:
+            {
+                break;
+            }
+        }
+        keys.push_back(key);
+        names.push_back(type_names[i]);
+    }
+}
+
+struct KeyEncodeOp
+{
+        KeyObject key;
+        bool with_ns;
+        Buffer buffer;
+        KeyEncodeOp(const KeyObject& k, bool ns)
+                : key(k), with_ns(ns)
+        {
+        }
+        KeyEncodeOp(const KeyEncodeOp& other)
+                : key(other.key), with_ns(other.with_ns)
+        {
+        }
+        size_t operator()(uint64 i)
+        {
+            buffer.Clear();
+            return key.Encode(buffer, true, with_ns).size();
+        }
+};
+
+struct KeyDecodeOp
+{
+        std::string encoded;
+        bool with_ns;
+        KeyObject key;
+        KeyDecodeOp(const KeyObject& k, bool ns)
+                : with_ns(ns)
+        {
+            Buffer buffer;
+            Slice s = k.Encode(buffer, true, with_ns);
+            encoded.assign(s.data(), s.size());
+        }
+        size_t operator()(uint64 i)
+        {
+            Buffer buffer((char*) encoded.data(), 0, encoded.size());
+            g_bench_sink += key.Decode(buffer, false, with_ns);
+            return encoded.size();
+        }
+};
+
+/*
+ * the engine comparators(RocksDBComparator, the LMDB/ForestDB/WiredTiger collators) are thin wrappers of compare_keys,
+ * so the pairs below are ordered the way they hit the comparator: mostly sharing the key prefix and differing late.
+ */
+struct CompareKeysOp
+{
+        std::vector<std::string> encoded;
+        bool with_ns;
+        CompareKeysOp(const std::vector<KeyObject>& keys, bool ns)
+                : with_ns(ns)
+        {
+            for (size_t i = 0; i < keys.size(); i++)
+            {
+                Buffer buffer;
+                Slice s = keys[i].Encode(buffer, true, with_ns);
+                encoded.push_back(std::string(s.data(), s.size()));
+            }
+        }
+        size_t operator()(uint64 i)
+        {
+            const std::string& a = encoded[i % encoded.size()];
+            const std::string& b = encoded[(i + 1) % encoded.size()];
+            g_bench_sink += compare_keys(a.data(), a.size(), b.data(), b.size(), with_ns);
+            return a.size() + b.size();
+        }
+};
+
+struct ReplyEncodeOp
+{
+        RedisReply reply;
+        Buffer buffer;
+        ReplyEncodeOp()
+        {
+        }
+        ReplyEncodeOp(const ReplyEncodeOp& other)
+        {
+            reply.Clone(other.reply);
+        }
+        size_t operator()(uint64 i)
+        {
+            buffer.Clear();
+            RedisReplyEncoder::Encode(buffer, reply);
+            return buffer.ReadableBytes();
+        }
+};
+
+class BenchCommandDecoder: public FastRedisCommandDecoder
+{
+    public:
+        int Decode(Buffer& buffer, std::string& err)
+        {
+            return ProcessMultibulkBuffer(buffer, err);
+        }
+};
+
+struct MultibulkDecodeOp
+{
+        std::string encoded;
+        BenchCommandDecoder decoder;
+        MultibulkDecodeOp(const RedisCommandFrame& cmd)
+        {
+            Buffer buffer;
+            RedisCommandEncoder::Encode(buffer, cmd);
+            encoded.assign(buffer.GetRawReadBuffer(), buffer.ReadableBytes());
+        }
+        MultibulkDecodeOp(const MultibulkDecodeOp& other)
+                : encoded(other.encoded)
+        {
+        }
+        size_t operator()(uint64 i)
+        {
+            /* the encoded string is NUL terminated, the decoder relies on strchr like the socket buffer does */
+            Buffer buffer((char*) encoded.c_str(), 0, encoded.size());
+            std::string err;
+            g_bench_sink += decoder.Decode(buffer, err);
+            return encoded.size();
+        }
+};
+
+struct StringMatchOp
+{
+        std::string pattern;
+        std::vector<std::string> inputs;
+        int nocase;
+        StringMatchOp(const std::string& p, int icase)
+                : pattern(p), nocase(icase)
+        {
+            for (uint32 i = 0; i < 64; i++)
+            {
+                char buf[128];
+                snprintf(buf, sizeof(buf), "user:%u:session:%s", i * 7919, bench_string(16 + i % 32, i).c_str());
+                inputs.push_back(buf);
+            }
+        }
+        size_t operator()(uint64 i)
+        {
+            const std::string& s = inputs[i % inputs.size()];
+            g_bench_sink += stringmatchlen(pattern.data(), pattern.size(), s.data(), s.size(), nocase);
+            return s.size();
+        }
+};
+
+enum DataOpType
+{
+    DATA_SET_INT_STRING, DATA_SET_PLAIN_STRING, DATA_INT_TO_STRING, DATA_FLOAT_TO_STRING, DATA_GET_FLOAT, DATA_COMPARE_INT,
+    DATA_COMPARE_STRING
+};
+
+struct DataOp
+{
+        DataOpType type;
+        std::vector<std::string> inputs;
+        std::vector<Data> datas;
+        std::string str;
+        DataOp(DataOpType t)
+                : type(t)
+        {
+            for (uint32 i = 0; i < 64; i++)
+            {
+                Data d;
+                if (type == DATA_SET_INT_STRING || type == DATA_INT_TO_STRING || type == DATA_COMPARE_INT)
+                {
+                    inputs.push_back(stringfromll((int64) i * 982451653LL - 31415926535LL));
+                    d.SetString(inputs.back(), true);
+                }
+                else if (type == DATA_FLOAT_TO_STRING || type == DATA_GET_FLOAT)
+                {
+                    d.SetFloat64(i * 1.61803398875 - 17.5);
+                }
+                else
+                {
+                    inputs.push_back("member:" + bench_string(8 + i % 24, i));
+                    d.SetString(inputs.back(), false);
+                }
+                datas.push_back(d);
+            }
+        }
+        size_t operator()(uint64 i)
+        {
+            size_t idx = i % datas.size();
+            switch (type)
+            {
+                case DATA_SET_INT_STRING:
+                case DATA_SET_PLAIN_STRING:
+                {
+                    Data d;
+                    d.SetString(inputs[idx], true);
+                    g_bench_sink += d.IsInteger();
+                    return inputs[idx].size();
+                }
+                case DATA_INT_TO_STRING:
+                case DATA_FLOAT_TO_STRING:
+                {
+                    datas[idx].ToString(str);
+                    return str.size();
+                }
+                case DATA_GET_FLOAT:
+                {
+                    g_bench_sink += (uint64) datas[idx].GetFloat64();
+                    return sizeof(double);
+                }
+                default:
+                {
+                    const Data& a = datas[idx];
+                    const Data& b = datas[(idx + 1) % datas.size()];
+                    g_bench_sink += a.Compare(b);
+                    return a.StringLength() + b.StringLength();
+                }
+            }
+        }
+};
+
+static void build_benchmarks(std::vector<MicroBench*>& benchs)
+{
+    size_t key_lens[] = { 8, 128 };
+    const char* key_len_names[] = { "Short", "Long" };
+    for (size_t l = 0; l < arraysize(key_lens); l++)
+    {
+        std::vector<KeyObject> keys;
+        std::vector<std::string> names;
+        build_keys(key_lens[l], keys, names);
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            benchs.push_back(new_bench("KeyEncode/" + names[i] + "/" + key_len_names[l], KeyEncodeOp(keys[i], false)));
+        }
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            benchs.push_back(new_bench("KeyDecode/" + names[i] + "/" + key_len_names[l], KeyDecodeOp(keys[i], false)));
+        }
+        benchs.push_back(new_bench(std::string("KeyEncodeNS/") + key_len_names[l], KeyEncodeOp(keys[3], true)));
+        benchs.push_back(new_bench(std::string("KeyDecodeNS/") + key_len_names[l], KeyDecodeOp(keys[3], true)));
+
+        /* same key, different elements: the common case inside one hash/set/zset */
+        std::vector<KeyObject> members;
+        Data ns;
+        ns.SetString("0", false);
+        for (uint32 i = 0; i < 64; i++)
+        {
+            KeyObject member(ns, KEY_HASH_FIELD, bench_string(key_lens[l], 1));
+            member.SetHashField(bench_string(key_lens[l], 1000 + i));
+            members.push_back(member);
+        }
+        benchs.push_back(new_bench(std::string("CompareKeys/AllTypes/") + key_len_names[l], CompareKeysOp(keys, false)));
+        benchs.push_back(new_bench(std::string("CompareKeys/SameKey/") + key_len_names[l], CompareKeysOp(members, false)));
+        benchs.push_back(new_bench(std::string("CompareKeysNS/SameKey/") + key_len_names[l], CompareKeysOp(members, true)));
+    }
+
+    {
+        ReplyEncodeOp status, integer, nil, small, large, array, nested;
+        status.reply.SetStatusString("OK");
+        integer.reply.SetInteger(1234567890123LL);
+        nil.reply.type = REDIS_REPLY_NIL;
+        small.reply.SetString(bench_string(16, 1));
+        large.reply.SetString(bench_string(64 * 1024, 2));
+        array.reply.ReserveMember(100);
+        for (uint32 i = 0; i < 100; i++)
+        {
+            array.reply.AddMember().SetString(bench_string(32, i));
+        }
+        /* e.g. an EXEC/XREAD reply: array of arrays mixing bulk strings, integers and nils */
+        for (uint32 i = 0; i < 10; i++)
+        {
+            RedisReply& sub = nested.reply.AddMember();
+            for (uint32 j = 0; j < 10; j++)
+            {
+                RedisReply& r = sub.AddMember();
+                if (j % 3 == 0)
+                {
+                    r.SetInteger(i * j);
+                }
+                else if (j % 3 == 1)
+                {
+                    r.SetString(bench_string(24, i * 10 + j));
+                }
+                else
+                {
+                    r.Clear();
+                    r.type = REDIS_REPLY_NIL;
+                }
+            }
+        }
+        benchs.push_back(new_bench("ReplyEncode/Status", status));
+        benchs.push_back(new_bench("ReplyEncode/Integer", integer));
+        benchs.push_back(new_bench("ReplyEncode/Nil", nil));
+        benchs.push_back(new_bench("ReplyEncode/Bulk16", small));
+        benchs.push_back(new_bench("ReplyEncode/Bulk64K", large));
+        benchs.push_back(new_bench("ReplyEncode/Array100", array));
+        benchs.push_back(new_bench("ReplyEncode/Nested10x10", nested));
+    }
+
+    {
+        RedisCommandFrame set("set"), mset("mset"), hmset("hmset"), bigset("set");
+        set.AddArg("user:1000:name");
+        set.AddArg(bench_string(32, 1));
+        for (uint32 i = 0; i < 100; i++)
+        {
+            mset.AddArg("key:" + stringfromll(i));
+            mset.AddArg(bench_string(64, i));
+        }
+        hmset.AddArg("hash:1");
+        for (uint32 i = 0; i < 500; i++)
+        {
+            hmset.AddArg("field:" + stringfromll(i));
+            hmset.AddArg(stringfromll(i * 31));
+        }
+        bigset.AddArg("blob");
+        bigset.AddArg(bench_string(1024 * 1024, 3));
+        benchs.push_back(new_bench("MultibulkDecode/Set", MultibulkDecodeOp(set)));
+        benchs.push_back(new_bench("MultibulkDecode/MSet100", MultibulkDecodeOp(mset)));
+        benchs.push_back(new_bench("MultibulkDecode/HMSet1000Args", MultibulkDecodeOp(hmset)));
+        benchs.push_back(new_bench("MultibulkDecode/Set1M", MultibulkDecodeOp(bigset)));
+    }
+
+    benchs.push_back(new_bench("StringMatch/Prefix", StringMatchOp("user:*", 0)));
+    benchs.push_back(new_bench("StringMatch/Infix", StringMatchOp("*:session:*z*", 0)));
+    benchs.push_back(new_bench("StringMatch/Mixed", StringMatchOp("user:?9*:[a-m]*", 0)));
+    benchs.push_back(new_bench("StringMatch/NoCase", StringMatchOp("USER:*:SESSION:*", 1)));
+
+    benchs.push_back(new_bench("Data/SetIntString", DataOp(DATA_SET_INT_STRING)));
+    benchs.push_back(new_bench("Data/SetPlainString", DataOp(DATA_SET_PLAIN_STRING)));
+    benchs.push_back(new_bench("Data/IntToString", DataOp(DATA_INT_TO_STRING)));
+    benchs.push_back(new_bench("Data/FloatToString", DataOp(DATA_FLOAT_TO_STRING)));
+    benchs.push_back(new_bench("Data/GetFloat64", DataOp(DATA_GET_FLOAT)));
+    benchs.push_back(new_bench("Data/CompareInt", DataOp(DATA_COMPARE_INT)));
+    benchs.push_back(new_bench("Data/CompareString", DataOp(DATA_COMPARE_STRING)));
+}
+
+static void usage()
+{
+    fprintf(stderr, "Usage: ./ardb-microbench [options]\n");
+    fprintf(stderr, "  -f <filter>        Only run benchmarks whose name contains <filter>\n");
+    fprintf(stderr, "  -t <ms>            Minimum measured time of each round (default 200)\n");
+    fprintf(stderr, "  -r <rounds>        Rounds per benchmark, the fastest one is reported (default 3)\n");
+    fprintf(stderr, "  -l                 List benchmarks and exit\n");
+    exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    std::string filter;
+    uint64 min_time = 200;
+    uint32 rounds = 3;
+    bool list = false;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "-l")
+        {
+            list = true;
+        }
+        else if (i + 1 >= argc)
+        {
+            usage();
+        }
+        else if (arg == "-f")
+        {
+            filter = argv[++i];
+        }
+        else if (arg == "-t")
+        {
+            min_time = strtoull(argv[++i], NULL, 10);
+        }
+        else if (arg == "-r")
+        {
+            rounds = strtoul(argv[++i], NULL, 10);
+        }
+        else
+        {
+            usage();
+        }
+    }
+    if (rounds == 0 || min_time == 0)
+    {
+        usage();
+    }
+    ArdbLogger::SetLogLevel("WARN");
+
+    std::vector<MicroBench*> benchs;
+    build_benchmarks(benchs);
+    for (size_t i = 0; i < benchs.size(); i++)
+    {
+        MicroBench* bench = benchs[i];
+        if (!filter.empty() && bench->name.find(filter) == std::string::npos)
+        {
+            continue;
+        }
+        if (list)
+        {
+            printf("Benchmark%s\n", bench->name.c_str());
+            continue;
+        }
+        /* calibrate: grow the iteration count until one round takes at least min_time */
+        uint64 iterations = 1;
+        uint64 cost = 0;
+        while (true)
+        {
+            uint64 start = bench_nanos();
+            bench->Run(iterations);
+            cost = bench_nanos() - start;
+            if (cost >= min_time * 1000000ULL)
+            {
+                break;
+            }
+            uint64 next = cost > 0 ? iterations * min_time * 1200000ULL / cost : iterations * 100;
+            iterations = next > iterations * 100 ? iterations * 100 : (next <= iterations ? iterations * 2 : next);
+        }
+        double best = (double) cost / iterations;
+        uint64 bytes = 0;
+        for (uint32 r = 0; r < rounds; r++)
+        {
+            uint64 start = bench_nanos();
+            bytes = bench->Run(iterations);
+            double ns = (double) (bench_nanos() - start) / iterations;
+            if (ns < best)
+            {
+                best = ns;
+            }
+        }
+        printf("Benchmark%-40s %12llu %12.2f ns/op %12.2f MB/s\n", bench->name.c_str(), (unsigned long long) iterations, best,
+                best > 0 ? (double) bytes / iterations * 1000 / best : 0);
+        fflush(stdout);
+    }
+    for (size_t i = 0; i < benchs.size(); i++)
+    {
+        delete benchs[i];
+    }
+    return 0;
+}
@@ -19,6 +19,11 @@ s = ardb.call("pfmerge", "hll3", "hll1", "hll2")
 ardb.assert2(s["ok"] == "OK", s)
 s = ardb.call("pfcount", "hll3")
 ardb.assert2(s == 6, s)
+s = ardb.call("pfcount", "hll1", "hll2")
+ardb.assert2(s == 6, s)
+ardb.call("pfadd", "hll2", "d")
+s = ardb.call("pfcount", "hll1", "hll2")
+ardb.assert2(s == 7, s)
 
 
 
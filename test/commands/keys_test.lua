@@ -1,3 +1,45 @@
 --[[   --]]
 local s = ardb.call("echo", "hello,world")
-ardb.assert2(s == "hello,world", s)
\ No newline at end of file
+ardb.assert2(s == "hello,world", s)
+--[[ KEYS/KEYSCOUNT/SCAN patterns  --]]
+ardb.call("del", "kt:a", "kt:b", "kt:ab", "kt*x", "kt;", "ku")
+ardb.call("set", "kt:a", "1")
+ardb.call("set", "kt:b", "1")
+ardb.call("set", "kt:ab", "1")
+ardb.call("set", "kt*x", "1")
+ardb.call("set", "kt;", "1")
+ardb.call("set", "ku", "1")
+
+--[[ literal pattern matches the exact key only  --]]
+local vs = ardb.call("keys", "kt:a")
+ardb.assert2(table.getn(vs) == 1 and vs[1] == "kt:a", vs)
+vs = ardb.call("keys", "kt:c")
+ardb.assert2(table.getn(vs) == 0, vs)
+
+--[[ prefix-only pattern  --]]
+vs = ardb.call("keys", "kt:*")
+ardb.assert2(table.getn(vs) == 3, vs)
+ardb.assert2(vs[1] == "kt:a" and vs[2] == "kt:ab" and vs[3] == "kt:b", vs)
+
+--[[ escaped glob matches the glob char literally  --]]
+vs = ardb.call("keys", "kt\\*x")
+ardb.assert2(table.getn(vs) == 1 and vs[1] == "kt*x", vs)
+vs = ardb.call("keys", "kt:?")
+ardb.assert2(table.getn(vs) == 2, vs)
+
+--[[ SCAN stops at the end of the pattern prefix  --]]
+vs = ardb.call("scan", "0", "match", "kt:*", "count", "100")
+ardb.assert2(vs[1] == "0", vs)
+ardb.assert2(table.getn(vs[2]) == 3, vs)
+for i = 1, table.getn(vs[2]) do
+    ardb.assert2(string.sub(vs[2][i], 1, 3) == "kt:", vs)
+end
+
+--[[ KEYSCOUNT agrees with KEYS  --]]
+local patterns = { "kt:a", "kt:*", "kt\\*x", "kt*", "k?;" }
+for i = 1, table.getn(patterns) do
+    local c = ardb.call("keyscount", patterns[i])
+    vs = ardb.call("keys", patterns[i])
+    ardb.assert2(c == table.getn(vs), patterns[i])
+end
+ardb.call("del", "kt:a", "kt:b", "kt:ab", "kt*x", "kt;", "ku")
@@ -0,0 +1,53 @@
+--[[   --]]
+ardb.call("del", "mystream")
+for i = 1, 10 do
+    ardb.call("xadd", "mystream", "1-" .. i, "field", "v" .. i)
+end
+local s = ardb.call("xlen", "mystream")
+ardb.assert2(s == 10, s)
+
+--[[ exact MAXLEN trimming keeps the newest entries  --]]
+s = ardb.call("xtrim", "mystream", "maxlen", "7")
+ardb.assert2(s == 3, s)
+s = ardb.call("xlen", "mystream")
+ardb.assert2(s == 7, s)
+local vs = ardb.call("xrange", "mystream", "-", "+")
+ardb.assert2(table.getn(vs) == 7, vs)
+ardb.assert2(vs[1][1]["ok"] == "1-4", vs)
+s = ardb.call("xtrim", "mystream", "maxlen", "7")
+ardb.assert2(s == 0, s)
+
+--[[ MINID trimming removes the entries older than the id  --]]
+s = ardb.call("xtrim", "mystream", "minid", "1-6")
+ardb.assert2(s == 2, s)
+s = ardb.call("xlen", "mystream")
+ardb.assert2(s == 5, s)
+vs = ardb.call("xrange", "mystream", "-", "+")
+ardb.assert2(vs[1][1]["ok"] == "1-6", vs)
+s = ardb.call("xtrim", "mystream", "minid", "1-6")
+ardb.assert2(s == 0, s)
+
+--[[ consumer group PEL  --]]
+s = ardb.call("xgroup", "create", "mystream", "mygroup", "0")
+ardb.assert2(s["ok"] == "OK", s)
+vs = ardb.call("xreadgroup", "group", "mygroup", "c1", "count", "2", "streams", "mystream", ">")
+ardb.assert2(table.getn(vs[1][2]) == 2, vs)
+vs = ardb.call("xpending", "mystream", "mygroup")
+ardb.assert2(vs[1] == 2, vs)
+ardb.assert2(vs[2]["ok"] == "1-6", vs)
+ardb.assert2(vs[3]["ok"] == "1-7", vs)
+vs = ardb.call("xpending", "mystream", "mygroup", "-", "+", "1")
+ardb.assert2(table.getn(vs) == 1, vs)
+ardb.assert2(vs[1][1]["ok"] == "1-6", vs)
+s = ardb.call("xack", "mystream", "mygroup", "1-6")
+ardb.assert2(s == 1, s)
+s = ardb.call("xack", "mystream", "mygroup", "1-6")
+ardb.assert2(s == 0, s)
+
+--[[ destroying a group returns its pending count and drops the group  --]]
+s = ardb.call("xgroup", "delgroup", "mystream", "mygroup")
+ardb.assert2(s == 1, s)
+vs = ardb.call("xinfo", "groups", "mystream")
+ardb.assert2(table.getn(vs) == 0, vs)
+s = ardb.call("xlen", "mystream")
+ardb.assert2(s == 5, s)
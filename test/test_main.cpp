@@ -37,6 +37,157 @@
 
 using namespace ardb;
 
+static RedisReply& test_call(Ardb& db, Context& ctx, RedisCommandFrame& cmd)
+{
+    ctx.GetReply().Clear();
+    db.Call(ctx, cmd);
+    return ctx.GetReply();
+}
+
+/*
+ * a script queued in MULTI after a write must still read its own writes.
+ */
+static int test_multi_eval(Ardb& db)
+{
+    Context ctx;
+    RedisCommandFrame del("del");
+    del.AddArg("multi_eval_key");
+    test_call(db, ctx, del);
+    RedisCommandFrame multi("multi");
+    test_call(db, ctx, multi);
+    RedisCommandFrame set("set");
+    set.AddArg("multi_eval_key");
+    set.AddArg("v1");
+    test_call(db, ctx, set);
+    RedisCommandFrame eval("eval");
+    eval.AddArg("redis.call('set', KEYS[1], 'v2') return redis.call('get', KEYS[1])");
+    eval.AddArg("1");
+    eval.AddArg("multi_eval_key");
+    test_call(db, ctx, eval);
+    RedisCommandFrame exec("exec");
+    RedisReply& r = test_call(db, ctx, exec);
+    if (r.MemberSize() != 2 || r.MemberAt(1).GetString() != "v2")
+    {
+        fprintf(stderr, "MULTI/EVAL read stale value:%s\n", r.MemberSize() == 2 ? r.MemberAt(1).GetString().c_str() : "");
+        return -1;
+    }
+    return 0;
+}
+
+static uint64 exec_batch_commits(Ardb& db, Context& ctx)
+{
+    RedisCommandFrame info("info");
+    info.AddArg("stats");
+    RedisReply& r = test_call(db, ctx, info);
+    const char* field = "exec_batch_commits:";
+    size_t pos = r.GetString().find(field);
+    return pos == std::string::npos ? 0 : strtoull(r.GetString().c_str() + pos + strlen(field), NULL, 10);
+}
+
+/*
+ * run the commands in one MULTI/EXEC, and check how many engine write batches EXEC committed for them.
+ */
+static int test_exec_batches(Ardb& db, const char* name, RedisCommandFrameArray& cmds, uint64 expected)
+{
+    Context ctx;
+    uint64 before = exec_batch_commits(db, ctx);
+    RedisCommandFrame multi("multi");
+    test_call(db, ctx, multi);
+    for (size_t i = 0; i < cmds.size(); i++)
+    {
+        test_call(db, ctx, cmds[i]);
+    }
+    RedisCommandFrame exec("exec");
+    RedisReply& r = test_call(db, ctx, exec);
+    if (r.MemberSize() != cmds.size())
+    {
+        fprintf(stderr, "%s: EXEC returned %u replies\n", name, (uint32) r.MemberSize());
+        return -1;
+    }
+    uint64 commits = exec_batch_commits(db, ctx) - before;
+    if (commits != expected)
+    {
+        fprintf(stderr, "%s: EXEC committed %" PRIu64 " write batches, expected %" PRIu64 "\n", name, commits, expected);
+        return -1;
+    }
+    return 0;
+}
+
+static int test_multi_single_batch(Ardb& db)
+{
+    bool read_own_writes = g_engine->GetFeatureSet().support_batch_read_own_writes;
+    /*
+     * writes to disjoint keys always share one batch.
+     */
+    RedisCommandFrameArray disjoint(3);
+    disjoint[0].SetCommand("set");
+    disjoint[0].AddArg("batch_k1");
+    disjoint[0].AddArg("v1");
+    disjoint[1].SetCommand("hset");
+    disjoint[1].AddArg("batch_k2");
+    disjoint[1].AddArg("f");
+    disjoint[1].AddArg("v");
+    disjoint[2].SetCommand("incr");
+    disjoint[2].AddArg("batch_k3");
+    if (test_exec_batches(db, "disjoint keys", disjoint, 1) != 0)
+    {
+        return -1;
+    }
+    /*
+     * a later command reading a key written before splits the batch unless the engine reads its own writes.
+     */
+    RedisCommandFrameArray overlap(2);
+    overlap[0].SetCommand("set");
+    overlap[0].AddArg("batch_k1");
+    overlap[0].AddArg("v2");
+    overlap[1].SetCommand("expire");
+    overlap[1].AddArg("batch_k1");
+    overlap[1].AddArg("100");
+    if (test_exec_batches(db, "overlapped keys", overlap, read_own_writes ? 1 : 2) != 0)
+    {
+        return -1;
+    }
+    Context ctx;
+    RedisCommandFrame ttl("ttl");
+    ttl.AddArg("batch_k1");
+    if (test_call(db, ctx, ttl).GetInteger() <= 0)
+    {
+        fprintf(stderr, "EXPIRE after SET in one EXEC lost the ttl\n");
+        return -1;
+    }
+    /*
+     * a command whose keys are unknown before execution runs alone.
+     */
+    RedisCommandFrameArray unknown(3);
+    unknown[0].SetCommand("set");
+    unknown[0].AddArg("batch_k1");
+    unknown[0].AddArg("v3");
+    unknown[1].SetCommand("eval");
+    unknown[1].AddArg("return redis.call('get', KEYS[1])");
+    unknown[1].AddArg("1");
+    unknown[1].AddArg("batch_k1");
+    unknown[2].SetCommand("set");
+    unknown[2].AddArg("batch_k2");
+    unknown[2].AddArg("v3");
+    return test_exec_batches(db, "unknown keys", unknown, 2);
+}
+
+static int test_eval_uppercase_command(Ardb& db)
+{
+    Context ctx;
+    RedisCommandFrame eval("eval");
+    eval.AddArg("redis.call('SET', KEYS[1], 'v1') return redis.call('Get', KEYS[1])");
+    eval.AddArg("1");
+    eval.AddArg("eval_upper_key");
+    RedisReply& r = test_call(db, ctx, eval);
+    if (r.IsErr() || r.GetString() != "v1")
+    {
+        fprintf(stderr, "EVAL with uppercase command failed:%s\n", r.IsErr() ? r.Error().c_str() : r.GetString().c_str());
+        return -1;
+    }
+    return 0;
+}
+
 
 int main()
 {
@@ -46,6 +197,10 @@ int main()
         printf("Failed to init db.\n");
         return -1;
     }
+    if (test_multi_eval(db) != 0 || test_eval_uppercase_command(db) != 0 || test_multi_single_batch(db) != 0)
+    {
+        return -1;
+    }
     LUAInterpreter interpreter;
     std::deque<std::string> fs;
     std::string command_test_path = "../commands/";